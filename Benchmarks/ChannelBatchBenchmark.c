@@ -0,0 +1,108 @@
+/*
+ * Throughput benchmark for batched channel transfers.
+ *
+ * One thread streams integers to another over a buffered channel using channel_send_n and channel_receive_n, with
+ * batch sizes of 1, 8, 64 and 256, and reports the throughput of each and how many items each receive collected.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include "../Channels/channel.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define ITEMS 1000000
+#define CAPACITY 256
+#define MAX_BATCH 256
+
+typedef struct Stream {
+    Channel_PNTR out;
+    unsigned int batch;
+} Stream_s;
+
+static void* produce(void* arg) {
+    Stream_s* stream = arg;
+    int values[MAX_BATCH];
+    for(int i = 0; i < ITEMS; i += stream->batch) {
+        unsigned int n = ITEMS - i < (int)stream->batch ? (unsigned int)(ITEMS - i) : stream->batch;
+        for(unsigned int j = 0; j < n; j++) {
+            values[j] = i + j;
+        }
+        channel_send_n(stream->out, values, n, NULL);
+    }
+    return NULL;
+}
+
+static double runStream(unsigned int batch, double *perReceive) {
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_setCapacity(in, CAPACITY);
+    channel_bind(out, in);
+
+    Stream_s stream = { out, batch };
+    pthread_t thread;
+    double start = benchmark_now();
+    pthread_create(&thread, NULL, produce, &stream);
+    int values[MAX_BATCH];
+    int received = 0;
+    unsigned long receives = 0;
+    while(received < ITEMS) {
+        unsigned int n = channel_receive_n(in, values, batch);
+        for(unsigned int j = 0; j < n; j++) {
+            if(values[j] != received++) {
+                fprintf(stderr, "Out of order: expected %d, got %d\n", received - 1, values[j]);
+                return 0;
+            }
+        }
+        receives++;
+    }
+    double elapsed = benchmark_now() - start;
+    pthread_join(thread, NULL);
+
+    *perReceive = (double)ITEMS / receives;
+    GC_decRef(out);
+    GC_decRef(in);
+    return ITEMS / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    unsigned int batches[] = { 1, 8, 64, 256 };
+    double baseline = 0;
+    printf("%d items over a channel buffering %d\n", ITEMS, CAPACITY);
+    for(unsigned int i = 0; i < sizeof(batches) / sizeof(batches[0]); i++) {
+        double perReceive;
+        double throughput = runStream(batches[i], &perReceive);
+        if(i == 0) {
+            baseline = throughput;
+        }
+        printf("  batch %3u: %12.0f items/s (%.2fx), %6.1f items/receive\n",
+               batches[i], throughput, throughput / baseline, perReceive);
+    }
+    return 0;
+}
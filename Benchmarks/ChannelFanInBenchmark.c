@@ -0,0 +1,120 @@
+/*
+ * Fan-in benchmark for channels.
+ *
+ * 1, 16, 256 and 1024 sender threads, each with its own OUT channel, all feed one aggregating IN channel, which
+ * receives a fixed total number of messages. Reports the throughput, and how evenly the receiver served the senders:
+ * over the first half of the messages, the fewest and most taken from any one sender. Then the same number of OUT
+ * channels are bound but only two of them send, as when most of the aggregator's sources are idle.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include "../Channels/channel.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define MESSAGES 262144
+#define MAX_SENDERS 1024
+#define SENDER_STACK (64 * 1024)
+
+typedef struct Sender {
+    Channel_PNTR out;
+    int id;
+    int count;
+} Sender_s;
+
+static void* produce(void* arg) {
+    Sender_s* sender = arg;
+    for(int i = 0; i < sender->count; i++) {
+        channel_send(sender->out, &(sender->id), NULL);
+    }
+    return NULL;
+}
+
+static double runFanIn(int senders, int active, int *fewest, int *most) {
+    static Sender_s sender[MAX_SENDERS];
+    static pthread_t thread[MAX_SENDERS];
+    static int taken[MAX_SENDERS];
+
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, SENDER_STACK);
+    for(int i = 0; i < senders; i++) {
+        sender[i] = (Sender_s){ channel_create(CHAN_OUT, sizeof(int)), i, MESSAGES / active };
+        channel_bind(sender[i].out, in);
+        taken[i] = 0;
+    }
+
+    double start = benchmark_now();
+    for(int i = 0; i < active; i++) {
+        pthread_create(&thread[i], &attr, produce, &sender[i]);
+    }
+    int total = MESSAGES / active * active;
+    for(int i = 0; i < total; i++) {
+        int id;
+        channel_receive(in, &id, false);
+        if(i < total / 2) {
+            taken[id]++;
+        }
+    }
+    double elapsed = benchmark_now() - start;
+
+    *fewest = total;
+    *most = 0;
+    for(int i = 0; i < active; i++) {
+        pthread_join(thread[i], NULL);
+        *fewest = taken[i] < *fewest ? taken[i] : *fewest;
+        *most = taken[i] > *most ? taken[i] : *most;
+    }
+    for(int i = 0; i < senders; i++) {
+        GC_decRef(sender[i].out);
+    }
+    pthread_attr_destroy(&attr);
+    GC_decRef(in);
+    return total / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    int senderCounts[] = { 1, 16, 256, 1024 };
+    printf("%d messages into one receiver\n", MESSAGES);
+    for(unsigned int i = 0; i < sizeof(senderCounts) / sizeof(senderCounts[0]); i++) {
+        int fewest, most;
+        double throughput = runFanIn(senderCounts[i], senderCounts[i], &fewest, &most);
+        printf("  %4d senders: %10.0f messages/s, each sender served %d-%d times in the first half\n",
+               senderCounts[i], throughput, fewest, most);
+    }
+    printf("%d messages from 2 senders, among others that are bound but idle\n", MESSAGES);
+    for(unsigned int i = 1; i < sizeof(senderCounts) / sizeof(senderCounts[0]); i++) {
+        int fewest, most;
+        double throughput = runFanIn(senderCounts[i], 2, &fewest, &most);
+        printf("  %4d bound:   %10.0f messages/s\n", senderCounts[i], throughput);
+    }
+    return 0;
+}
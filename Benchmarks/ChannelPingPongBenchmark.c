@@ -0,0 +1,90 @@
+/*
+ * Ping-pong latency benchmark for channels.
+ *
+ * Two threads bounce an integer back and forth over a pair of one-to-one bindings, once with the one-to-one fast
+ * path disabled and once with it enabled, and report the mean round trip time of each.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include "../Channels/channel.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define ROUND_TRIPS 200000
+
+typedef struct PingPong {
+    Channel_PNTR pingOut, pingIn, pongOut, pongIn;
+} PingPong_s;
+
+static void* echo(void* arg) {
+    PingPong_s* pingPong = arg;
+    for(int i = 0; i < ROUND_TRIPS; i++) {
+        int value;
+        channel_receive(pingPong->pingIn, &value, false);
+        channel_send(pingPong->pongOut, &value, NULL);
+    }
+    return NULL;
+}
+
+static double runPingPong(bool fastPath) {
+    channel_setSPSCEnabled(fastPath);
+    PingPong_s pingPong = {
+        channel_create(CHAN_OUT, sizeof(int)), channel_create(CHAN_IN, sizeof(int)),
+        channel_create(CHAN_OUT, sizeof(int)), channel_create(CHAN_IN, sizeof(int))
+    };
+    channel_bind(pingPong.pingOut, pingPong.pingIn);
+    channel_bind(pingPong.pongOut, pingPong.pongIn);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, echo, &pingPong);
+    double start = benchmark_now();
+    for(int i = 0; i < ROUND_TRIPS; i++) {
+        int value = i;
+        channel_send(pingPong.pingOut, &value, NULL);
+        channel_receive(pingPong.pongIn, &value, false);
+    }
+    double elapsed = benchmark_now() - start;
+    pthread_join(thread, NULL);
+
+    GC_decRef(pingPong.pingOut);
+    GC_decRef(pingPong.pingIn);
+    GC_decRef(pingPong.pongOut);
+    GC_decRef(pingPong.pongIn);
+    return elapsed / ROUND_TRIPS;
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    double slow = runPingPong(false);
+    double fast = runPingPong(true);
+    printf("%d round trips\n", ROUND_TRIPS);
+    printf("  slow path:            %10.1f ns/round trip\n", slow);
+    printf("  one-to-one fast path: %10.1f ns/round trip (%.2fx)\n", fast, slow / fast);
+    return 0;
+}
@@ -0,0 +1,99 @@
+/*
+ * Rewiring churn benchmark for channel bindings.
+ *
+ * Threads repeatedly bind an OUT channel to two IN channels and unbind it again, as a dynamic topology that keeps
+ * reconnecting would. Each thread count is run twice: once with every thread rewiring its own channels, which share
+ * no locks, and once with all threads binding to the same pair of IN channels. Reports bind/unbind operations per
+ * second.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include "../Channels/channel.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define ROUNDS 20000
+#define MAX_THREADS 32
+
+typedef struct Rewirer {
+    Channel_PNTR out;
+    Channel_PNTR in[2];
+} Rewirer_s;
+
+static void* rewire(void* arg) {
+    Rewirer_s* rewirer = arg;
+    for(int i = 0; i < ROUNDS; i++) {
+        channel_bind(rewirer->out, rewirer->in[0]);
+        channel_bind(rewirer->out, rewirer->in[1]);
+        channel_unbind(rewirer->out);
+    }
+    return NULL;
+}
+
+static double runChurn(int threads, bool shared) {
+    Rewirer_s rewirers[MAX_THREADS];
+    for(int i = 0; i < threads; i++) {
+        rewirers[i].out = channel_create(CHAN_OUT, sizeof(int));
+        for(int j = 0; j < 2; j++) {
+            rewirers[i].in[j] = shared && i > 0 ? rewirers[0].in[j] : channel_create(CHAN_IN, sizeof(int));
+        }
+    }
+
+    pthread_t thread[MAX_THREADS];
+    double start = benchmark_now();
+    for(int i = 0; i < threads; i++) {
+        pthread_create(&thread[i], NULL, rewire, &rewirers[i]);
+    }
+    for(int i = 0; i < threads; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    double elapsed = benchmark_now() - start;
+
+    for(int i = 0; i < threads; i++) {
+        GC_decRef(rewirers[i].out);
+        if(!shared || i == 0) {
+            GC_decRef(rewirers[i].in[0]);
+            GC_decRef(rewirers[i].in[1]);
+        }
+    }
+    return 3.0 * ROUNDS * threads / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    int threadCounts[] = { 1, 2, 8, 32 };
+    printf("%d rounds of bind, bind, unbind per thread\n", ROUNDS);
+    for(unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        double separate = runChurn(threadCounts[i], false);
+        double shared = runChurn(threadCounts[i], true);
+        printf("  %2d threads: %12.0f ops/s on separate channels, %12.0f ops/s on shared channels\n",
+               threadCounts[i], separate, shared);
+    }
+    return 0;
+}
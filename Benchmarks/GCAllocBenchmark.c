@@ -0,0 +1,105 @@
+/*
+ * Allocation throughput of the garbage collector, with small objects served from slabs and from malloc.
+ *
+ * Each thread churns through the mix of sizes the interpreter allocates most (4 and 8 byte numbers, TypedObjects,
+ * list nodes and strings), keeping a window of recent objects alive so blocks are freed in a different order to the
+ * one they were allocated in, as they are when values pass through variables and stacks.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include "../GC/GC_mem.h"
+#include "../GC/GC_slab.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define ALLOCATIONS 2000000     // per thread
+#define LIVE 256                // objects each thread keeps alive
+
+static const size_t sizes[] = { 4, 24, 8, 24, 32, 4, 24, 48 };
+
+static void* churn(void* arg) {
+    bool inArena = *(bool*) arg;
+    GC_arena_PNTR arena = inArena ? GC_arena_create() : NULL;
+    GC_arena_enter(arena);
+    void* live[LIVE] = { NULL };
+    for(unsigned int i = 0; i < ALLOCATIONS; i++) {
+        unsigned int slot = (i * 7) % LIVE;
+        if(live[slot] != NULL) {
+            GC_decRef(live[slot]);
+        }
+        live[slot] = GC_alloc(sizes[i % (sizeof(sizes) / sizeof(sizes[0]))], false);
+    }
+    for(unsigned int i = 0; i < LIVE; i++) {
+        if(live[i] != NULL) {
+            GC_decRef(live[i]);
+        }
+    }
+    if(arena != NULL) {
+        GC_arena_enter(NULL);
+        GC_arena_release(arena);
+    }
+    return NULL;
+}
+
+static double runChurn(unsigned int threads, bool inArenas, unsigned long* mallocs) {
+    pthread_t workers[threads];
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    double start = benchmark_now();
+    for(unsigned int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, churn, &inArenas);
+    }
+    for(unsigned int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double elapsed = benchmark_now() - start;
+    GC_getStats(&after);
+    *mallocs = after.mallocs - before.mallocs;
+    return (double) threads * ALLOCATIONS / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    unsigned int threadCounts[] = { 1, 4 };
+    printf("%d allocations per thread, %d kept alive\n", ALLOCATIONS, LIVE);
+    for(unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        unsigned long mallocs;
+        GC_slab_setEnabled(false);
+        double baseline = runChurn(threadCounts[i], false, &mallocs);
+        printf("  %u thread(s), malloc: %11.0f allocations/s, %9lu mallocs\n", threadCounts[i], baseline, mallocs);
+        GC_slab_setEnabled(true);
+        double slabs = runChurn(threadCounts[i], false, &mallocs);
+        printf("  %u thread(s), slabs:  %11.0f allocations/s, %9lu mallocs (%.2fx)\n", threadCounts[i], slabs, mallocs,
+               slabs / baseline);
+        double arenas = runChurn(threadCounts[i], true, &mallocs);
+        printf("  %u thread(s), arenas: %11.0f allocations/s, %9lu mallocs (%.2fx)\n", threadCounts[i], arenas, mallocs,
+               arenas / baseline);
+    }
+    return 0;
+}
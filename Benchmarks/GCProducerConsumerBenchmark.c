@@ -0,0 +1,133 @@
+/*
+ * Allocation throughput of the garbage collector when objects are allocated on one thread and freed on another, as
+ * channel messages are: allocated by the sending component and dropped by the receiving one.
+ *
+ * Each producer thread allocates a mix of small objects and hands them to its own consumer thread through a ring,
+ * and the consumer drops them. Producers and consumers allocate from their threads' own caches, and then each from an
+ * arena of its own, as components do.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include "../GC/GC_mem.h"
+#include "../GC/GC_slab.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define MESSAGES 1000000        // per producer
+#define RING 256                // objects in flight between a producer and its consumer
+
+static const size_t sizes[] = { 4, 24, 8, 24, 32, 4, 24, 48 };
+
+struct pair {
+    void* ring[RING];
+    atomic_uint head;           // next slot the producer fills
+    atomic_uint tail;           // next slot the consumer empties
+    bool inArenas;
+};
+
+static void* produce(void* arg) {
+    struct pair* pair = arg;
+    GC_arena_PNTR arena = pair->inArenas ? GC_arena_create() : NULL;
+    GC_arena_enter(arena);
+    for(unsigned int i = 0; i < MESSAGES; i++) {
+        unsigned int head = atomic_load_explicit(&(pair->head), memory_order_relaxed);
+        while(head - atomic_load_explicit(&(pair->tail), memory_order_acquire) == RING) {
+            sched_yield();
+        }
+        pair->ring[head % RING] = GC_alloc(sizes[i % (sizeof(sizes) / sizeof(sizes[0]))], false);
+        atomic_store_explicit(&(pair->head), head + 1, memory_order_release);
+    }
+    if(arena != NULL) {
+        GC_arena_enter(NULL);
+        GC_arena_release(arena);
+    }
+    return NULL;
+}
+
+static void* consume(void* arg) {
+    struct pair* pair = arg;
+    GC_arena_PNTR arena = pair->inArenas ? GC_arena_create() : NULL;
+    GC_arena_enter(arena);
+    for(unsigned int tail = 0; tail < MESSAGES; tail++) {
+        while(atomic_load_explicit(&(pair->head), memory_order_acquire) == tail) {
+            sched_yield();
+        }
+        GC_decRef(pair->ring[tail % RING]);
+        atomic_store_explicit(&(pair->tail), tail + 1, memory_order_release);
+    }
+    if(arena != NULL) {
+        GC_arena_enter(NULL);
+        GC_arena_release(arena);
+    }
+    return NULL;
+}
+
+static double runPairs(unsigned int pairs, bool inArenas, unsigned long* mallocs) {
+    pthread_t threads[pairs * 2];
+    struct pair* rings = calloc(pairs, sizeof(struct pair));
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    double start = benchmark_now();
+    for(unsigned int i = 0; i < pairs; i++) {
+        rings[i].inArenas = inArenas;
+        pthread_create(&threads[i * 2], NULL, produce, &rings[i]);
+        pthread_create(&threads[i * 2 + 1], NULL, consume, &rings[i]);
+    }
+    for(unsigned int i = 0; i < pairs * 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = benchmark_now() - start;
+    GC_getStats(&after);
+    free(rings);
+    *mallocs = after.mallocs - before.mallocs;
+    return (double) pairs * MESSAGES / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    unsigned int pairCounts[] = { 1, 2 };
+    printf("%d objects per producer, %d in flight\n", MESSAGES, RING);
+    for(unsigned int i = 0; i < sizeof(pairCounts) / sizeof(pairCounts[0]); i++) {
+        unsigned long mallocs;
+        GC_slab_setEnabled(false);
+        double baseline = runPairs(pairCounts[i], false, &mallocs);
+        printf("  %u pair(s), malloc: %11.0f objects/s, %8lu mallocs\n", pairCounts[i], baseline, mallocs);
+        GC_slab_setEnabled(true);
+        double caches = runPairs(pairCounts[i], false, &mallocs);
+        printf("  %u pair(s), caches: %11.0f objects/s, %8lu mallocs (%.2fx)\n", pairCounts[i], caches, mallocs,
+               caches / baseline);
+        double arenas = runPairs(pairCounts[i], true, &mallocs);
+        printf("  %u pair(s), arenas: %11.0f objects/s, %8lu mallocs (%.2fx)\n", pairCounts[i], arenas, mallocs,
+               arenas / baseline);
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Reference counting throughput of the garbage collector.
+ *
+ * Threads take and drop references in pairs, as pushes and pops do, on objects of their own, on one object they all
+ * share, and on objects allocated with GC_allocLocal.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define PAIRS 5000000   // per thread
+
+typedef struct Counting {
+    void* object;
+} Counting_s;
+
+static void* count(void* arg) {
+    void* object = ((Counting_s*) arg)->object;
+    for(unsigned int i = 0; i < PAIRS; i++) {
+        GC_incRef(object);
+        GC_decRef(object);
+    }
+    return NULL;
+}
+
+// Returns pairs per second over all threads. shared: every thread counts the same object.
+static double runCounting(unsigned int threads, bool shared, bool local) {
+    pthread_t workers[threads];
+    Counting_s counting[threads];
+    void* common = GC_alloc(sizeof(int), false);
+    for(unsigned int i = 0; i < threads; i++) {
+        counting[i].object = shared ? common : local ? GC_allocLocal(sizeof(int), false) : GC_alloc(sizeof(int), false);
+    }
+    double start = benchmark_now();
+    for(unsigned int i = 0; i < threads; i++) {
+        pthread_create(&workers[i], NULL, count, &counting[i]);
+    }
+    for(unsigned int i = 0; i < threads; i++) {
+        pthread_join(workers[i], NULL);
+    }
+    double elapsed = benchmark_now() - start;
+    for(unsigned int i = 0; i < threads; i++) {
+        if(!shared) {
+            GC_decRef(counting[i].object);
+        }
+    }
+    GC_decRef(common);
+    return (double) threads * PAIRS / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    unsigned int threadCounts[] = { 1, 2, 4 };
+    printf("%d incRef/decRef pairs per thread\n", PAIRS);
+    for(unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        unsigned int threads = threadCounts[i];
+        printf("  %u thread(s): own %11.0f pairs/s, shared %11.0f pairs/s, local %11.0f pairs/s\n", threads,
+               runCounting(threads, false, false), runCounting(threads, true, false), runCounting(threads, false, true));
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * Throughput benchmark for links between emulated nodes.
+ *
+ * One thread streams small messages to another over a net_link, on Unix datagram and loopback UDP sockets, with
+ * windows of 0 (each send waits for its message to be received) and 64 (sends are coalesced into datagrams), and
+ * reports the throughput of each and how many messages each datagram carried.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "../Channels/net_link.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define MESSAGES 100000
+#define BATCH 64
+
+typedef struct Stream {
+    net_link_t* link;
+    unsigned int window;
+} Stream_s;
+
+static void* produce(void* arg) {
+    Stream_s* stream = arg;
+    int values[BATCH];
+    void* messages[BATCH];
+    size_t lengths[BATCH];
+    unsigned int batch = stream->window > 0 ? BATCH : 1;
+    for(int i = 0; i < MESSAGES; i += batch) {
+        unsigned int n = MESSAGES - i < (int)batch ? (unsigned int)(MESSAGES - i) : batch;
+        for(unsigned int j = 0; j < n; j++) {
+            values[j] = i + j;
+            messages[j] = &values[j];
+            lengths[j] = sizeof(int);
+        }
+        net_link_send(stream->link, messages, lengths, n);
+    }
+    return NULL;
+}
+
+static double runStream(const char* receiver, const char* sender, unsigned int window, double* perDatagram) {
+    net_link_t* in = net_link_open(receiver, NULL, 0);
+    net_link_t* out = net_link_open(sender, receiver, window);
+    if(in == NULL || out == NULL) {
+        return 0;
+    }
+
+    Stream_s stream = { out, window };
+    pthread_t thread;
+    double start = benchmark_now();
+    pthread_create(&thread, NULL, produce, &stream);
+    for(int received = 0; received < MESSAGES; received++) {
+        size_t length;
+        int* value = net_link_receive(in, &length);
+        if(length != sizeof(int) || *value != received) {
+            fprintf(stderr, "Out of order: expected %d\n", received);
+            return 0;
+        }
+        GC_decRef(value);
+    }
+    double elapsed = benchmark_now() - start;
+    pthread_join(thread, NULL);
+
+    struct net_link_stats stats;
+    net_link_getStats(in, &stats);
+    *perDatagram = (double)stats.messages / stats.datagrams;
+    net_link_close(out);
+    net_link_close(in);
+    return MESSAGES / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    char unixIn[64], unixOut[64];
+    snprintf(unixIn, sizeof(unixIn), "unix:/tmp/insense-bench-%d-in", (int)getpid());
+    snprintf(unixOut, sizeof(unixOut), "unix:/tmp/insense-bench-%d-out", (int)getpid());
+    const char* links[][3] = {
+        { "unix", unixIn, unixOut },
+        { "udp", "udp:127.0.0.1:7391", "udp:127.0.0.1:0" },
+    };
+    unsigned int windows[] = { 0, BATCH };
+
+    printf("%d messages of %zu bytes between two links\n", MESSAGES, sizeof(int));
+    for(unsigned int i = 0; i < sizeof(links) / sizeof(links[0]); i++) {
+        double baseline = 0;
+        for(unsigned int j = 0; j < sizeof(windows) / sizeof(windows[0]); j++) {
+            double perDatagram;
+            double throughput = runStream(links[i][1], links[i][2], windows[j], &perDatagram);
+            if(j == 0) {
+                baseline = throughput;
+            }
+            printf("  %-4s window %2u: %10.0f messages/s (%.2fx), %6.1f messages/datagram\n",
+                   links[i][0], windows[j], throughput, throughput / baseline, perDatagram);
+        }
+    }
+    unlink(unixIn + 5);
+    unlink(unixOut + 5);
+    return 0;
+}
@@ -0,0 +1,85 @@
+/*
+ * Rebuilds flattened numbers as a shared or remote channel's receiver does, with and without a recycler, and counts
+ * the heap allocations each message costs.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include "../TypedObject.h"
+#include "../BytecodeTable.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+#include "Benchmark.h"
+
+#define MESSAGES 1000000
+
+static double runReceiver(bool recycle, double* allocationsPerMessage) {
+    int value = 0;
+    TypedObject_PNTR sent = TypedObject_construct(BYTECODE_TYPE_INTEGER, GC_alloc(sizeof(int), false));
+    GC_decRef(TypedObject_getObject(sent));
+    char flattened[16];
+
+    TypedObject_Recycler_s recycler = { { NULL }, 0 };
+    TypedObject_PNTR held = NULL;     // the receiver's variable, overwritten by each message
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    double start = benchmark_now();
+    for(int i = 0; i < MESSAGES; i++) {
+        *(int*)TypedObject_getObject(sent) = i;
+        size_t length = TypedObject_encodeCompact(sent, flattened, sizeof(flattened));
+        TypedObject_PNTR received = recycle ? TypedObject_decodeRecycled(&recycler, flattened, length, true)
+                                            : TypedObject_decodeCompact(flattened, length);
+        value += *(int*)TypedObject_getObject(received) == i;
+        if(held != NULL) {
+            GC_decRef(held);
+        }
+        held = received;
+    }
+    double elapsed = benchmark_now() - start;
+    GC_getStats(&after);
+
+    GC_decRef(held);
+    TypedObject_clearRecycler(&recycler);
+    GC_decRef(sent);
+    if(value != MESSAGES) {
+        fprintf(stderr, "Values received wrongly\n");
+    }
+    *allocationsPerMessage = (double)(after.allocations - before.allocations) / MESSAGES;
+    return MESSAGES / (elapsed / 1e9);
+}
+
+int main(int argc, char* argv[]) {
+    log_init();
+    GC_init();
+    log_setLogLevel(argc == 2 ? argv[1] : "WARNING");
+
+    printf("%d integers received, each kept until the next arrives\n", MESSAGES);
+    double perMessage;
+    double baseline = runReceiver(false, &perMessage);
+    printf("  fresh objects: %10.0f messages/s, %.2f allocations/message\n", baseline, perMessage);
+    double recycled = runReceiver(true, &perMessage);
+    printf("  recycled:      %10.0f messages/s (%.2fx), %.2f allocations/message\n", recycled, recycled / baseline,
+           perMessage);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Contention microbenchmark for the semaphore primitives.
+ *
+ * 1, 2, 8 and 32 threads share a single semaphore, using a binary semaphore as a lock around a counter, and a
+ * counting semaphore as a pool (post then wait). A pthread mutex around the same counter is timed for reference.
+ * Each reports the mean time per operation over all threads.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <stdio.h>
+#include <pthread.h>
+#include "../Channels/my_semaphore.h"
+#include "Benchmark.h"
+
+#define OPERATIONS 1000000
+#define MAX_THREADS 32
+
+typedef enum { BINARY_LOCK, COUNTING_POOL, PTHREAD_MUTEX } Primitive;
+
+static my_sem_t semaphore;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static volatile long counter;
+
+typedef struct Worker {
+    Primitive primitive;
+    int operations;
+} Worker_s;
+
+static void* work(void* arg) {
+    Worker_s* worker = arg;
+    for(int i = 0; i < worker->operations; i++) {
+        switch(worker->primitive) {
+            case BINARY_LOCK:
+                binary_sem_wait(&semaphore);
+                counter++;
+                binary_sem_post(&semaphore);
+                break;
+            case COUNTING_POOL:
+                my_sem_post(&semaphore);
+                my_sem_wait(&semaphore);
+                break;
+            case PTHREAD_MUTEX:
+                pthread_mutex_lock(&mutex);
+                counter++;
+                pthread_mutex_unlock(&mutex);
+                break;
+        }
+    }
+    return NULL;
+}
+
+static double run(Primitive primitive, int threads) {
+    my_sem_init(&semaphore, primitive == BINARY_LOCK ? 1 : 0);
+    counter = 0;
+
+    Worker_s worker = { primitive, OPERATIONS / threads };
+    pthread_t thread[MAX_THREADS];
+    double start = benchmark_now();
+    for(int i = 0; i < threads; i++) {
+        pthread_create(&thread[i], NULL, work, &worker);
+    }
+    for(int i = 0; i < threads; i++) {
+        pthread_join(thread[i], NULL);
+    }
+    double elapsed = benchmark_now() - start;
+
+    my_sem_destroy(&semaphore);
+    if(primitive != COUNTING_POOL && counter != (long)worker.operations * threads) {
+        printf("  lost updates: %ld of %ld\n", (long)worker.operations * threads - counter,
+               (long)worker.operations * threads);
+    }
+    return elapsed / ((double)worker.operations * threads);
+}
+
+int main() {
+    int threadCounts[] = { 1, 2, 8, MAX_THREADS };
+
+    printf("%d operations, ns/operation\n", OPERATIONS);
+    printf("  threads  binary_sem lock  counting_sem pool  pthread_mutex\n");
+    for(unsigned int i = 0; i < sizeof(threadCounts) / sizeof(threadCounts[0]); i++) {
+        printf("  %7d  %15.1f  %17.1f  %13.1f\n", threadCounts[i], run(BINARY_LOCK, threadCounts[i]),
+               run(COUNTING_POOL, threadCounts[i]), run(PTHREAD_MUTEX, threadCounts[i]));
+    }
+    return 0;
+}
@@ -93,6 +93,11 @@
 #define BYTECODE_ANY             41
 #define BYTECODE_PROJECT_ENTRY   42
 #define BYTECODE_PROJECT_EXIT    43
+// Non-blocking channel operations, not (yet) emitted by the Java compiler. Each leaves a bool on the stack saying
+// whether the operation completed; a receive which did pushes the received value first.
+#define BYTECODE_TRY_SEND        44 //TRY_SEND [CHANNEL_NAME]
+#define BYTECODE_TRY_RECEIVE     45 //TRY_RECEIVE [CHANNEL_NAME]
+#define BYTECODE_RECEIVE_TIMEOUT 46 //RECEIVE_TIMEOUT [CHANNEL_NAME], waiting up to the popped integer number of ms
 
 #define BYTECODE_STRUCT_CONSTRUCTOR   1	          // STRUCT_CONSTRUCTOR [NUMBER_OF_PARAMETERS] {[TYPE] {PARAMETER_NAME] ...}
 #define BYTECODE_STRUCT_LOAD          2           // STRUCT_LOAD [FIELD_NAME]
@@ -0,0 +1,254 @@
+/*
+ * Channel configuration.
+ *
+ * Per-channel runtime settings, read from a file in the program directory and keyed by component and channel name.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ChannelConfig.h"
+#include "Collections/ListMap.h"
+#include "GC/GC_mem.h"
+#include "Logger/Logger.h"
+
+#define CHANNELCONFIG_NAME "ChannelConfig"
+#define CHANNELCONFIG_LINE_LENGTH 256
+
+static ListMap_PNTR capacities;     // Component.channel -> unsigned int
+static ListMap_PNTR segments;       // Component.channel -> struct ChannelConfig_segment
+static ListMap_PNTR remotes;        // Component.channel -> struct ChannelConfig_remote
+static pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER; // ListMap lookups move the list's iterator
+
+static bool ChannelConfig_setCapacity(char* key, char* value) {
+    char* end;
+    unsigned long capacity = strtoul(value, &end, 10);
+    if(*value == '\0' || *end != '\0' || capacity == 0 || capacity > 1048576) {
+        return false;
+    }
+
+    unsigned int* stored = GC_alloc(sizeof(unsigned int), false);
+    *stored = (unsigned int)capacity;
+    ListMap_declare(capacities, key);
+    ListMap_put(capacities, key, stored);
+    GC_decRef(stored);
+    return true;
+}
+
+struct ChannelConfig_segment {
+    void (*decRef)(struct ChannelConfig_segment* pntr);
+    char* name;     // shm_open name of the segment
+    size_t size;    // bytes of messages the segment holds, if we create it, or 0 for the default
+};
+
+static void ChannelConfig_segmentDecRef(struct ChannelConfig_segment* this) {
+    GC_decRef(this->name);
+}
+
+static bool ChannelConfig_setSegment(char* key, char* name, char* size) {
+    unsigned long bytes = 0;
+    if(size != NULL) {
+        char* end;
+        bytes = strtoul(size, &end, 10);
+        if(*size == '\0' || *end != '\0' || bytes == 0 || bytes > 1073741824) {
+            return false;
+        }
+    }
+    if(strlen(name) >= CHANNELCONFIG_LINE_LENGTH - 1) {
+        return false;
+    }
+
+    struct ChannelConfig_segment* stored = GC_alloc(sizeof(struct ChannelConfig_segment), true);
+    stored->decRef = ChannelConfig_segmentDecRef;
+    stored->size = bytes;
+    // shm_open names start with a slash, which the configuration can leave out
+    stored->name = GC_alloc(strlen(name) + 2, false);
+    snprintf(stored->name, strlen(name) + 2, "%s%s", name[0] == '/' ? "" : "/", name);
+    ListMap_declare(segments, key);
+    ListMap_put(segments, key, stored);
+    GC_decRef(stored);
+    return true;
+}
+
+struct ChannelConfig_remote {
+    void (*decRef)(struct ChannelConfig_remote* pntr);
+    char* local;            // address to bind
+    char* peer;             // address to send to, or NULL for a receiving channel
+    unsigned int window;    // messages a sender may have in flight unreceived
+};
+
+static void ChannelConfig_remoteDecRef(struct ChannelConfig_remote* this) {
+    GC_decRef(this->local);
+    if(this->peer != NULL) {
+        GC_decRef(this->peer);
+    }
+}
+
+static char* ChannelConfig_copy(char* string) {
+    char* copy = GC_alloc(strlen(string) + 1, false);
+    strcpy(copy, string);
+    return copy;
+}
+
+static bool ChannelConfig_setRemote(char* key, char* local, char* peer, char* window) {
+    unsigned long messages = 0;
+    if(window != NULL) {
+        char* end;
+        messages = strtoul(window, &end, 10);
+        if(*window == '\0' || *end != '\0' || messages > 65535) {
+            return false;
+        }
+    }
+
+    struct ChannelConfig_remote* stored = GC_alloc(sizeof(struct ChannelConfig_remote), true);
+    stored->decRef = ChannelConfig_remoteDecRef;
+    stored->local = ChannelConfig_copy(local);
+    stored->peer = peer != NULL ? ChannelConfig_copy(peer) : NULL;
+    stored->window = (unsigned int)messages;
+    ListMap_declare(remotes, key);
+    ListMap_put(remotes, key, stored);
+    GC_decRef(stored);
+    return true;
+}
+
+// Build the key a channel's settings are stored under. The caller owns the result.
+static char* ChannelConfig_key(char* component, char* channel) {
+    size_t keyLength = strlen(component) + 1 + strlen(channel) + 1;
+    char* key = GC_alloc(keyLength, false);
+    snprintf(key, keyLength, "%s.%s", component, channel);
+    return key;
+}
+
+bool ChannelConfig_load(char* path) {
+    FILE* file = fopen(path, "r");
+    if(file == NULL) {
+        return true;
+    }
+
+    pthread_mutex_lock(&config_mutex);
+    if(capacities == NULL) {
+        capacities = ListMap_constructor();
+        segments = ListMap_constructor();
+        remotes = ListMap_constructor();
+    }
+
+    bool valid = true;
+    char line[CHANNELCONFIG_LINE_LENGTH];
+    int lineNumber = 0;
+    while(fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        char* directive = strtok(line, " \t\r\n");
+        if(directive == NULL || directive[0] == '#') {
+            continue;
+        }
+        char* key = strtok(NULL, " \t\r\n");
+        char* value = strtok(NULL, " \t\r\n");
+        char* option = strtok(NULL, " \t\r\n");
+        char* extra = option != NULL ? strtok(NULL, " \t\r\n") : NULL;
+        bool named = key != NULL && value != NULL && strchr(key, '.') != NULL;
+
+        if(named && strcmp(directive, "buffer") == 0 && option == NULL && ChannelConfig_setCapacity(key, value)) {
+            log_logMessage(INFO, CHANNELCONFIG_NAME, "Channel %s buffers %s items", key, value);
+        } else if(named && strcmp(directive, "shared") == 0 && extra == NULL &&
+                  ChannelConfig_setSegment(key, value, option)) {
+            log_logMessage(INFO, CHANNELCONFIG_NAME, "Channel %s is shared through segment %s", key, value);
+        } else if(named && strcmp(directive, "remote") == 0 && (extra == NULL || strtok(NULL, " \t\r\n") == NULL) &&
+                  ChannelConfig_setRemote(key, value, option, extra)) {
+            log_logMessage(INFO, CHANNELCONFIG_NAME, "Channel %s is remote, on %s%s%s", key, value,
+                           option != NULL ? " to " : "", option != NULL ? option : "");
+        } else {
+            log_logMessage(ERROR, CHANNELCONFIG_NAME, "%s:%d: invalid directive", path, lineNumber);
+            valid = false;
+        }
+    }
+    if(ferror(file)) {
+        log_logMessage(ERROR, CHANNELCONFIG_NAME, "Error reading %s", path);
+        valid = false;
+    }
+    pthread_mutex_unlock(&config_mutex);
+
+    fclose(file);
+    return valid;
+}
+
+unsigned int ChannelConfig_getCapacity(char* component, char* channel) {
+    unsigned int capacity = 0;
+
+    pthread_mutex_lock(&config_mutex);
+    if(capacities != NULL) {
+        char* key = ChannelConfig_key(component, channel);
+        unsigned int* stored = ListMap_get(capacities, key);
+        if(stored != NULL) {
+            capacity = *stored;
+        }
+        GC_decRef(key);
+    }
+    pthread_mutex_unlock(&config_mutex);
+
+    return capacity;
+}
+
+char* ChannelConfig_getSegment(char* component, char* channel, size_t* size) {
+    char* name = NULL;
+
+    pthread_mutex_lock(&config_mutex);
+    if(segments != NULL) {
+        char* key = ChannelConfig_key(component, channel);
+        struct ChannelConfig_segment* stored = ListMap_get(segments, key);
+        if(stored != NULL) {
+            name = stored->name;
+            GC_incRef(name);
+            *size = stored->size;
+        }
+        GC_decRef(key);
+    }
+    pthread_mutex_unlock(&config_mutex);
+
+    return name;
+}
+
+bool ChannelConfig_getRemote(char* component, char* channel, char** local, char** peer, unsigned int* window) {
+    bool remote = false;
+
+    pthread_mutex_lock(&config_mutex);
+    if(remotes != NULL) {
+        char* key = ChannelConfig_key(component, channel);
+        struct ChannelConfig_remote* stored = ListMap_get(remotes, key);
+        if(stored != NULL) {
+            *local = stored->local;
+            GC_incRef(*local);
+            *peer = stored->peer;
+            if(*peer != NULL) {
+                GC_incRef(*peer);
+            }
+            *window = stored->window;
+            remote = true;
+        }
+        GC_decRef(key);
+    }
+    pthread_mutex_unlock(&config_mutex);
+
+    return remote;
+}
@@ -0,0 +1,97 @@
+/*
+ * Channel configuration.
+ *
+ * Per-channel runtime settings, read from a file in the program directory and keyed by component and channel name.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_CHANNELCONFIG_H
+#define CVM_CHANNELCONFIG_H
+
+#include <stdbool.h>
+
+/**
+ * Load channel settings from a configuration file.
+ *
+ * The file holds one directive per line; blank lines and lines starting with '#' are ignored.
+ * Channels are named as Component.channel, e.g.:
+ *
+ *     # let Sender run up to 16 messages ahead of Receiver
+ *     buffer Receiver.input 16
+ *
+ *     # exchange messages on Sender.output with whichever process shares the segment, through a 64KB ring
+ *     shared Sender.output insense-readings 65536
+ *
+ *     # connect Sender.output to a channel on another node, letting it have up to 8 messages in flight
+ *     remote Sender.output udp:127.0.0.1:0 udp:127.0.0.1:7001 8
+ *     remote Receiver.input udp:127.0.0.1:7001
+ *
+ * A missing file is not an error - every channel keeps its default settings.
+ *
+ * @param[in] path Path of the configuration file.
+ *
+ * @return false if the file exists but could not be read or contains invalid directives.
+ */
+bool ChannelConfig_load(char* path);
+
+/**
+ * Get the configured buffer capacity of a channel.
+ *
+ * @param[in] component Name of the component declaring the channel.
+ * @param[in] channel   Name of the channel.
+ *
+ * @return The number of items the channel should buffer, or 0 if it should be unbuffered (synchronous).
+ */
+unsigned int ChannelConfig_getCapacity(char* component, char* channel);
+
+/**
+ * Get the shared memory segment a channel exchanges its messages through, instead of being bound in this process.
+ *
+ * Channels in different CVM processes which name the same segment are connected, whatever their component and
+ * channel names; the segment's size is only used by the process which creates it.
+ *
+ * @param[in]  component Name of the component declaring the channel.
+ * @param[in]  channel   Name of the channel.
+ * @param[out] size      Set to the configured size of the segment in bytes, or 0 for the default, if it is shared.
+ *
+ * @return The segment's shm_open name, which the caller must decRef, or NULL if the channel isn't shared.
+ */
+char* ChannelConfig_getSegment(char* component, char* channel, size_t* size);
+
+/**
+ * Get the socket addresses a channel exchanges its messages through, with a channel on another node.
+ *
+ * Addresses are unix:path or udp:a.b.c.d:port. A receiving channel has just the local address it listens on; a sending
+ * channel has the local address its acknowledgements come back to, the receiver's address, and optionally a window.
+ *
+ * @param[in]  component Name of the component declaring the channel.
+ * @param[in]  channel   Name of the channel.
+ * @param[out] local     Set to the local address, which the caller must decRef, if the channel is remote.
+ * @param[out] peer      Set to the address to send to, which the caller must decRef, or NULL if there isn't one.
+ * @param[out] window    Set to the number of messages a sender may have in flight unreceived; 0 is synchronous.
+ *
+ * @return true if the channel is remote.
+ */
+bool ChannelConfig_getRemote(char* component, char* channel, char** local, char** peer, unsigned int* window);
+
+#endif //CVM_CHANNELCONFIG_H
@@ -28,11 +28,19 @@
 
 #include <stddef.h>
 #include "Channels/channel.h"
+#include "TypedObject.h"
+
+#define CHANNEL_WRAPPER_BATCH 64    //!< Most sends staged, or receives prefetched, on a buffered channel at once.
 
 typedef struct ChannelWrapper ChannelWrapper_s, *ChannelWrapper_PNTR;
 struct ChannelWrapper {
+    void (*decRef)(ChannelWrapper_PNTR pntr);   //!< A pointer to the garbage collection function.
     unsigned int type;
     Channel_PNTR channel;
+    TypedObject_PNTR* batch;    //!< OUT: sends staged for channel_send_n; IN: receives prefetched by channel_receive_n. Traces when tracing (see Trace.h).
+    unsigned int stagedCount;   //!< OUT: number of sends staged in batch, not yet sent.
+    unsigned int prefetchedCount;   //!< IN: number of receives prefetched into batch.
+    unsigned int prefetchedNext;    //!< IN: index of the next prefetched item to hand out.
 };
 
 #endif //CVM_CHANNELWRAPPER_H
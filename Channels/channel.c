@@ -3,7 +3,9 @@
  * Start of channel implementation for UNIX
  *
  * Send, receive, bind, unbind are implemented according to SPIN paper algorithms
- * Select operation is missing
+ * Select polls the chosen channels and sleeps until a sender offers data on one of them
+ * Batched send/receive move several items per lock acquisition on buffered channels
+ * Sends and receives on a labelled channel are counted and timed, see channel_stats.h
  *
  * Absolutely no guarantees with this code, never been tested by me
  *
@@ -13,40 +15,832 @@
  *
  */
 
+#define _POSIX_C_SOURCE 199309L
 #include "channel.h"
+#include "channel_stats.h"
 #include "../Logger/Logger.h"
 #include "my_semaphore.h"
+#include "my_futex.h"
 #include "cstring.h"
-
-pthread_mutex_t conn_op_mutex = PTHREAD_MUTEX_INITIALIZER;	// to prevent connect during disconnect and vice versa
+#include <limits.h>
+#include <time.h>
 
 static void Channel_decRef(Channel_PNTR pntr);
+static void channel_selectorSignal(Channel_PNTR cin);
+static bool channel_multicastTake(Channel_PNTR cin, void *data);
+static int channel_sendOne(Channel_PNTR cout, void *data, void *ex_handler);
+static int channel_receiveOne(Channel_PNTR cin, void *data, bool in_ack_after);
+
+/*
+ * One-to-one fast path.
+ *
+ * When a binding has exactly one sender and one receiver, send and receive rendezvous through a handoff slot
+ * in the receiving channel instead of taking conns_sem, both mutexes and the blocked/actually_received semaphores.
+ * The slot is a single atomic word holding the slot state, some flags, and the epoch of the binding that enabled
+ * it. The sender publishes a pointer to its data (its own buffer field), the receiver copies it out, and the sender
+ * waits until the receiver has taken it, so the blocking rendezvous semantics of the slow path are preserved.
+ * Threads spin briefly and then sleep on the slot word with a futex.
+ *
+ * Bind/unbind clear SPSC_ENABLED whenever the binding stops being one-to-one. A parked receiver then falls back to
+ * the slow path, and a sender whose data was not yet claimed takes it back and falls back too. The epoch stops a
+ * sender from a previous binding from publishing into a slot that has since been given to a different sender.
+ */
+#define SPSC_SLOT_MASK          0x3u	// slot state:
+#define SPSC_EMPTY              0x0u	//   nothing published
+#define SPSC_FULL               0x1u	//   sender has published data
+#define SPSC_TAKEN              0x2u	//   receiver has copied the data, sender may return
+#define SPSC_CLAIMED            0x3u	//   receiver is copying the data
+#define SPSC_ENABLED            0x4u	// binding is one-to-one, fast path may be used
+#define SPSC_RECV_WAITING       0x8u	// receiver is asleep (or about to be) on the slot word
+#define SPSC_SEND_WAITING       0x10u	// sender is asleep (or about to be) on the slot word
+#define SPSC_EPOCH_SHIFT        8
+#define SPSC_EPOCH(state)       ((state) >> SPSC_EPOCH_SHIFT)
+#define SPSC_SPIN_LIMIT         128	// spin this many times before sleeping (if there is another CPU to wait for)
+
+static atomic_bool spsc_allowed = true;
+static atomic_uint spsc_next_epoch;
+
+void channel_setSPSCEnabled(bool enabled) {
+    atomic_store(&spsc_allowed, enabled);
+}
+
+// Stop fast path use on a receiving channel, and kick any thread parked on its slot back into the slow path.
+static void channel_spscDisable(Channel_PNTR cin) {
+    atomic_fetch_and(&(cin->spsc_state), ~SPSC_ENABLED);
+    my_futex_wake(&(cin->spsc_state), INT_MAX);
+}
+
+// Enable the fast path between a lone receiver and lone sender, if neither is part-way through a slow path operation.
+// Both channels' mutexes must be held.
+static void channel_spscTryEnable(Channel_PNTR cin, Channel_PNTR cout) {
+    unsigned int state = atomic_load(&(cin->spsc_state));
+    if(!atomic_load(&spsc_allowed) || cin->capacity > 0 || cin->ready || cout->ready ||
+       (state & SPSC_SLOT_MASK) != SPSC_EMPTY) {
+        return;
+    }
+    unsigned int epoch = (atomic_fetch_add(&spsc_next_epoch, 1) + 1) & (UINT_MAX >> SPSC_EPOCH_SHIFT);
+    cin->spsc_sender = cout;
+    atomic_store(&(cout->spsc_epoch), epoch);
+    atomic_store(&(cout->spsc_peer), cin);
+    atomic_store(&(cin->spsc_state), (epoch << SPSC_EPOCH_SHIFT) | SPSC_ENABLED);
+}
+
+// Returns the receiving channel if the fast path is currently usable by this sender, otherwise NULL.
+static Channel_PNTR channel_spscPeer(Channel_PNTR cout) {
+    Channel_PNTR cin = atomic_load_explicit(&(cout->spsc_peer), memory_order_acquire);
+    if(cin == NULL) {
+        return NULL;
+    }
+    unsigned int state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+    if(!(state & SPSC_ENABLED) || SPSC_EPOCH(state) != atomic_load_explicit(&(cout->spsc_epoch), memory_order_relaxed)) {
+        return NULL;
+    }
+    return cin;
+}
+
+// Send through the handoff slot. Returns false, without having sent, if the fast path can't be used, or if
+// waiting_only and the receiver isn't parked waiting for data.
+static bool channel_spscSend(Channel_PNTR cout, void *data, bool waiting_only) {
+    Channel_PNTR cin = atomic_load_explicit(&(cout->spsc_peer), memory_order_acquire);
+    if(cin == NULL) {
+        return false;
+    }
+    unsigned int epoch = atomic_load_explicit(&(cout->spsc_epoch), memory_order_relaxed);
+    unsigned int state = atomic_load_explicit(&(cin->spsc_state), memory_order_relaxed);
+
+    cout->buffer = data;
+    do {
+        if(!(state & SPSC_ENABLED) || SPSC_EPOCH(state) != epoch || (state & SPSC_SLOT_MASK) != SPSC_EMPTY) {
+            return false;
+        }
+        if(waiting_only && !(state & SPSC_RECV_WAITING)) {
+            return false;
+        }
+    } while(!atomic_compare_exchange_weak_explicit(&(cin->spsc_state), &state,
+                                                   (state & ~(SPSC_SLOT_MASK | SPSC_RECV_WAITING)) | SPSC_FULL,
+                                                   memory_order_release, memory_order_relaxed));
+    if(state & SPSC_RECV_WAITING) {
+        my_futex_wake(&(cin->spsc_state), 1);
+    }
+    atomic_thread_fence(memory_order_seq_cst);	// pairs with the fence in channel_select
+    if(atomic_load_explicit(&(cin->selector), memory_order_relaxed) != NULL) {
+        pthread_mutex_lock(&(cin->mutex));
+        channel_selectorSignal(cin);
+        pthread_mutex_unlock(&(cin->mutex));
+    }
+
+    // wait for the receiver to take the data
+    int spins = 0;
+    state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+    for(;;) {
+        unsigned int slot = state & SPSC_SLOT_MASK;
+        if(slot == SPSC_TAKEN) {
+            if(atomic_compare_exchange_weak_explicit(&(cin->spsc_state), &state,
+                                                     state & ~(SPSC_SLOT_MASK | SPSC_SEND_WAITING),
+                                                     memory_order_acquire, memory_order_acquire)) {
+                return true;
+            }
+            continue;
+        }
+        if(slot == SPSC_FULL && !(state & SPSC_ENABLED)) {
+            // binding changed before the receiver claimed the data; take it back and use the slow path instead
+            if(atomic_compare_exchange_weak_explicit(&(cin->spsc_state), &state,
+                                                     state & ~(SPSC_SLOT_MASK | SPSC_SEND_WAITING),
+                                                     memory_order_acquire, memory_order_acquire)) {
+                return false;
+            }
+            continue;
+        }
+        if(spins < my_spin_limit(SPSC_SPIN_LIMIT)) {
+            spins++;
+            my_cpu_relax();
+            state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+            continue;
+        }
+        if(!(state & SPSC_SEND_WAITING)) {
+            if(!atomic_compare_exchange_weak_explicit(&(cin->spsc_state), &state, state | SPSC_SEND_WAITING,
+                                                      memory_order_acquire, memory_order_acquire)) {
+                continue;
+            }
+            state |= SPSC_SEND_WAITING;
+        }
+        my_futex_wait(&(cin->spsc_state), state);
+        state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+    }
+}
+
+// Take the data published in the handoff slot, if there is any.
+static bool channel_spscTake(Channel_PNTR cin, void *data) {
+    unsigned int state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+    while((state & SPSC_SLOT_MASK) == SPSC_FULL) {
+        if(atomic_compare_exchange_weak_explicit(&(cin->spsc_state), &state, (state & ~SPSC_SLOT_MASK) | SPSC_CLAIMED,
+                                                 memory_order_acquire, memory_order_acquire)) {
+            memncpy(data, cin->spsc_sender->buffer, cin->typesize);
+            state = atomic_fetch_xor_explicit(&(cin->spsc_state), SPSC_CLAIMED ^ SPSC_TAKEN, memory_order_release);
+            if(state & SPSC_SEND_WAITING) {
+                my_futex_wake(&(cin->spsc_state), 1);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+// Receive through the handoff slot. Returns false, without having received, if the fast path can't be used.
+static bool channel_spscReceive(Channel_PNTR cin, void *data) {
+    int spins = 0;
+    unsigned int state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+    for(;;) {
+        if((state & SPSC_SLOT_MASK) == SPSC_FULL) {
+            if(channel_spscTake(cin, data)) {
+                return true;
+            }
+            state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+            continue;
+        }
+        if(!(state & SPSC_ENABLED)) {
+            return false;
+        }
+        if(spins < my_spin_limit(SPSC_SPIN_LIMIT)) {
+            spins++;
+            my_cpu_relax();
+            state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+            continue;
+        }
+        if(!(state & SPSC_RECV_WAITING)) {
+            if(!atomic_compare_exchange_weak_explicit(&(cin->spsc_state), &state, state | SPSC_RECV_WAITING,
+                                                      memory_order_acquire, memory_order_acquire)) {
+                continue;
+            }
+            state |= SPSC_RECV_WAITING;
+        }
+        my_futex_wait(&(cin->spsc_state), state);
+        state = atomic_load_explicit(&(cin->spsc_state), memory_order_acquire);
+    }
+}
+
+/*
+ * Ready queue.
+ *
+ * Each binding has a link, and a sender which finds no receiver waiting puts the link to each receiver on that
+ * receiver's ready queue. A receiver then takes the oldest waiting sender straight off its queue instead of searching
+ * all its connections for one, so it costs the same however many senders are bound, and senders are served in the
+ * order they became ready. A link is only queued once at a time. It stays queued if a different receiver takes the
+ * sender's data, so a receiver skips links whose sender is no longer ready, and frees links unbound while queued.
+ * The queue is protected by the receiving channel's mutex.
+ */
+struct channel_link {
+    Channel_PNTR sender;
+    Channel_PNTR receiver;
+    struct channel_link *next;	// next in the receiver's ready queue
+    bool queued;		// in the receiver's ready queue
+    bool bound;			// cleared by unbind; an unbound link is freed once it is out of the ready queue
+};
+
+// Queue a sender on a receiver, unless it is already queued. Both channels' mutexes must be held.
+static void channel_readyPush(struct channel_link *link) {
+    if(link->queued) {
+        return;
+    }
+    Channel_PNTR cin = link->receiver;
+    link->queued = true;
+    link->next = NULL;
+    if(cin->ready_tail != NULL) {
+        cin->ready_tail->next = link;
+    } else {
+        cin->ready_head = link;
+    }
+    cin->ready_tail = link;
+}
+
+// Dequeue the oldest sender which is still ready, returning it with its mutex locked, or NULL if there isn't one.
+// cin's mutex must be held.
+static Channel_PNTR channel_readyTake(Channel_PNTR cin) {
+    struct channel_link *link;
+    while((link = cin->ready_head) != NULL) {
+        cin->ready_head = link->next;
+        if(cin->ready_head == NULL) {
+            cin->ready_tail = NULL;
+        }
+        link->queued = false;
+        if(!link->bound) {
+            GC_decRef(link);
+            continue;
+        }
+
+        Channel_PNTR match = link->sender;
+        pthread_mutex_lock(&(match->mutex));
+        if(match->ready) {
+            return match;
+        }
+        pthread_mutex_unlock(&(match->mutex));	// another receiver took the data after the link was queued
+    }
+    return NULL;
+}
+
+/*
+ * Buffered channels.
+ *
+ * An IN channel may be given a bounded ring buffer with channel_setCapacity. A sender which finds no receiver waiting
+ * but space in a connected buffer copies its data there and returns straight away. A receiver takes from its buffer
+ * before doing anything else, and each time it does so it moves one waiting sender's data into the freed space, so
+ * senders that found the buffer full block only until the receiver catches up. When the buffer is empty the receiver
+ * rendezvous with senders as usual, which means a receiver is never marked ready while data is left in its buffer.
+ * Items taken in a batch by channel_receive_n still count against the buffer's capacity until the receiver next
+ * receives, by which time it has consumed them, so the buffer and the batch never hold more than the capacity between
+ * them. The buffer is protected by the channel's mutex.
+ */
+
+// Whether the buffer has space for another item. The channel's mutex must be held.
+static inline bool channel_bufferHasSpace(Channel_PNTR cin) {
+    return cin->count + cin->prefetched < cin->capacity;
+}
+
+// Copy data to the tail of the buffer. The channel's mutex must be held, and there must be space.
+static void channel_bufferPut(Channel_PNTR cin, void *data) {
+    unsigned int tail = (cin->head + cin->count) % cin->capacity;
+    memncpy((char*)cin->ring + tail * cin->typesize, data, cin->typesize);
+    cin->count++;
+    if(cin->count > cin->stats.high_water) {
+        cin->stats.high_water = cin->count;
+    }
+}
+
+// Move a sender blocked on a full buffer into the buffer, returning false if there wasn't one. The channel's mutex must
+// be held, and there must be space.
+static bool channel_bufferRefill(Channel_PNTR cin) {
+    if(!channel_bufferHasSpace(cin)) {
+        return false;
+    }
+    Channel_PNTR match = channel_readyTake(cin);
+    if(match == NULL) {
+        return false;
+    }
+    channel_bufferPut(cin, match->buffer);
+    match->ready = false;
+    match->nd_received = true;
+    my_sem_post(&(match->blocked));
+    pthread_mutex_unlock(&(match->mutex));
+    return true;
+}
+
+// Give up the space held for the last batch channel_receive_n took, now that its receiver is back for more, to blocked
+// senders. The channel's mutex must be held.
+static void channel_bufferRelease(Channel_PNTR cin) {
+    if(cin->prefetched > 0) {
+        cin->prefetched = 0;
+        while(channel_bufferRefill(cin));
+    }
+}
+
+// Take the oldest item from the buffer, if there is one. The channel's mutex must be held.
+static bool channel_bufferTake(Channel_PNTR cin, void *data) {
+    channel_bufferRelease(cin);
+    if(cin->count == 0) {
+        return false;
+    }
+    memncpy(data, (char*)cin->ring + cin->head * cin->typesize, cin->typesize);
+    cin->head = (cin->head + 1) % cin->capacity;
+    cin->count--;
+    channel_bufferRefill(cin);
+    return true;
+}
+
+bool channel_setCapacity(Channel_PNTR this, unsigned int capacity) {
+    if(this->direction != CHAN_IN) {
+        log_logMessage(ERROR, "Channels", "Only IN channels can be buffered");
+        return false;
+    }
+
+    pthread_mutex_lock(&(this->mutex));
+    if(this->count > 0) {
+        pthread_mutex_unlock(&(this->mutex));
+        log_logMessage(ERROR, "Channels", "Can't resize the buffer of a channel holding data");
+        return false;
+    }
+    if(this->ring != NULL) {
+        GC_decRef(this->ring);
+        this->ring = NULL;
+    }
+    this->capacity = 0;
+    this->head = 0;
+    this->prefetched = 0;
+    if(capacity > 0) {
+        this->ring = GC_alloc(capacity * this->typesize, false);
+        if(this->ring == NULL) {
+            pthread_mutex_unlock(&(this->mutex));
+            return false;
+        }
+        this->capacity = capacity;
+        channel_spscDisable(this);	// the fast path always waits for the receiver
+    }
+    pthread_mutex_unlock(&(this->mutex));
+
+    return true;
+}
+
+void channel_getBufferStats(Channel_PNTR this, struct channel_buffer_stats *stats) {
+    pthread_mutex_lock(&(this->mutex));
+    *stats = this->stats;
+    stats->capacity = this->capacity;
+    stats->occupancy = this->count;
+    pthread_mutex_unlock(&(this->mutex));
+}
+
+bool channel_isBuffered(Channel_PNTR this) {
+    if(this->transport != NULL) {
+        return this->transport->buffered;
+    }
+    if(this->direction == CHAN_IN) {
+        return this->capacity > 0;
+    }
+
+    // bind and unbind hold the channel's mutex while they change its connections
+    pthread_mutex_lock(&(this->mutex));
+    unsigned int length = conn_set_size(&(this->connections));
+    bool buffered = length > 0;
+    unsigned int i;
+    for(i = 0; i < length && buffered; i++) {
+        Channel_PNTR match = conn_set_get(&(this->connections), i);
+        buffered = match->capacity > 0;
+    }
+    pthread_mutex_unlock(&(this->mutex));
+    return buffered;
+}
+
+/*
+ * Batched transfers.
+ *
+ * channel_send_n copies as many items as fit into a connected buffer under one lock, and only falls back to a
+ * rendezvous for a single item when no buffer has space or a receiver is already waiting. channel_receive_n waits for
+ * one item like channel_receive, then drains whatever else is already buffered without waiting again. Unbuffered
+ * channels still move one item per rendezvous, so the batch calls are only worth using on buffered channels.
+ */
+
+// Copy up to n items to the tail of the buffer, returning the number copied. The channel's mutex must be held.
+static unsigned int channel_bufferPutN(Channel_PNTR cin, char *data, unsigned int n) {
+    unsigned int put = 0;
+    while(put < n && channel_bufferHasSpace(cin)) {
+        unsigned int tail = (cin->head + cin->count) % cin->capacity;
+        unsigned int run = n - put;
+        if(run > cin->capacity - cin->count - cin->prefetched) {
+            run = cin->capacity - cin->count - cin->prefetched;
+        }
+        if(run > cin->capacity - tail) {
+            run = cin->capacity - tail;	// up to the end of the ring; the rest wraps round on the next pass
+        }
+        memcpy((char*)cin->ring + tail * cin->typesize, data + put * cin->typesize, run * cin->typesize);
+        cin->count += run;
+        put += run;
+    }
+    if(cin->count > cin->stats.high_water) {
+        cin->stats.high_water = cin->count;
+    }
+    return put;
+}
+
+// Take up to n of the oldest items from the buffer for a batch, returning the number taken. Their space stays held
+// until the receiver is back for more (see channel_bufferRelease). The channel's mutex must be held.
+static unsigned int channel_bufferTakeN(Channel_PNTR cin, char *data, unsigned int n) {
+    unsigned int taken = 0;
+    while(taken < n && cin->count > 0) {
+        unsigned int run = n - taken;
+        if(run > cin->count) {
+            run = cin->count;
+        }
+        if(run > cin->capacity - cin->head) {
+            run = cin->capacity - cin->head;
+        }
+        memcpy(data + taken * cin->typesize, (char*)cin->ring + cin->head * cin->typesize, run * cin->typesize);
+        cin->head = (cin->head + run) % cin->capacity;
+        cin->count -= run;
+        taken += run;
+    }
+    cin->prefetched += taken;
+    return taken;
+}
+
+// Copy up to n items into the buffer of the first connected receiver with space. Returns the number copied.
+static unsigned int channel_bufferPutBatch(Channel_PNTR cout, char *data, unsigned int n) {
+    binary_sem_wait(&(cout->conns_sem));
+
+    unsigned int put = 0;
+    unsigned int length = conn_set_size(&(cout->connections));
+    Channel_PNTR match;
+    unsigned int i;
+    for(i = 0; i < length && put == 0; i++) {
+        match = conn_set_next(&(cout->connections));
+
+        pthread_mutex_lock(&(match->mutex));
+        // a waiting receiver has an empty buffer and must be handed data directly, by channel_send
+        if(!match->ready && match->capacity > 0) {
+            put = channel_bufferPutN(match, data, n);
+            if(put > 0) {
+                match->stats.buffered_sends += put;
+                channel_selectorSignal(match);
+            }
+        }
+        pthread_mutex_unlock(&(match->mutex));
+    }
+    if(put > 0) {
+        cout->nd_received = true;
+    }
+
+    binary_sem_post(&(cout->conns_sem)); // do post to value 1
+    return put;
+}
+
+static int channel_sendN(Channel_PNTR cout, void *data, unsigned int n, void *ex_handler) {
+    if(cout->transport != NULL && cout->transport->send_n != NULL) {
+        return cout->transport->send_n(cout->transport, data, n);
+    }
+    unsigned int sent = 0;
+    while(sent < n && cout->transport != NULL) {
+        channel_sendOne(cout, (char*)data + sent * cout->typesize, ex_handler);
+        sent++;
+    }
+    while(sent < n) {
+        sent += channel_bufferPutBatch(cout, (char*)data + sent * cout->typesize, n - sent);
+        if(sent < n) {
+            // no room anywhere, or a receiver is waiting; rendezvous for the next item
+            channel_sendOne(cout, (char*)data + sent * cout->typesize, ex_handler);
+            sent++;
+        }
+    }
+    return 0;
+}
+
+static unsigned int channel_receiveN(Channel_PNTR cin, void *data, unsigned int n) {
+    if(n == 0) {
+        return 0;
+    }
+    channel_receiveOne(cin, data, false);
+
+    unsigned int received = 1;
+    if(cin->capacity > 0 || atomic_load(&(cin->multicast_pending)) > 0) {
+        pthread_mutex_lock(&(cin->mutex));
+        if(cin->capacity > 0) {
+            received += channel_bufferTakeN(cin, (char*)data + received * cin->typesize, n - received);
+        }
+        while(received < n && channel_multicastTake(cin, (char*)data + received * cin->typesize)) {
+            received++;
+        }
+        pthread_mutex_unlock(&(cin->mutex));
+    }
+    return received;
+}
+
+/*
+ * Select.
+ *
+ * channel_select first polls its channels, taking data that is already waiting: buffered, published in a fast path
+ * slot, or offered by a sender parked on the slow path. If there is none, it registers a selector on every channel
+ * and polls again, so that nothing offered in between is missed, then sleeps on the selector until a sender signals
+ * it. A selected channel is never marked ready, so senders park as if nobody were receiving, and signal the selector
+ * of each channel they offer their data to; whichever signal comes first wakes the select, and later ones are no-ops.
+ * A try sender can't park, so once the select is asleep it hands its data straight to the selector instead, and the
+ * select returns the channel it came on as if a poll had found it.
+ */
+#define SELECTOR_POLLING        0	// registered, but still polling its channels
+#define SELECTOR_WAITING        1	// asleep, and able to take data from a try sender
+#define SELECTOR_SIGNALLED      2	// woken to poll again, or given up at its deadline
+#define SELECTOR_DELIVERING     3	// a try sender is copying its data into the select's buffer
+#define SELECTOR_DELIVERED      4	// the select's buffer holds data sent on delivered_on
+
+struct channel_selector {
+    atomic_uint state;
+    void *buffer;               // the select's buffer
+    Channel_PNTR delivered_on;  // the channel a try sender delivered to
+};
+
+// Wake the select waiting on a channel, if there is one. The channel's mutex must be held.
+static void channel_selectorSignal(Channel_PNTR cin) {
+    struct channel_selector *selector = atomic_load_explicit(&(cin->selector), memory_order_relaxed);
+    if(selector == NULL) {
+        return;
+    }
+    unsigned int state = atomic_load(&(selector->state));
+    while(state == SELECTOR_POLLING || state == SELECTOR_WAITING) {
+        if(atomic_compare_exchange_weak(&(selector->state), &state, SELECTOR_SIGNALLED)) {
+            if(state == SELECTOR_WAITING) {
+                my_futex_wake(&(selector->state), 1);
+            }
+            return;
+        }
+    }
+}
+
+// Hand data straight to the select asleep on a channel, returning false if there isn't one. The channel's mutex must
+// be held.
+static bool channel_selectorDeliver(Channel_PNTR cin, void *data) {
+    struct channel_selector *selector = atomic_load_explicit(&(cin->selector), memory_order_relaxed);
+    unsigned int expected = SELECTOR_WAITING;
+    if(selector == NULL || !atomic_compare_exchange_strong(&(selector->state), &expected, SELECTOR_DELIVERING)) {
+        return false;
+    }
+    memncpy(selector->buffer, data, cin->typesize);
+    selector->delivered_on = cin;
+    atomic_store(&(selector->state), SELECTOR_DELIVERED);
+    my_futex_wake(&(selector->state), 1);
+    return true;
+}
+
+// Receive from a channel if data is already waiting, without blocking.
+static bool channel_tryPull(Channel_PNTR cin, void *data) {
+    if(channel_spscTake(cin, data)) {
+        return true;
+    }
+
+    pthread_mutex_lock(&(cin->mutex));
+    if(channel_bufferTake(cin, data) || channel_multicastTake(cin, data)) {
+        pthread_mutex_unlock(&(cin->mutex));
+        return true;
+    }
+    Channel_PNTR match = channel_readyTake(cin);
+    if(match != NULL) {
+        memncpy(data, match->buffer, cin->typesize);
+        match->ready = false;
+        match->nd_received = true;
+        my_sem_post(&(match->blocked));
+        pthread_mutex_unlock(&(match->mutex));
+        pthread_mutex_unlock(&(cin->mutex));
+        return true;
+    }
+    pthread_mutex_unlock(&(cin->mutex));
+    return false;
+}
+
+// Poll each channel once, starting where the last successful poll left off.
+static int channel_selectPoll(struct select_struct *s) {
+    int i;
+    for(i = 0; i < s->nchans; i++) {
+        unsigned int index = (s->next + i) % s->nchans;
+        if(channel_tryPull(s->chans[index], s->buffer)) {
+            s->next = index + 1;
+            return index;
+        }
+    }
+    return -1;
+}
+
+static void channel_selectRegister(struct select_struct *s, struct channel_selector *selector) {
+    int i;
+    for(i = 0; i < s->nchans; i++) {
+        pthread_mutex_lock(&(s->chans[i]->mutex));
+        atomic_store(&(s->chans[i]->selector), selector);
+        pthread_mutex_unlock(&(s->chans[i]->mutex));
+    }
+}
+
+// As channel_select, but giving up at deadline (on CLOCK_MONOTONIC) if it isn't NULL. -1 if it did.
+static int channel_selectUntil(struct select_struct *s, const struct timespec *deadline) {
+    int i;
+    for(i = 0; i < s->nchans; i++) {
+        if(s->chans[i]->direction != CHAN_IN) {
+            log_logMessage(ERROR, "Channels", "Can only select on IN channels");
+            return -1;
+        }
+        if(s->chans[i]->transport != NULL) {
+            log_logMessage(ERROR, "Channels", "Can't select on a channel with a transport");
+            return -1;
+        }
+    }
+    if(s->nchans == 0 && !s->have_default) {
+        log_logMessage(ERROR, "Channels", "Select with no channels and no default would wait forever");
+        return -1;
+    }
+
+    struct channel_selector selector;
+    for(;;) {
+        int chosen = channel_selectPoll(s);
+        if(chosen >= 0 || s->have_default) {
+            return chosen;
+        }
+
+        atomic_init(&(selector.state), SELECTOR_POLLING);
+        selector.buffer = s->buffer;
+        selector.delivered_on = NULL;
+        channel_selectRegister(s, &selector);
+        atomic_thread_fence(memory_order_seq_cst);	// pairs with the fence in channel_spscSend
+        chosen = channel_selectPoll(s);
+        bool expired = false;
+        unsigned int state = SELECTOR_POLLING;
+        if(chosen < 0 && atomic_compare_exchange_strong(&(selector.state), &state, SELECTOR_WAITING)) {
+            state = SELECTOR_WAITING;
+            while(state == SELECTOR_WAITING || state == SELECTOR_DELIVERING) {
+                if(deadline == NULL || state == SELECTOR_DELIVERING) {
+                    my_futex_wait(&(selector.state), state);
+                } else if(!my_futex_wait_until(&(selector.state), state, deadline)) {
+                    // give up, unless a try sender has just claimed the selector
+                    expired = atomic_compare_exchange_strong(&(selector.state), &state, SELECTOR_SIGNALLED);
+                }
+                state = atomic_load(&(selector.state));
+            }
+        }
+        channel_selectRegister(s, NULL);
+
+        if(atomic_load(&(selector.state)) == SELECTOR_DELIVERED) {
+            for(chosen = 0; s->chans[chosen] != selector.delivered_on; chosen++);
+            s->next = chosen + 1;
+            return chosen;
+        }
+        if(chosen >= 0) {
+            return chosen;
+        }
+        if(expired) {
+            // take anything offered since the last poll, rather than leave it for the next receive
+            return channel_selectPoll(s);
+        }
+    }
+}
+
+static int channel_selectOne(struct select_struct *s) {
+    return channel_selectUntil(s, NULL);
+}
+
+/*
+ * Multicast.
+ *
+ * channel_multicast_send copies the data once into a refcounted payload and, in a single pass over its connections,
+ * hands a reference to every bound receiver: directly to a receiver already parked on the slow path, otherwise
+ * onto the receiver's queue of pending multicasts, which receive, select and the buffer checks drain before
+ * rendezvousing with ordinary senders. Receivers copy from the shared payload. Like an ordinary send, the sender
+ * waits until every receiver has taken the data, but only once, on a single semaphore posted by the last receiver.
+ * Unbinding a receiver drops its pending payloads from that sender so the sender is not left waiting. A sender bound
+ * one-to-one has nobody to share the data with, so it sends through the fast path as usual and leaves it in place.
+ */
+struct channel_multicast {
+    void (*decRef)(struct channel_multicast *pntr);
+    Channel_PNTR origin;        // the sending channel
+    atomic_uint remaining;      // receivers yet to take or drop the payload, plus one while the sender is publishing
+    my_sem_t done;              // posted when remaining reaches zero
+    uint64_t published;         // CLOCK_MONOTONIC time of publication, in ns
+    char data[];                // typesize bytes of data
+};
+
+static void channel_multicastDecRef(struct channel_multicast *this) {
+    my_sem_destroy(&(this->done));
+}
+
+static uint64_t channel_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// Record that cin has received a multicast published at the given time. cin's mutex must be held.
+static void channel_multicastDelivered(Channel_PNTR cin, uint64_t published) {
+    uint64_t latency = channel_now() - published;
+    cin->multicast_stats.delivered++;
+    cin->multicast_stats.total_latency += latency;
+    if(latency > cin->multicast_stats.max_latency) {
+        cin->multicast_stats.max_latency = latency;
+    }
+}
+
+// Record that cin has received (or dropped) a payload, releasing the sender if it was the last. cin's mutex must be held.
+static void channel_multicastDone(Channel_PNTR cin, struct channel_multicast *payload, bool delivered) {
+    if(delivered) {
+        channel_multicastDelivered(cin, payload->published);
+    } else {
+        cin->multicast_stats.dropped++;
+        if(cin->references) {
+            GC_decRef(*(void**)payload->data);	// the reference this receiver would have been given
+        }
+    }
+    if(atomic_fetch_sub(&(payload->remaining), 1) == 1) {
+        my_sem_post(&(payload->done));
+    }
+}
+
+// Remove a payload from the pending queue, returning a reference owned by the caller. cin's mutex must be held.
+static struct channel_multicast* channel_multicastDequeue(Channel_PNTR cin, struct channel_multicast *payload) {
+    GC_incRef(payload);
+    IteratedList_removeElement(cin->multicasts, payload);
+    atomic_fetch_sub(&(cin->multicast_pending), 1);
+    return payload;
+}
+
+// Take the oldest pending multicast, if there is one. cin's mutex must be held.
+static bool channel_multicastTake(Channel_PNTR cin, void *data) {
+    if(IteratedList_isEmpty(cin->multicasts)) {
+        return false;
+    }
+    struct channel_multicast *payload = channel_multicastDequeue(cin, IteratedList_getElementN(cin->multicasts, 0));
+    memncpy(data, payload->data, cin->typesize);
+    channel_multicastDone(cin, payload, true);
+    GC_decRef(payload);
+    return true;
+}
+
+// Drop payloads from cout that cin has not received yet. Both channels' mutexes must be held.
+static void channel_multicastDrop(Channel_PNTR cin, Channel_PNTR cout) {
+    unsigned int i = 0;
+    while(i < IteratedList_getListLength(cin->multicasts)) {
+        struct channel_multicast *payload = IteratedList_getElementN(cin->multicasts, i);
+        if(payload->origin == cout) {
+            payload = channel_multicastDequeue(cin, payload);
+            channel_multicastDone(cin, payload, false);
+            GC_decRef(payload);
+        } else {
+            i++;
+        }
+    }
+}
+
+void channel_getMulticastStats(Channel_PNTR this, struct channel_multicast_stats *stats) {
+    pthread_mutex_lock(&(this->mutex));
+    *stats = this->multicast_stats;
+    pthread_mutex_unlock(&(this->mutex));
+}
 
 
 void initialise_sems_and_mutexes(Channel_PNTR this){
     // Initialise mutexes and semaphores
     pthread_mutex_init(&(this->mutex), NULL);
+    pthread_mutex_init(&(this->topology), NULL);
     my_sem_init(&(this->conns_sem), 0);
     my_sem_init(&(this->blocked), 0);
     my_sem_init(&(this->actually_received), 0);
+    atomic_init(&(this->spsc_state), 0);
+    atomic_init(&(this->spsc_peer), NULL);
+    atomic_init(&(this->spsc_epoch), 0);
+    atomic_init(&(this->selector), NULL);
+    atomic_init(&(this->multicast_pending), 0);
 }
 
+static void channel_children(void *pntr, GC_visitFunc_t visit, void *context);
+
 Channel_PNTR channel_create(chan_dir direction, int typesize) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, "Channels", "Creating channel (%s, size %d)", (direction == CHAN_IN) ? "in" : "out", typesize);
 #endif
-    Channel_PNTR this = (Channel_PNTR)GC_alloc(sizeof(struct Channel), true);
+    Channel_PNTR this = (Channel_PNTR)GC_allocType(sizeof(struct Channel), true, "Channel");
     if(this == (void*) 0){
         log_logMessage(ERROR, "Channels", "Channel not created - OOM?");
         return NULL;
     }
 
     this->decRef = Channel_decRef;
+    GC_registerChildren((decRefFunc_t) Channel_decRef, channel_children);
     this->direction = direction;
     this->typesize = typesize;
+    this->references = false;
     this->ready = false;
     this->nd_received = false;
-    GC_assign(&(this->connections), IteratedList_constructList());	// empty list of connections
+    this->capacity = 0;
+    this->ring = NULL;
+    this->head = 0;
+    this->count = 0;
+    this->prefetched = 0;
+    this->multicast = NULL;
+    this->ready_head = NULL;
+    this->ready_tail = NULL;
+    this->transport = NULL;
+    this->stats_id = 0;
+    this->measure = NULL;
+    conn_set_init(&(this->connections));	// empty set of connections
+    this->multicasts = IteratedList_constructList();
 
     initialise_sems_and_mutexes(this);
 
@@ -55,138 +849,292 @@ Channel_PNTR channel_create(chan_dir direction, int typesize) {
     return(this);
 }
 
+/*
+ * A reference channel carries a pointer to a GC object instead of a value. The sender passes the address of its
+ * pointer and gives up its reference; the receiver gets the pointer and owns that reference, so however large the
+ * object, a send costs a pointer copy. The channel only has to act on the reference itself where the number of
+ * receivers isn't one: a multicast gives each receiver a reference of its own, and references left in a buffer or
+ * dropped from a multicast queue are released.
+ */
+Channel_PNTR channel_createReference(chan_dir direction) {
+    Channel_PNTR this = channel_create(direction, sizeof(void*));
+    if(this != NULL) {
+        this->references = true;
+    }
+    return this;
+}
 
 void Channel_decRef(Channel_PNTR this){
     channel_unbind(this);                   // disconnect from all other chans
-    GC_decRef(this->connections);          // GC connections list
+    conn_set_destroy(&(this->connections));
+    pthread_mutex_lock(&(this->mutex));
+    channel_readyTake(this);	// frees the links left queued, all unbound by now
+    pthread_mutex_unlock(&(this->mutex));
+    GC_decRef(this->multicasts);
+    if(this->multicast_stats.delivered > 0 || this->multicast_stats.dropped > 0) {
+        log_logMessage(INFO, "Channels", "Multicast subscriber ID %p: %lu delivered, %lu dropped, latency mean %.0f ns, max %llu ns",
+                       (void*)this, this->multicast_stats.delivered, this->multicast_stats.dropped,
+                       this->multicast_stats.delivered > 0 ?
+                           (double)this->multicast_stats.total_latency / this->multicast_stats.delivered : 0.0,
+                       (unsigned long long)this->multicast_stats.max_latency);
+    }
+    if(this->ring != NULL) {
+        log_logMessage(INFO, "Channels", "Buffered channel ID %p: capacity %u, high water %u, %lu buffered sends, %lu full",
+                       (void*)this, this->capacity, this->stats.high_water, this->stats.buffered_sends,
+                       this->stats.full_sends);
+        if(this->references) {
+            for(unsigned int i = 0; i < this->count; i++) {
+                GC_decRef(((void**)this->ring)[(this->head + i) % this->capacity]);
+            }
+        }
+        GC_decRef(this->ring);
+    }
+    if(this->transport != NULL) {
+        this->transport->close(this->transport);
+        GC_decRef(this->transport);
+    }
     pthread_mutex_destroy(&(this->mutex));
+    pthread_mutex_destroy(&(this->topology));
     my_sem_destroy( &(this->conns_sem) );		// now destroy mutexes and semaphores
     my_sem_destroy( &(this->blocked) );
     my_sem_destroy( &(this->actually_received) );
 }
 
+// For the cycle collector: the channels bound to this one (each set holds a reference to its members, which unbinding
+// drops), and on a reference channel, what is left in the buffer.
+static void channel_children(void *pntr, GC_visitFunc_t visit, void *context) {
+    Channel_PNTR this = pntr;
+    pthread_mutex_lock(&(this->mutex));
+    for(unsigned int i = 0; i < conn_set_size(&(this->connections)); i++) {
+        visit(conn_set_get(&(this->connections), i), context);
+    }
+    if(this->references) {
+        for(unsigned int i = 0; i < this->count; i++) {
+            visit(((void**)this->ring)[(this->head + i) % this->capacity], context);
+        }
+    }
+    pthread_mutex_unlock(&(this->mutex));
+}
+
+
+/*
+ * Bind and unbind.
+ *
+ * Each channel's topology mutex serialises binds and unbinds involving it, so rewiring unrelated channels never
+ * contends. A connection set is only changed with the channel's conns_sem and mutex both held: senders and receivers
+ * walk their own set holding conns_sem, and buffer refills and select walk it holding the mutex. An empty set's
+ * conns_sem is 0, but nothing can be walking it then, so it only has to be taken while there are connections.
+ * Locks are always taken IN channel before OUT channel, in the order topology, conns_sem, mutex.
+ */
+
+// Lock the topology of both ends of a binding.
+static void channel_lockTopology(Channel_PNTR cin, Channel_PNTR cout) {
+    pthread_mutex_lock(&(cin->topology));
+    pthread_mutex_lock(&(cout->topology));
+}
+
+static void channel_unlockTopology(Channel_PNTR cin, Channel_PNTR cout) {
+    pthread_mutex_unlock(&(cout->topology));
+    pthread_mutex_unlock(&(cin->topology));
+}
 
 bool channel_bind(Channel_PNTR id1, Channel_PNTR id2) {
     log_logMessage(INFO, "Channels", "Binding channels ID1: %d and ID2: %d", id1, id2);
 
-    pthread_mutex_lock(&conn_op_mutex);
-
     // check not both CHAN_IN or CHAN_OUT
     if(id1->direction == id2->direction) {
         log_logMessage(ERROR, "Channels", "Bind directions are the same");
-        pthread_mutex_unlock(&conn_op_mutex);
         return false;
     }
     if (id1->typesize != id2->typesize) {
         log_logMessage(ERROR, "Channels", "Bind typesizes are different");
-        pthread_mutex_unlock(&conn_op_mutex);
+        return false;
+    }
+    if(id1->transport != NULL || id2->transport != NULL) {
+        log_logMessage(WARNING, "Channels", "Channels with a transport can't be bound locally");
         return false;
     }
 
-    pthread_mutex_lock(id1->direction == CHAN_IN ? &(id1->mutex) : &(id2->mutex));
-    pthread_mutex_lock(id1->direction == CHAN_IN ? &(id2->mutex) : &(id1->mutex));
+    Channel_PNTR cin = id1->direction == CHAN_IN ? id1 : id2;
+    Channel_PNTR cout = id1->direction == CHAN_IN ? id2 : id1;
+    channel_lockTopology(cin, cout);
 
     // check not already connected
-    // assuming bind always adds to both channels' lists, we only need to check one channel for the other
-    if(IteratedList_containsElement(id1->connections, (void*)id2)) {
-        pthread_mutex_unlock(&conn_op_mutex);
+    // bind always adds to both channels' sets, so we only need to check one channel for the other
+    if(conn_set_contains(&(cin->connections), cout)) {
+        channel_unlockTopology(cin, cout);
         return false;
     }
 
-    // add to conns lists
-    IteratedList_insertElement(id1->connections, id2);
-    IteratedList_insertElement(id2->connections, id1);
-    //TODO: ????
-    // JL to counter garbage collection code in insertElement
-//    DAL_modRef_by_n(id1, -1);
-//    DAL_modRef_by_n(id2, -1);
+    // wait for anyone walking the connection sets to finish
+    if(conn_set_size(&(cin->connections)) > 0) {
+        binary_sem_wait(&(cin->conns_sem));
+    }
+    if(conn_set_size(&(cout->connections)) > 0) {
+        binary_sem_wait(&(cout->conns_sem));
+    }
+    pthread_mutex_lock(&(cin->mutex));
+    pthread_mutex_lock(&(cout->mutex));
+
+    // add to conns sets; each set holds a reference to its members
+    struct channel_link *link = GC_alloc(sizeof(struct channel_link), false);
+    link->sender = cout;
+    link->receiver = cin;
+    link->bound = true;
+    conn_set_add(&(cin->connections), cout, link);
+    conn_set_add(&(cout->connections), cin, link);
+    GC_incRef(cout);
+    GC_incRef(cin);
+    if(cout->ready) {
+        channel_readyPush(link);	// the sender is already waiting for a receiver
+    }
+
+    // switch to the one-to-one fast path, or out of it if either side now has other connections
+    Channel_PNTR previousPeer = atomic_load(&(cout->spsc_peer));
+    if(previousPeer != NULL && previousPeer != cin) {
+        channel_spscDisable(previousPeer);
+    }
+    atomic_store(&(cout->spsc_peer), NULL);
+    channel_spscDisable(cin);
+    if(cin->spsc_sender != NULL && conn_set_contains(&(cin->connections), cin->spsc_sender)) {
+        // the old sender would see the slot disabled anyway; this just saves it from looking
+        Channel_PNTR expected = cin;
+        atomic_compare_exchange_strong(&(cin->spsc_sender->spsc_peer), &expected, NULL);
+    }
+    if(conn_set_size(&(cin->connections)) == 1 && conn_set_size(&(cout->connections)) == 1) {
+        channel_spscTryEnable(cin, cout);
+    }
 
     // unlock conns mutex in both channels
     // never allow semaphores to go above 1; make it act like a mutex or binary semaphore
-    binary_sem_post(&(id1->conns_sem)); // do post to value 1
-    binary_sem_post(&(id2->conns_sem));
+    binary_sem_post(&(cin->conns_sem)); // do post to value 1
+    binary_sem_post(&(cout->conns_sem));
 
-    pthread_mutex_unlock(&(id1->mutex));
-    pthread_mutex_unlock(&(id2->mutex));
+    pthread_mutex_unlock(&(cout->mutex));
+    pthread_mutex_unlock(&(cin->mutex));
 
-    pthread_mutex_unlock(&conn_op_mutex);
+    channel_unlockTopology(cin, cout);
     return true;
 }
 
 void channel_unbind(Channel_PNTR id) {
-    pthread_mutex_lock(&conn_op_mutex);
-
     log_logMessage(INFO, "Channels", "Unbinding channel ID: %d", id);
 
-    // iterate through list, locking then disconnecting
-    unsigned int length = IteratedList_getListLength(id->connections);
-    Channel_PNTR opposite; // channel on the opposite side of current connection
-    unsigned int i;
-    for(i = 0; i < length; i++) {
-        opposite = IteratedList_getElementN(id->connections, i);	// fetch current opposite half-channel
+    for(;;) {
+        // pick a connection; it has to be checked again once both ends are locked in order
+        pthread_mutex_lock(&(id->topology));
+        Channel_PNTR opposite = conn_set_get(&(id->connections), 0);	// channel on the opposite side of the connection
+        if(opposite != NULL) {
+            GC_incRef(opposite);
+        }
+        pthread_mutex_unlock(&(id->topology));
+        if(opposite == NULL) {
+            break;
+        }
 
-        binary_sem_wait(id->direction == CHAN_IN ? &(id->conns_sem) : &(opposite->conns_sem) );
-        binary_sem_wait(id->direction == CHAN_IN ? &(opposite->conns_sem) : &(id->conns_sem) );
-        pthread_mutex_lock(id->direction == CHAN_IN ? &(id->mutex) : &(opposite->mutex) );
-        pthread_mutex_lock(id->direction == CHAN_IN ? &(opposite->mutex) : &(id->mutex) );
+        Channel_PNTR cin = id->direction == CHAN_IN ? id : opposite;
+        Channel_PNTR cout = id->direction == CHAN_IN ? opposite : id;
+        channel_lockTopology(cin, cout);
+        bool connected = conn_set_contains(&(cin->connections), cout);
+        if(connected) {
+            binary_sem_wait(&(cin->conns_sem));
+            binary_sem_wait(&(cout->conns_sem));
+            pthread_mutex_lock(&(cin->mutex));
+            pthread_mutex_lock(&(cout->mutex));
 
-        //TODO: ????
-        // JL to counter garbage collection code in removeElement
-//        DAL_modRef_by_n(id, 2);
-//        DAL_modRef_by_n(opposite, 2);
-        IteratedList_removeElement(id->connections, opposite);
-        IteratedList_removeElement(opposite->connections, id);
-//        DAL_modRef_by_n(id, -1);
-//        DAL_modRef_by_n(opposite, -1);
+            channel_spscDisable(cin);
+            atomic_store(&(cout->spsc_peer), NULL);
+            channel_multicastDrop(cin, cout);
+            struct channel_link *link = conn_set_lookup(&(cin->connections), cout);
+            conn_set_remove(&(cin->connections), cout);
+            conn_set_remove(&(cout->connections), cin);
+            link->bound = false;
+            if(!link->queued) {
+                GC_decRef(link);	// otherwise the receiver frees it when it comes off the ready queue
+            }
 
-        pthread_mutex_unlock(&(id->mutex));
-        pthread_mutex_unlock(&(opposite->mutex));
+            pthread_mutex_unlock(&(cout->mutex));
+            pthread_mutex_unlock(&(cin->mutex));
 
-        if(!IteratedList_isEmpty(id->connections)) {
-            binary_sem_post(&(id->conns_sem));
+            if(conn_set_size(&(cin->connections)) > 0) {
+                binary_sem_post(&(cin->conns_sem));
+            }
+            if(conn_set_size(&(cout->connections)) > 0) {
+                binary_sem_post(&(cout->conns_sem));
+            }
         }
-        if(!IteratedList_isEmpty(opposite->connections)){
-            binary_sem_post(&(opposite->conns_sem));
+        channel_unlockTopology(cin, cout);
+
+        // release the sets' references once nothing is locked, in case either channel is freed
+        if(connected) {
+            GC_decRef(cin);
+            GC_decRef(cout);
         }
-        length = IteratedList_getListLength(id->connections);
+        GC_decRef(opposite);
     }
-
-    pthread_mutex_unlock(&conn_op_mutex);
-    return;
 }
 
-int channel_select(struct select_struct *s) {
-    log_logMessage(WARNING, "Channels", "Called channel_select with struct %p, but this method always returns 0!", (void*)s);
-    return 0;
+/*
+ * Transports.
+ *
+ * A channel with a transport exchanges data with a channel in another process instead of with channels bound to it:
+ * send and receive pass straight through to the transport, and binding the channel locally is refused. The transport
+ * takes data over as a local receiver would, so on a reference channel it is handed the sender's reference and fills
+ * a receiver's buffer with a reference of the receiver's own. Select doesn't support transports.
+ */
+bool channel_setTransport(Channel_PNTR this, struct channel_transport *transport) {
+    pthread_mutex_lock(&(this->topology));
+    if(conn_set_size(&(this->connections)) > 0 || this->transport != NULL) {
+        pthread_mutex_unlock(&(this->topology));
+        log_logMessage(ERROR, "Channels", "Can't give a bound channel a transport");
+        return false;
+    }
+    this->transport = transport;
+    pthread_mutex_unlock(&(this->topology));
+    return true;
 }
 
-int channel_send(Channel_PNTR cout, void *data, void *ex_handler) {
+static int channel_sendOne(Channel_PNTR cout, void *data, void *ex_handler) {
+    if(cout->transport != NULL) {
+        return cout->transport->send(cout->transport, data);
+    }
+    if(channel_spscSend(cout, data, false)) {
+        return 0;
+    }
+
     binary_sem_wait(&(cout->conns_sem));
     pthread_mutex_lock(&(cout->mutex));
+    if(channel_spscPeer(cout) != NULL) {
+        // bound one-to-one while we were waiting for a connection
+        pthread_mutex_unlock(&(cout->mutex));
+        binary_sem_post(&(cout->conns_sem));
+        return channel_sendOne(cout, data, ex_handler);
+    }
 
     cout->buffer = data;
     cout->ready = true;
     pthread_mutex_unlock(&(cout->mutex));
 
     // iterate through connection list, looking for receiver that is ready
-    unsigned int length = IteratedList_getListLength(cout->connections);
+    unsigned int length = conn_set_size(&(cout->connections));
     Channel_PNTR match; // current receiver
     unsigned int i;
     for(i = 0; i < length; i++) {
-        match = IteratedList_getNextElement(cout->connections);	// fetch next channel in conns list (which keeps state across calls)
+        match = conn_set_next(&(cout->connections));	// fetch next channel in conns set (which keeps state across calls)
 
         pthread_mutex_lock(&(match->mutex));
         pthread_mutex_lock(&(cout->mutex));
 
         if(match->ready && cout->ready) {
             match->buffer = cout->buffer;
+            match->sender = cout;
             match->ready = false;
             cout->ready = false;
             cout->nd_received = true;
             my_sem_post(&(match->blocked));
             pthread_mutex_unlock(&(cout->mutex));
             pthread_mutex_unlock(&(match->mutex));
-            my_sem_wait(&(match->actually_received));
+            my_sem_wait(&(cout->actually_received));
 
             // unlock conns semaphore
             binary_sem_post(&(cout->conns_sem)); // do post to value 1
@@ -194,6 +1142,28 @@ int channel_send(Channel_PNTR cout, void *data, void *ex_handler) {
             return 0;
         }
 
+        if(cout->ready && match->capacity > 0) {
+            if(channel_bufferHasSpace(match)) {
+                // no need to wait for the receiver, leave the data in its buffer
+                channel_bufferPut(match, cout->buffer);
+                match->stats.buffered_sends++;
+                channel_selectorSignal(match);
+                cout->ready = false;
+                cout->nd_received = true;
+                pthread_mutex_unlock(&(cout->mutex));
+                pthread_mutex_unlock(&(match->mutex));
+
+                binary_sem_post(&(cout->conns_sem)); // do post to value 1
+
+                return 0;
+            }
+            match->stats.full_sends++;
+        }
+        if(cout->ready) {
+            channel_readyPush(conn_set_lookup(&(cout->connections), match));
+            channel_selectorSignal(match);	// a select on match can now take our data
+        }
+
         pthread_mutex_unlock(&(cout->mutex));
         pthread_mutex_unlock(&(match->mutex));
     }
@@ -204,51 +1174,402 @@ int channel_send(Channel_PNTR cout, void *data, void *ex_handler) {
     return 0;
 }
 
-int channel_receive(Channel_PNTR cin, void *data, bool in_ack_after) {
+static int channel_receiveOne(Channel_PNTR cin, void *data, bool in_ack_after) {
+    if(cin->transport != NULL) {
+        return cin->transport->receive(cin->transport, data);
+    }
+    if(cin->capacity > 0 || atomic_load(&(cin->multicast_pending)) > 0) {
+        // buffered data can be collected even if the channel has since been unbound
+        pthread_mutex_lock(&(cin->mutex));
+        bool taken = channel_bufferTake(cin, data) || channel_multicastTake(cin, data);
+        pthread_mutex_unlock(&(cin->mutex));
+        if(taken) {
+            return 0;
+        }
+    }
+    if(channel_spscReceive(cin, data)) {
+        return 0;
+    }
+
     binary_sem_wait(&(cin->conns_sem));
     pthread_mutex_lock(&(cin->mutex));
+    unsigned int state = atomic_load(&(cin->spsc_state));
+    if((state & SPSC_ENABLED) || (state & SPSC_SLOT_MASK) == SPSC_FULL) {
+        // bound one-to-one while we were waiting for a connection, or there is fast path data left to collect
+        pthread_mutex_unlock(&(cin->mutex));
+        binary_sem_post(&(cin->conns_sem));
+        return channel_receiveOne(cin, data, in_ack_after);
+    }
+    if(channel_bufferTake(cin, data) || channel_multicastTake(cin, data)) {
+        // a sender filled the buffer or multicast while we were waiting for a connection
+        pthread_mutex_unlock(&(cin->mutex));
+        binary_sem_post(&(cin->conns_sem));
+        return 0;
+    }
+
+    // take the sender which has been waiting longest, if any
+    Channel_PNTR match = channel_readyTake(cin);
+    if(match != NULL) {
+        cin->buffer = match->buffer;		// found a ready sender, get pointer
+        memncpy(data, cin->buffer, cin->typesize);	// got pointer from sender; copy data
+
+        match->ready = false;
+
+        my_sem_post(&(match->blocked));
+        pthread_mutex_unlock(&(match->mutex));
+        pthread_mutex_unlock(&(cin->mutex));
+
+        // unlock conns semaphore
+        binary_sem_post(&(cin->conns_sem)); // do post to value 1
+
+        return 0;
+    }
 
+    // senders arriving from now on will see we are ready and hand their data over
     cin->ready = true;
 
     pthread_mutex_unlock(&(cin->mutex));
 
-    // iterate through connection list, looking for receiver that is ready
-    unsigned int length = IteratedList_getListLength(cin->connections);
-    Channel_PNTR match; // current receiver
+    // unlock conns semaphore
+    binary_sem_post(&(cin->conns_sem)); // do post to value 1
+    my_sem_wait(&(cin->blocked) );	// wait here until data is ready in active part of a send
+
+    memncpy(data, cin->buffer, cin->typesize);	// receiver now has pointer; copy data
+    if(cin->multicast != NULL) {
+        struct channel_multicast *payload = cin->multicast;
+        cin->multicast = NULL;
+        pthread_mutex_lock(&(cin->mutex));
+        channel_multicastDone(cin, payload, true);
+        pthread_mutex_unlock(&(cin->mutex));
+        GC_decRef(payload);
+    } else {
+        my_sem_post(&(cin->sender->actually_received) );
+    }
+
+    return 0;
+}
+
+static int channel_multicastSend(Channel_PNTR cout, void *data) {
+    if(cout->transport != NULL) {
+        return cout->transport->send(cout->transport, data) == 0 ? 1 : 0;
+    }
+    Channel_PNTR peer = channel_spscPeer(cout);
+    if(peer != NULL) {
+        uint64_t published = channel_now();
+        if(channel_spscSend(cout, data, false)) {
+            pthread_mutex_lock(&(peer->mutex));
+            channel_multicastDelivered(peer, published);
+            pthread_mutex_unlock(&(peer->mutex));
+            cout->nd_received = true;
+            return 1;
+        }
+    }
+    struct channel_multicast *payload = GC_alloc(sizeof(struct channel_multicast) + cout->typesize, true);
+    if(payload == NULL) {
+        log_logMessage(ERROR, "Channels", "Multicast payload not created - OOM?");
+        return 0;
+    }
+    payload->decRef = channel_multicastDecRef;
+    payload->origin = cout;
+    atomic_init(&(payload->remaining), 1);
+    my_sem_init(&(payload->done), 0);
+    memncpy(payload->data, data, cout->typesize);
+
+    binary_sem_wait(&(cout->conns_sem));
+    payload->published = channel_now();
+
+    int delivered = 0;
+    Channel_PNTR lone = NULL;	// a fast path receiver moved to the slow path for this payload
+    unsigned int length = conn_set_size(&(cout->connections));
+    Channel_PNTR match;
     unsigned int i;
     for(i = 0; i < length; i++) {
-        match = IteratedList_getNextElement(cin->connections);	// fetch next channel in conns list (which keeps state across calls)
+        match = conn_set_next(&(cout->connections));
 
-        pthread_mutex_lock(&(cin->mutex));
         pthread_mutex_lock(&(match->mutex));
+        if(atomic_load(&(cout->spsc_peer)) == match) {
+            // bound one-to-one since the fast path was tried; a fast path receiver wouldn't notice the payload
+            channel_spscDisable(match);
+            atomic_store(&(cout->spsc_peer), NULL);
+            lone = match;
+            GC_incRef(lone);
+        }
+        atomic_fetch_add(&(payload->remaining), 1);
+        if(cout->references) {
+            GC_incRef(*(void**)payload->data);	// each receiver gets a reference of its own
+        }
+        if(match->ready) {
+            GC_incRef(payload);
+            match->multicast = payload;
+            match->buffer = payload->data;
+            match->ready = false;
+            my_sem_post(&(match->blocked));
+        } else {
+            IteratedList_insertElementAtTail(match->multicasts, payload);
+            atomic_fetch_add(&(match->multicast_pending), 1);
+            channel_selectorSignal(match);
+        }
+        pthread_mutex_unlock(&(match->mutex));
+        delivered++;
+    }
+    cout->nd_received = delivered > 0;
 
-        if(match->ready && cin->ready) {
-            cin->buffer = match->buffer;		// found a ready sender, get pointer
-            memncpy(data, cin->buffer, cin->typesize);	// got pointer from sender; copy data
+    // unlock conns semaphore before waiting, so receivers can still be unbound
+    binary_sem_post(&(cout->conns_sem)); // do post to value 1
+    if(atomic_fetch_sub(&(payload->remaining), 1) != 1) {
+        my_sem_wait(&(payload->done));
+    }
+    if(lone != NULL) {
+        // the payload has been taken; go back to the fast path if the binding is still one-to-one (the set only changes
+        // with both mutexes held, and the conns semaphore is left down once cout has no connections)
+        pthread_mutex_lock(&(lone->mutex));
+        pthread_mutex_lock(&(cout->mutex));
+        if(conn_set_size(&(cout->connections)) == 1 && conn_set_size(&(lone->connections)) == 1 &&
+           conn_set_contains(&(cout->connections), lone) && atomic_load(&(lone->multicast_pending)) == 0) {
+            channel_spscTryEnable(lone, cout);
+        }
+        pthread_mutex_unlock(&(cout->mutex));
+        pthread_mutex_unlock(&(lone->mutex));
+        GC_decRef(lone);
+    }
+    if(cout->references) {
+        GC_decRef(*(void**)payload->data);	// the sender's reference, given up
+    }
+    GC_decRef(payload);
 
-            match->ready = false;
-            cin->ready = false;
+    return delivered;
+}
 
-            my_sem_post(&(match->blocked));
-            pthread_mutex_unlock(&(match->mutex));
-            pthread_mutex_unlock(&(cin->mutex));
+/*
+ * Non-blocking and timed operations.
+ *
+ * channel_try_receive takes data only if it is already waiting, as select's polls do, and channel_receive_until is a
+ * select on the one channel which gives up at a deadline. channel_try_send only hands its data to a receiver which is
+ * already waiting in a receive, a select or a timed receive, or leaves it in buffer space; it never parks in the ready
+ * queue, so can't be left waiting for a receiver. Neither works on a channel with a transport.
+ */
+static bool channel_checkLocal(Channel_PNTR this, chan_dir direction) {
+    if(this->direction != direction) {
+        log_logMessage(ERROR, "Channels", "Channel used in the wrong direction");
+        return false;
+    }
+    if(this->transport != NULL) {
+        log_logMessage(ERROR, "Channels", "Can't try or time out an operation on a channel with a transport");
+        return false;
+    }
+    return true;
+}
 
-            // unlock conns semaphore
-            binary_sem_post(&(cin->conns_sem)); // do post to value 1
+static bool channel_trySendOne(Channel_PNTR cout, void *data) {
+    if(!channel_checkLocal(cout, CHAN_OUT)) {
+        return false;
+    }
+    if(channel_spscSend(cout, data, true)) {
+        return true;
+    }
 
-            return 0;
+    // unbound, or another operation is using the connections
+    if(!my_sem_trywait(&(cout->conns_sem))) {
+        return false;
+    }
+    pthread_mutex_lock(&(cout->mutex));
+    Channel_PNTR peer = channel_spscPeer(cout);
+    if(peer != NULL) {
+        // the receiver isn't waiting in the slot, so a select asleep on it is the only other taker
+        pthread_mutex_unlock(&(cout->mutex));
+        pthread_mutex_lock(&(peer->mutex));
+        pthread_mutex_lock(&(cout->mutex));
+        bool sent = channel_selectorDeliver(peer, data);
+        cout->nd_received |= sent;
+        pthread_mutex_unlock(&(cout->mutex));
+        pthread_mutex_unlock(&(peer->mutex));
+        binary_sem_post(&(cout->conns_sem));
+        return sent;
+    }
+    cout->buffer = data;
+    pthread_mutex_unlock(&(cout->mutex));
+
+    // cout->ready stays false throughout, so a stale link in a ready queue can't pick our data up
+    unsigned int length = conn_set_size(&(cout->connections));
+    Channel_PNTR match;
+    unsigned int i;
+    for(i = 0; i < length; i++) {
+        match = conn_set_next(&(cout->connections));
+
+        pthread_mutex_lock(&(match->mutex));
+        pthread_mutex_lock(&(cout->mutex));
+
+        if(match->ready) {
+            match->buffer = cout->buffer;
+            match->sender = cout;
+            match->ready = false;
+            cout->nd_received = true;
+            my_sem_post(&(match->blocked));
+            pthread_mutex_unlock(&(cout->mutex));
+            pthread_mutex_unlock(&(match->mutex));
+            my_sem_wait(&(cout->actually_received));	// the receiver is running, so this is brief
+            binary_sem_post(&(cout->conns_sem));
+            return true;
+        }
+        if(match->capacity > 0 && channel_bufferHasSpace(match)) {
+            channel_bufferPut(match, cout->buffer);
+            match->stats.buffered_sends++;
+            channel_selectorSignal(match);
+            cout->nd_received = true;
+            pthread_mutex_unlock(&(cout->mutex));
+            pthread_mutex_unlock(&(match->mutex));
+            binary_sem_post(&(cout->conns_sem));
+            return true;
+        }
+        if(channel_selectorDeliver(match, cout->buffer)) {
+            cout->nd_received = true;
+            pthread_mutex_unlock(&(cout->mutex));
+            pthread_mutex_unlock(&(match->mutex));
+            binary_sem_post(&(cout->conns_sem));
+            return true;
         }
 
+        pthread_mutex_unlock(&(cout->mutex));
         pthread_mutex_unlock(&(match->mutex));
-        pthread_mutex_unlock(&(cin->mutex));
     }
 
-    // unlock conns semaphore
-    binary_sem_post(&(cin->conns_sem)); // do post to value 1
-    my_sem_wait(&(cin->blocked) );	// wait here until data is ready in active part of a send
+    binary_sem_post(&(cout->conns_sem));
+    return false;
+}
 
-    memncpy(data, cin->buffer, cin->typesize);	// receiver now has pointer; copy data
-    my_sem_post(&(cin->actually_received) );
+static bool channel_tryReceiveOne(Channel_PNTR cin, void *data) {
+    return channel_checkLocal(cin, CHAN_IN) && channel_tryPull(cin, data);
+}
 
-    return 0;
+void channel_deadlineAfter(struct timespec *deadline, unsigned int ms) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += ms / 1000;
+    deadline->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if(deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+static bool channel_receiveUntil(Channel_PNTR cin, void *data, const struct timespec *deadline) {
+    if(!channel_checkLocal(cin, CHAN_IN)) {
+        return false;
+    }
+    struct select_struct s = { .nchans = 1, .chans = &cin, .buffer = data, .have_default = false, .next = 0 };
+    return channel_selectUntil(&s, deadline) == 0;
+}
+
+/*
+ * Instrumentation.
+ *
+ * A channel given a label with channel_setLabel records each operation on it in the channel statistics: how many
+ * items it moved, their size, and how long it took from being called to returning, which for a synchronous channel is
+ * mostly time spent blocked waiting for the other side. Items are measured by the function given with the label,
+ * or as typesize bytes each; a sender measures its data before handing it over. Unlabelled channels skip all of it.
+ */
+void channel_setLabel(Channel_PNTR this, const char *component, const char *name, size_t (*measure)(void *item)) {
+    this->measure = measure;
+    this->stats_id = channel_stats_register(component, name);
+}
+
+static uint64_t channel_measure(Channel_PNTR this, void *data, unsigned int n) {
+    if(this->stats_id == 0) {
+        return 0;
+    }
+    if(this->measure == NULL) {
+        return (uint64_t)n * this->typesize;
+    }
+    uint64_t bytes = 0;
+    unsigned int i;
+    for(i = 0; i < n; i++) {
+        bytes += this->measure((char*)data + i * this->typesize);
+    }
+    return bytes;
+}
+
+static uint64_t channel_start(Channel_PNTR this) {
+    return this->stats_id == 0 ? 0 : channel_now();
+}
+
+static void channel_record(Channel_PNTR this, enum channel_stats_side side, unsigned int n, uint64_t bytes, uint64_t start) {
+    if(this->stats_id != 0) {
+        channel_stats_record(this->stats_id, side, n, bytes, channel_now() - start);
+    }
+}
+
+int channel_send(Channel_PNTR cout, void *data, void *ex_handler) {
+    uint64_t bytes = channel_measure(cout, data, 1);
+    uint64_t start = channel_start(cout);
+    int result = channel_sendOne(cout, data, ex_handler);
+    channel_record(cout, CHANNEL_STATS_SEND, 1, bytes, start);
+    return result;
+}
+
+int channel_receive(Channel_PNTR cin, void *data, bool in_ack_after) {
+    uint64_t start = channel_start(cin);
+    int result = channel_receiveOne(cin, data, in_ack_after);
+    channel_record(cin, CHANNEL_STATS_RECEIVE, 1, channel_measure(cin, data, 1), start);
+    return result;
+}
+
+int channel_send_n(Channel_PNTR cout, void *data, unsigned int n, void *ex_handler) {
+    uint64_t bytes = channel_measure(cout, data, n);
+    uint64_t start = channel_start(cout);
+    int result = channel_sendN(cout, data, n, ex_handler);
+    channel_record(cout, CHANNEL_STATS_SEND, n, bytes, start);
+    return result;
+}
+
+unsigned int channel_receive_n(Channel_PNTR cin, void *data, unsigned int n) {
+    uint64_t start = channel_start(cin);
+    unsigned int received = channel_receiveN(cin, data, n);
+    channel_record(cin, CHANNEL_STATS_RECEIVE, received, channel_measure(cin, data, received), start);
+    return received;
+}
+
+int channel_multicast_send(Channel_PNTR cout, void *data) {
+    uint64_t bytes = channel_measure(cout, data, 1);
+    uint64_t start = channel_start(cout);
+    int delivered = channel_multicastSend(cout, data);
+    channel_record(cout, CHANNEL_STATS_SEND, 1, bytes, start);
+    return delivered;
+}
+
+bool channel_try_send(Channel_PNTR cout, void *data) {
+    uint64_t bytes = channel_measure(cout, data, 1);
+    uint64_t start = channel_start(cout);
+    bool sent = channel_trySendOne(cout, data);
+    if(sent) {
+        channel_record(cout, CHANNEL_STATS_SEND, 1, bytes, start);
+    }
+    return sent;
+}
+
+bool channel_try_receive(Channel_PNTR cin, void *data) {
+    uint64_t start = channel_start(cin);
+    bool received = channel_tryReceiveOne(cin, data);
+    if(received) {
+        channel_record(cin, CHANNEL_STATS_RECEIVE, 1, channel_measure(cin, data, 1), start);
+    }
+    return received;
+}
+
+bool channel_receive_until(Channel_PNTR cin, void *data, const struct timespec *deadline) {
+    uint64_t start = channel_start(cin);
+    bool received = channel_receiveUntil(cin, data, deadline);
+    if(received) {
+        channel_record(cin, CHANNEL_STATS_RECEIVE, 1, channel_measure(cin, data, 1), start);
+    }
+    return received;
+}
+
+int channel_select(struct select_struct *s) {
+    uint64_t start = channel_now();
+    int chosen = channel_selectOne(s);
+    if(chosen >= 0) {
+        // the wait is put down to whichever channel ended it
+        Channel_PNTR cin = s->chans[chosen];
+        channel_record(cin, CHANNEL_STATS_RECEIVE, 1, channel_measure(cin, s->buffer, 1), start);
+    }
+    return chosen;
 }
@@ -3,7 +3,11 @@
  * Start of channel implementation for UNIX
  *
  * Send, receive, bind, unbind are implemented according to SPIN paper algorithms
- * Select operation is missing
+ * Select polls the chosen channels and sleeps until a sender offers data on one of them
+ * Try send/receive only complete if the other side is already waiting; a timed receive gives up at a deadline
+ * Batched send/receive move several items per lock acquisition on buffered channels
+ * A transport connects a channel to one in another process, in place of local bindings
+ * A labelled channel records its traffic in the channel statistics
  *
  * Absolutely no guarantees with this code, never been tested by me
  *
@@ -20,16 +24,51 @@
 #include "../Collections/IteratedList.h"
 #include "../GC/GC_mem.h"
 #include "my_semaphore.h"
+#include "conn_set.h"
 #include <semaphore.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 
 // channel struct stuff
 typedef enum { CHAN_IN, CHAN_OUT } chan_dir;
 
-extern pthread_mutex_t conn_op_mutex;	// to prevent connect during disconnect and vice versa
+// occupancy statistics for a buffered channel
+struct channel_buffer_stats
+{
+    unsigned int capacity;              // number of items the buffer can hold
+    unsigned int occupancy;             // number of items currently buffered
+    unsigned int high_water;            // most items ever buffered at once
+    unsigned long buffered_sends;       // sends which left their data in the buffer and returned without waiting
+    unsigned long full_sends;           // times a sender found the buffer full and had to wait
+};
+
+// delivery statistics for one subscriber of multicast sends
+struct channel_multicast_stats
+{
+    unsigned long delivered;            // multicast payloads received
+    unsigned long dropped;              // payloads discarded because the sender was unbound before they were received
+    uint64_t total_latency;             // sum of times from publication to receipt, in ns
+    uint64_t max_latency;               // longest time from publication to receipt, in ns
+};
+
+struct channel_selector;	// a select waiting on the channel, see channel_select
+struct channel_multicast;	// a payload published by channel_multicast_send
+struct channel_link;		// a binding between two channels, see channel_bind
+
+// carries a channel's data to and from another process, see channel_setTransport
+struct channel_transport
+{
+    int (*send)(struct channel_transport *transport, void *buffer);       // as channel_send
+    int (*send_n)(struct channel_transport *transport, void *buffer, unsigned int n);    // as channel_send_n, or NULL
+    int (*receive)(struct channel_transport *transport, void *buffer);    // as channel_receive
+    void (*close)(struct channel_transport *transport);                   // the channel is being freed
+    bool buffered;      // sends return before the data is received, so are worth batching (see channel_isBuffered)
+};
 
 typedef struct Channel chan_s, *Channel_PNTR;
 typedef Channel_PNTR chan_id;
@@ -37,14 +76,45 @@ struct Channel {
 	void (*decRef)(Channel_PNTR pntr); // GC decRef
 	chan_dir direction;	// for error checking in bind, etc.
 	size_t typesize;	// how large the buffer is
+	bool references;	// the data is a GC reference, moved from sender to receiver (see channel_createReference)
 	void* buffer;		// pointer to data to send/receive
 	bool ready;		// ready flag
 	bool nd_received;	// used by select
-	IteratedList_PNTR connections; 	// list of type Channel_PNTR, channels we're connected to
+	conn_set_t connections; 	// Channel_PNTR -> channel_link, channels we're connected to; changed with conns_sem and mutex held
 	pthread_mutex_t mutex;	// for locking the channel
+	pthread_mutex_t topology;	// serialises bind/unbind involving this channel
 	my_sem_t conns_sem;	        // connections available mutex
 	my_sem_t blocked;	    	// block component if waiting for other channel
-	my_sem_t actually_received;	// make sure data can't be changed until after a receive has completed
+	my_sem_t actually_received;	// OUT: make sure data can't be changed until after a receive has completed
+	Channel_PNTR sender;		// IN: sender which handed over the data in buffer, waiting on its actually_received
+	struct channel_link* ready_head;	// IN: queue of bindings whose sender is waiting for us, oldest first (changed with mutex held)
+	struct channel_link* ready_tail;	// IN: newest binding in the ready queue
+
+	// one-to-one fast path, used instead of the above while a binding has exactly one sender and one receiver
+	atomic_uint spsc_state;		// IN: handoff slot state, flags and binding epoch (see SPSC_* in channel.c)
+	Channel_PNTR spsc_sender;	// IN: the only channel allowed to publish into the slot during this epoch
+	_Atomic(Channel_PNTR) spsc_peer;	// OUT: receiver whose slot we may publish into
+	atomic_uint spsc_epoch;		// OUT: epoch of the binding which set spsc_peer
+
+	// optional bounded buffer, letting senders return before their data has been received
+	unsigned int capacity;		// IN: number of items the buffer can hold, 0 if unbuffered
+	void* ring;			// IN: capacity * typesize bytes of buffered data
+	unsigned int head;		// IN: index of the oldest buffered item
+	unsigned int count;		// IN: number of items currently buffered
+	unsigned int prefetched;	// IN: items in the last batch channel_receive_n took, still held against capacity
+	struct channel_buffer_stats stats;	// IN: occupancy statistics (capacity and occupancy are filled in on request)
+
+	_Atomic(struct channel_selector*) selector;	// IN: select to wake when data is offered, changed with mutex held
+
+	IteratedList_PNTR multicasts;	// IN: multicast payloads waiting to be received, oldest first
+	atomic_uint multicast_pending;	// IN: length of multicasts, readable without the mutex
+	struct channel_multicast* multicast;	// IN: multicast payload in buffer, acknowledged instead of sender
+	struct channel_multicast_stats multicast_stats;	// IN: multicast deliveries to this channel
+
+	struct channel_transport* transport;	// exchanges our data with another process instead of our connections, or NULL
+
+	unsigned int stats_id;		// where our traffic is recorded in the channel statistics, 0 if unlabelled
+	size_t (*measure)(void* item);	// size of an item for the statistics, or NULL to count typesize
 };
 
 
@@ -58,6 +128,7 @@ struct select_struct
     Channel_PNTR *chans;             // array of channels for which guard conditions are satisfied
     void *buffer;               // ptr to the receiving buffer of appropriate size
     bool have_default;  // do we have default clause
+    unsigned int next;          // where the next select starts looking, rotated so every ready channel gets a turn
 };
 
 // typedef enum {
@@ -95,13 +166,27 @@ struct select_struct
 
 // channel functions
 extern Channel_PNTR channel_create(chan_dir direction, int typesize);
+extern Channel_PNTR channel_createReference(chan_dir direction);	// carries GC references; senders give theirs up
 extern bool channel_bind(Channel_PNTR id1, Channel_PNTR id2);
 extern void channel_unbind(Channel_PNTR id);
-extern int channel_select(struct select_struct *s);
+extern int channel_select(struct select_struct *s);	// index of the channel received from, -1 for default
 extern int channel_send(Channel_PNTR id, void *buffer, void *ex_handler); // ex_handler is an exception handler used in InceOS
 extern int channel_receive(Channel_PNTR id, void *buffer, bool in_ack_after);
-extern int channel_multicast_send(Channel_PNTR id, void *buffer);
+extern int channel_send_n(Channel_PNTR id, void *buffer, unsigned int n, void *ex_handler);	// buffer holds n items
+extern unsigned int channel_receive_n(Channel_PNTR id, void *buffer, unsigned int n);	// waits for 1, returns the number received
+extern bool channel_try_send(Channel_PNTR id, void *buffer);	// false, without sending, if nobody is ready to take it
+extern bool channel_try_receive(Channel_PNTR id, void *buffer);	// false, without receiving, if nothing is waiting
+extern bool channel_receive_until(Channel_PNTR id, void *buffer, const struct timespec *deadline);	// CLOCK_MONOTONIC; false if it passed
+extern void channel_deadlineAfter(struct timespec *deadline, unsigned int ms);	// for channel_receive_until
+extern int channel_multicast_send(Channel_PNTR id, void *buffer);	// returns the number of receivers delivered to
+extern void channel_getMulticastStats(Channel_PNTR id, struct channel_multicast_stats *stats);
 extern void remoteAnonymousUnbind_proc(Channel_PNTR id, void* var);
+extern void channel_setSPSCEnabled(bool enabled);	// allow/disallow the one-to-one fast path for future binds
+extern bool channel_setCapacity(Channel_PNTR id, unsigned int capacity);	// buffer an IN channel, before it is bound
+extern void channel_getBufferStats(Channel_PNTR id, struct channel_buffer_stats *stats);
+extern bool channel_isBuffered(Channel_PNTR id);	// IN: has a buffer; OUT: bound, and only to buffered channels
+extern bool channel_setTransport(Channel_PNTR id, struct channel_transport *transport);	// before it is bound; takes the reference
+extern void channel_setLabel(Channel_PNTR id, const char *component, const char *name, size_t (*measure)(void *item));	// before it is used
 
 
 #endif /* CHANNEL_H_ */
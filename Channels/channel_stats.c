@@ -0,0 +1,279 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "channel_stats.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+
+#define CHANNEL_STATS_CHUNK 16		// ids whose counters a shard allocates together, the first time one is used
+#define CHANNEL_STATS_CHUNKS (CHANNEL_STATS_MAX / CHANNEL_STATS_CHUNK)
+
+// One side of a channel's traffic, as recorded by one thread. Only that thread writes it, so it can add with plain
+// loads and stores; they are atomic so that merging can read while it writes.
+struct channel_stats_counters {
+	_Atomic uint64_t messages;
+	_Atomic uint64_t bytes;
+	_Atomic uint64_t wait;
+	_Atomic uint64_t max_wait;
+	_Atomic uint32_t histogram[CHANNEL_STATS_BUCKETS];
+};
+
+struct channel_stats_slot {
+	struct channel_stats_counters sides[2];
+};
+
+struct channel_stats_shard {
+	struct channel_stats_shard *next;	// in channel_stats_shards, changed with channel_stats_lock held
+	struct channel_stats_shard *prev;
+	_Atomic(struct channel_stats_slot*) chunks[CHANNEL_STATS_CHUNKS];	// allocated by the owning thread, never moved
+};
+
+static pthread_mutex_t channel_stats_lock = PTHREAD_MUTEX_INITIALIZER;	// guards the labels and the list of shards
+static char *channel_stats_labels[CHANNEL_STATS_MAX][2];	// component and channel name for each id - 1
+static unsigned int channel_stats_count;
+static struct channel_stats_shard *channel_stats_shards;	// shards of running threads
+static struct channel_stats_shard channel_stats_retired;	// totals of threads which have exited, changed with the lock held
+static atomic_bool channel_stats_enabled;
+
+static pthread_once_t channel_stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t channel_stats_key;		// so a thread's shard is retired when it exits
+static _Thread_local struct channel_stats_shard *channel_stats_mine;
+
+void channel_stats_setEnabled(bool enabled){
+	atomic_store(&channel_stats_enabled, enabled);
+}
+
+bool channel_stats_isEnabled(void){
+	return atomic_load(&channel_stats_enabled);
+}
+
+static char *channel_stats_copy(const char *string){
+	char *copy = GC_alloc(strlen(string) + 1, false);
+	strcpy(copy, string);
+	return copy;
+}
+
+unsigned int channel_stats_register(const char *component, const char *channel){
+	pthread_mutex_lock(&channel_stats_lock);
+	unsigned int id;
+	for(id = 0; id < channel_stats_count; id++){
+		if(strcmp(channel_stats_labels[id][0], component) == 0 && strcmp(channel_stats_labels[id][1], channel) == 0)
+			break;
+	}
+	if(id == channel_stats_count){
+		if(id == CHANNEL_STATS_MAX){
+			pthread_mutex_unlock(&channel_stats_lock);
+			log_logMessage(WARNING, "Channels", "Too many channels to record statistics for %s.%s", component, channel);
+			return 0;
+		}
+		channel_stats_labels[id][0] = channel_stats_copy(component);
+		channel_stats_labels[id][1] = channel_stats_copy(channel);
+		channel_stats_count++;
+	}
+	pthread_mutex_unlock(&channel_stats_lock);
+	return id + 1;
+}
+
+unsigned int channel_stats_bucket(uint64_t ns){
+	const uint64_t sub = 1u << CHANNEL_STATS_SUB_BITS;
+	if(ns < sub)
+		return (unsigned int)ns;
+	unsigned int top = 63 - (unsigned int)__builtin_clzll(ns);	// index of the highest bit set
+	if(top >= CHANNEL_STATS_MAX_BITS)
+		return CHANNEL_STATS_BUCKETS - 1;
+	return ((top - CHANNEL_STATS_SUB_BITS + 1) << CHANNEL_STATS_SUB_BITS) |
+	       (unsigned int)((ns >> (top - CHANNEL_STATS_SUB_BITS)) & (sub - 1));
+}
+
+uint64_t channel_stats_bucketLimit(unsigned int bucket){
+	const uint64_t sub = 1u << CHANNEL_STATS_SUB_BITS;
+	bucket++;
+	if(bucket < sub)
+		return bucket;
+	if(bucket >= CHANNEL_STATS_BUCKETS)
+		return UINT64_MAX;
+	unsigned int top = (bucket >> CHANNEL_STATS_SUB_BITS) + CHANNEL_STATS_SUB_BITS - 1;
+	return (sub | (bucket & (sub - 1))) << (top - CHANNEL_STATS_SUB_BITS);
+}
+
+// Add to a counter only the calling thread writes.
+static void channel_stats_add(_Atomic uint64_t *counter, uint64_t value){
+	atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+// Add one thread's counters into another set, which only the caller may be writing.
+static void channel_stats_merge(struct channel_stats_counters *into, struct channel_stats_counters *from){
+	channel_stats_add(&(into->messages), atomic_load_explicit(&(from->messages), memory_order_relaxed));
+	channel_stats_add(&(into->bytes), atomic_load_explicit(&(from->bytes), memory_order_relaxed));
+	channel_stats_add(&(into->wait), atomic_load_explicit(&(from->wait), memory_order_relaxed));
+	uint64_t max = atomic_load_explicit(&(from->max_wait), memory_order_relaxed);
+	if(max > atomic_load_explicit(&(into->max_wait), memory_order_relaxed))
+		atomic_store_explicit(&(into->max_wait), max, memory_order_relaxed);
+	for(unsigned int i = 0; i < CHANNEL_STATS_BUCKETS; i++){
+		uint32_t count = atomic_load_explicit(&(from->histogram[i]), memory_order_relaxed);
+		if(count > 0)
+			atomic_store_explicit(&(into->histogram[i]),
+			                      atomic_load_explicit(&(into->histogram[i]), memory_order_relaxed) + count,
+			                      memory_order_relaxed);
+	}
+}
+
+static struct channel_stats_slot *channel_stats_slot(struct channel_stats_shard *shard, unsigned int index){
+	struct channel_stats_slot *chunk = atomic_load_explicit(&(shard->chunks[index / CHANNEL_STATS_CHUNK]), memory_order_acquire);
+	return chunk == NULL ? NULL : &(chunk[index % CHANNEL_STATS_CHUNK]);
+}
+
+// Fold an exiting thread's shard into the retired totals.
+static void channel_stats_retire(void *data){
+	struct channel_stats_shard *shard = data;
+	pthread_mutex_lock(&channel_stats_lock);
+	for(unsigned int c = 0; c < CHANNEL_STATS_CHUNKS; c++){
+		struct channel_stats_slot *chunk = atomic_load(&(shard->chunks[c]));
+		if(chunk == NULL)
+			continue;
+		if(atomic_load(&(channel_stats_retired.chunks[c])) == NULL)
+			atomic_store(&(channel_stats_retired.chunks[c]), GC_alloc(CHANNEL_STATS_CHUNK * sizeof(struct channel_stats_slot), false));
+		struct channel_stats_slot *into = atomic_load(&(channel_stats_retired.chunks[c]));
+		for(unsigned int i = 0; i < CHANNEL_STATS_CHUNK; i++){
+			channel_stats_merge(&(into[i].sides[CHANNEL_STATS_SEND]), &(chunk[i].sides[CHANNEL_STATS_SEND]));
+			channel_stats_merge(&(into[i].sides[CHANNEL_STATS_RECEIVE]), &(chunk[i].sides[CHANNEL_STATS_RECEIVE]));
+		}
+		GC_decRef(chunk);
+	}
+	if(shard->prev != NULL)
+		shard->prev->next = shard->next;
+	else
+		channel_stats_shards = shard->next;
+	if(shard->next != NULL)
+		shard->next->prev = shard->prev;
+	pthread_mutex_unlock(&channel_stats_lock);
+	GC_decRef(shard);
+}
+
+static void channel_stats_createKey(void){
+	pthread_key_create(&channel_stats_key, channel_stats_retire);
+}
+
+static struct channel_stats_shard *channel_stats_shard(void){
+	if(channel_stats_mine == NULL){
+		pthread_once(&channel_stats_once, channel_stats_createKey);
+		struct channel_stats_shard *shard = GC_alloc(sizeof(struct channel_stats_shard), false);
+		pthread_mutex_lock(&channel_stats_lock);
+		shard->next = channel_stats_shards;
+		if(shard->next != NULL)
+			shard->next->prev = shard;
+		channel_stats_shards = shard;
+		pthread_mutex_unlock(&channel_stats_lock);
+		pthread_setspecific(channel_stats_key, shard);
+		channel_stats_mine = shard;
+	}
+	return channel_stats_mine;
+}
+
+void channel_stats_record(unsigned int id, enum channel_stats_side side, unsigned int n, uint64_t bytes, uint64_t wait){
+	if(id == 0 || id > CHANNEL_STATS_MAX)
+		return;
+	struct channel_stats_shard *shard = channel_stats_shard();
+	struct channel_stats_slot *slot = channel_stats_slot(shard, id - 1);
+	if(slot == NULL){
+		struct channel_stats_slot *chunk = GC_alloc(CHANNEL_STATS_CHUNK * sizeof(struct channel_stats_slot), false);
+		atomic_store_explicit(&(shard->chunks[(id - 1) / CHANNEL_STATS_CHUNK]), chunk, memory_order_release);
+		slot = &(chunk[(id - 1) % CHANNEL_STATS_CHUNK]);
+	}
+
+	struct channel_stats_counters *counters = &(slot->sides[side]);
+	channel_stats_add(&(counters->messages), n);
+	channel_stats_add(&(counters->bytes), bytes);
+	channel_stats_add(&(counters->wait), wait);
+	if(wait > atomic_load_explicit(&(counters->max_wait), memory_order_relaxed))
+		atomic_store_explicit(&(counters->max_wait), wait, memory_order_relaxed);
+	_Atomic uint32_t *bucket = &(counters->histogram[channel_stats_bucket(wait)]);
+	atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+static void channel_stats_total(struct channel_stats_totals *into, struct channel_stats_counters *from){
+	into->messages += atomic_load_explicit(&(from->messages), memory_order_relaxed);
+	into->bytes += atomic_load_explicit(&(from->bytes), memory_order_relaxed);
+	into->wait += atomic_load_explicit(&(from->wait), memory_order_relaxed);
+	uint64_t max = atomic_load_explicit(&(from->max_wait), memory_order_relaxed);
+	if(max > into->max_wait)
+		into->max_wait = max;
+	for(unsigned int i = 0; i < CHANNEL_STATS_BUCKETS; i++)
+		into->histogram[i] += atomic_load_explicit(&(from->histogram[i]), memory_order_relaxed);
+}
+
+// As channel_stats_get, with channel_stats_lock held.
+static bool channel_stats_collect(unsigned int id, struct channel_stats *stats){
+	memset(stats, 0, sizeof(struct channel_stats));
+	if(id == 0 || id > channel_stats_count)
+		return false;
+	stats->component = channel_stats_labels[id - 1][0];
+	stats->channel = channel_stats_labels[id - 1][1];
+
+	struct channel_stats_shard *shard = &channel_stats_retired;
+	struct channel_stats_shard *next = channel_stats_shards;
+	while(shard != NULL){
+		struct channel_stats_slot *slot = channel_stats_slot(shard, id - 1);
+		if(slot != NULL){
+			channel_stats_total(&(stats->sides[CHANNEL_STATS_SEND]), &(slot->sides[CHANNEL_STATS_SEND]));
+			channel_stats_total(&(stats->sides[CHANNEL_STATS_RECEIVE]), &(slot->sides[CHANNEL_STATS_RECEIVE]));
+		}
+		shard = next;
+		if(next != NULL)
+			next = next->next;
+	}
+	return true;
+}
+
+bool channel_stats_get(unsigned int id, struct channel_stats *stats){
+	pthread_mutex_lock(&channel_stats_lock);
+	bool found = channel_stats_collect(id, stats);
+	pthread_mutex_unlock(&channel_stats_lock);
+	return found;
+}
+
+uint64_t channel_stats_percentile(const struct channel_stats_totals *totals, double fraction){
+	uint64_t count = 0;
+	for(unsigned int i = 0; i < CHANNEL_STATS_BUCKETS; i++)
+		count += totals->histogram[i];
+	if(count == 0)
+		return 0;
+
+	uint64_t wanted = (uint64_t)(fraction * (double)count + 0.5);
+	uint64_t seen = 0;
+	for(unsigned int i = 0; i < CHANNEL_STATS_BUCKETS; i++){
+		seen += totals->histogram[i];
+		if(seen >= wanted && seen > 0){
+			uint64_t limit = channel_stats_bucketLimit(i);
+			return limit < totals->max_wait ? limit : totals->max_wait;
+		}
+	}
+	return totals->max_wait;
+}
+
+void channel_stats_dump(FILE *out){
+	static const char *sides[] = { "send", "receive" };
+	struct channel_stats stats;
+
+	pthread_mutex_lock(&channel_stats_lock);
+	fprintf(out, "Channel statistics (times in microseconds):\n");
+	fprintf(out, "%-32s %-7s %12s %14s %12s %9s %9s %9s %9s %9s\n",
+	        "channel", "side", "messages", "bytes", "blocked", "mean", "p50", "p90", "p99", "max");
+	for(unsigned int id = 1; id <= channel_stats_count; id++){
+		channel_stats_collect(id, &stats);
+		for(int side = CHANNEL_STATS_SEND; side <= CHANNEL_STATS_RECEIVE; side++){
+			struct channel_stats_totals *totals = &(stats.sides[side]);
+			if(totals->messages == 0)
+				continue;
+			char label[64];
+			snprintf(label, sizeof(label), "%s.%s", stats.component, stats.channel);
+			fprintf(out, "%-32s %-7s %12llu %14llu %12.1f %9.2f %9.2f %9.2f %9.2f %9.2f\n", label, sides[side],
+			        (unsigned long long)totals->messages, (unsigned long long)totals->bytes, totals->wait / 1e3,
+			        totals->wait / 1e3 / (double)totals->messages,
+			        channel_stats_percentile(totals, 0.5) / 1e3, channel_stats_percentile(totals, 0.9) / 1e3,
+			        channel_stats_percentile(totals, 0.99) / 1e3, totals->max_wait / 1e3);
+		}
+	}
+	pthread_mutex_unlock(&channel_stats_lock);
+	fflush(out);
+}
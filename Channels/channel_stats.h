@@ -0,0 +1,65 @@
+/*
+ * channel_stats.h
+ *
+ * Per-channel counters and wait time histograms. Channels are registered under a label (owning component and channel
+ * name); each thread records into a shard of its own, so recording takes no locks and shares no cache lines, and the
+ * shards are merged when the statistics are asked for. A thread's shard is folded into a common one when it exits.
+ *
+ * Histograms are log-linear: 8 buckets for each power of 2 nanoseconds, so a bucket is at most an eighth wider than
+ * the times in it, from 0 up to about 68s (longer times go in the last bucket).
+ *
+ */
+
+#ifndef CHANNEL_STATS_H
+#define CHANNEL_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+
+#define CHANNEL_STATS_SUB_BITS 3	// log2 of the buckets for each power of 2
+#define CHANNEL_STATS_MAX_BITS 36	// times of 2^36ns and more share the last bucket
+#define CHANNEL_STATS_BUCKETS ((CHANNEL_STATS_MAX_BITS - CHANNEL_STATS_SUB_BITS + 1) << CHANNEL_STATS_SUB_BITS)
+#define CHANNEL_STATS_MAX 4096		// labels that can be registered; channels beyond these go unrecorded
+
+enum channel_stats_side { CHANNEL_STATS_SEND, CHANNEL_STATS_RECEIVE };
+
+// one direction of traffic through a labelled channel
+struct channel_stats_totals {
+	uint64_t messages;			// items sent, or received
+	uint64_t bytes;				// their size, as measured when the channel was labelled
+	uint64_t wait;				// ns spent in the channel operations moving them, including blocking
+	uint64_t max_wait;			// longest single operation, in ns
+	uint32_t histogram[CHANNEL_STATS_BUCKETS];	// operations by how long they took, see channel_stats_bucket
+};
+
+struct channel_stats {
+	const char *component;
+	const char *channel;
+	struct channel_stats_totals sides[2];	// indexed by enum channel_stats_side
+};
+
+
+// Return the id to record a channel under, registering its label if it is new. Channels with the same label share an
+// id. 0, which records nothing, if there are already CHANNEL_STATS_MAX labels.
+unsigned int channel_stats_register(const char *component, const char *channel);
+// Add an operation moving n items of bytes in total, which took wait ns, to the calling thread's shard.
+void channel_stats_record(unsigned int id, enum channel_stats_side side, unsigned int n, uint64_t bytes, uint64_t wait);
+
+// Merge every thread's figures for id into *stats. False for an id that was never registered.
+bool channel_stats_get(unsigned int id, struct channel_stats *stats);
+// Time (ns) below which the given fraction of operations completed, to within the width of a bucket.
+uint64_t channel_stats_percentile(const struct channel_stats_totals *totals, double fraction);
+// Write a table of every label with traffic.
+void channel_stats_dump(FILE *out);
+
+// Whether channels should be labelled as they are created; off unless turned on at startup.
+void channel_stats_setEnabled(bool enabled);
+bool channel_stats_isEnabled(void);
+
+unsigned int channel_stats_bucket(uint64_t ns);
+uint64_t channel_stats_bucketLimit(unsigned int bucket);	// smallest time in the next bucket
+
+
+#endif /* CHANNEL_STATS_H */
@@ -0,0 +1,135 @@
+#include <stdint.h>
+#include <string.h>
+#include "conn_set.h"
+#include "../GC/GC_mem.h"
+
+#define CONN_SET_MIN_CAPACITY 4
+
+// Slot a member hashes to. Channels are heap allocated, so the low bits of their addresses carry no information.
+static unsigned int conn_set_hash(conn_set_t *set, void *member){
+	uint64_t key = (uint64_t)(uintptr_t)member >> 4;
+	return (unsigned int)((key * 0x9E3779B97F4A7C15ull) >> 32) & (2 * set->capacity - 1);
+}
+
+// Slot holding member, or the free slot where it would go.
+static unsigned int conn_set_find(conn_set_t *set, void *member){
+	unsigned int mask = 2 * set->capacity - 1;
+	unsigned int slot = conn_set_hash(set, member);
+	while(set->slots[slot].member != NULL && set->slots[slot].member != member)
+		slot = (slot + 1) & mask;
+	return slot;
+}
+
+// Double the capacity (capacity is always a power of 2), and rebuild the index.
+static void conn_set_grow(conn_set_t *set){
+	unsigned int capacity = set->capacity == 0 ? CONN_SET_MIN_CAPACITY : 2 * set->capacity;
+	void **items = GC_alloc(capacity * sizeof(void*), false);
+	void **values = GC_alloc(capacity * sizeof(void*), false);
+	if(set->items != NULL){
+		memcpy(items, set->items, set->count * sizeof(void*));
+		memcpy(values, set->values, set->count * sizeof(void*));
+		GC_decRef(set->items);
+		GC_decRef(set->values);
+		GC_decRef(set->slots);
+	}
+	set->items = items;
+	set->values = values;
+	set->capacity = capacity;
+	set->slots = GC_alloc(2 * capacity * sizeof(struct conn_slot), false);
+	for(unsigned int i = 0; i < set->count; i++){
+		unsigned int slot = conn_set_find(set, items[i]);
+		set->slots[slot].member = items[i];
+		set->slots[slot].position = i;
+	}
+}
+
+void conn_set_init(conn_set_t *set){
+	set->items = NULL;
+	set->values = NULL;
+	set->count = 0;
+	set->capacity = 0;
+	set->next = 0;
+	set->slots = NULL;
+}
+
+void conn_set_destroy(conn_set_t *set){
+	if(set->items != NULL){
+		GC_decRef(set->items);
+		GC_decRef(set->values);
+		GC_decRef(set->slots);
+	}
+	conn_set_init(set);
+}
+
+bool conn_set_add(conn_set_t *set, void *member, void *value){
+	if(conn_set_contains(set, member))
+		return false;
+	if(set->count == set->capacity)
+		conn_set_grow(set);
+	unsigned int slot = conn_set_find(set, member);
+	set->slots[slot].member = member;
+	set->slots[slot].position = set->count;
+	set->values[set->count] = value;
+	set->items[set->count++] = member;
+	return true;
+}
+
+bool conn_set_remove(conn_set_t *set, void *member){
+	if(set->count == 0)
+		return false;
+	unsigned int mask = 2 * set->capacity - 1;
+	unsigned int hole = conn_set_find(set, member);
+	if(set->slots[hole].member == NULL)
+		return false;
+
+	// move the last member into the vacated position
+	unsigned int position = set->slots[hole].position;
+	void *last = set->items[--set->count];
+	if(last != member){
+		set->items[position] = last;
+		set->values[position] = set->values[set->count];
+		set->slots[conn_set_find(set, last)].position = position;
+	}
+
+	// close the gap in the index, shifting back entries that probed past it
+	unsigned int slot = hole;
+	for(;;){
+		slot = (slot + 1) & mask;
+		if(set->slots[slot].member == NULL)
+			break;
+		unsigned int home = conn_set_hash(set, set->slots[slot].member);
+		if(((slot - home) & mask) >= ((slot - hole) & mask)){
+			set->slots[hole] = set->slots[slot];
+			hole = slot;
+		}
+	}
+	set->slots[hole].member = NULL;
+	return true;
+}
+
+bool conn_set_contains(conn_set_t *set, void *member){
+	return set->count > 0 && set->slots[conn_set_find(set, member)].member != NULL;
+}
+
+void *conn_set_lookup(conn_set_t *set, void *member){
+	if(set->count == 0)
+		return NULL;
+	struct conn_slot *slot = &set->slots[conn_set_find(set, member)];
+	return slot->member != NULL ? set->values[slot->position] : NULL;
+}
+
+unsigned int conn_set_size(conn_set_t *set){
+	return set->count;
+}
+
+void *conn_set_get(conn_set_t *set, unsigned int position){
+	return position < set->count ? set->items[position] : NULL;
+}
+
+void *conn_set_next(conn_set_t *set){
+	if(set->count == 0)
+		return NULL;
+	if(set->next >= set->count)
+		set->next = 0;
+	return set->items[set->next++];
+}
@@ -0,0 +1,47 @@
+/*
+ * conn_set.h
+ *
+ * Set of the channels a channel is bound to, each with a value describing the
+ * binding. Members live in an array, for cheap iteration, alongside an
+ * open-addressed index from member to array position, so lookups, insertion and
+ * removal are all O(1).
+ *
+ */
+
+#ifndef CONN_SET_H
+#define CONN_SET_H
+
+#include <stdbool.h>
+
+
+struct conn_slot {
+	void *member;		// NULL if the slot is free
+	unsigned int position;	// index of member in items
+};
+
+typedef struct conn_set {
+	void **items;		// members, in no particular order
+	void **values;		// value of each member, at the same position
+	unsigned int count;	// number of members
+	unsigned int capacity;	// length of items
+	unsigned int next;	// position conn_set_next returns next, rotated so every member gets a turn
+	struct conn_slot *slots;	// index of members, 2 * capacity slots, linearly probed
+} conn_set_t;
+
+
+void conn_set_init(conn_set_t *set);
+void conn_set_destroy(conn_set_t *set);
+
+bool conn_set_add(conn_set_t *set, void *member, void *value);	// false if already a member
+bool conn_set_remove(conn_set_t *set, void *member);	// false if not a member
+bool conn_set_contains(conn_set_t *set, void *member);
+void *conn_set_lookup(conn_set_t *set, void *member);	// member's value, or NULL if not a member
+
+// Number of members, and the member at a position (0 to count-1). Positions change when a member is removed.
+unsigned int conn_set_size(conn_set_t *set);
+void *conn_set_get(conn_set_t *set, unsigned int position);
+// The next member in round-robin order, or NULL if the set is empty.
+void *conn_set_next(conn_set_t *set);
+
+
+#endif /* CONN_SET_H */
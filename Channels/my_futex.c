@@ -0,0 +1,47 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "my_futex.h"
+
+void my_futex_wait(atomic_uint *word, unsigned int expected){
+	syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+bool my_futex_wait_until(atomic_uint *word, unsigned int expected, const struct timespec *deadline){
+	// FUTEX_WAIT_BITSET takes an absolute time, on CLOCK_MONOTONIC unless told otherwise
+	if(syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, NULL, FUTEX_BITSET_MATCH_ANY) != 0)
+		return errno != ETIMEDOUT;
+	return true;
+}
+
+void my_futex_wake(atomic_uint *word, int count){
+	syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+void my_futex_wait_shared(atomic_uint *word, unsigned int expected){
+	syscall(SYS_futex, (unsigned int*)word, FUTEX_WAIT, expected, NULL, NULL, 0);
+}
+
+void my_futex_wake_shared(atomic_uint *word, int count){
+	syscall(SYS_futex, (unsigned int*)word, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+void my_cpu_relax(void){
+#if defined(__x86_64__) || defined(__i386__)
+	__asm__ __volatile__("pause");
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+int my_spin_limit(int limit){
+	static atomic_int cpus;
+	int online = atomic_load_explicit(&cpus, memory_order_relaxed);
+	if(online == 0){
+		online = (int)sysconf(_SC_NPROCESSORS_ONLN);
+		atomic_store_explicit(&cpus, online, memory_order_relaxed);
+	}
+	return online > 1 ? limit : 0;
+}
@@ -0,0 +1,33 @@
+/*
+ * my_futex.h
+ *
+ * Thin wrappers around the Linux futex system call, used to park and wake
+ * threads on a 32-bit atomic word without a mutex/condvar pair.
+ *
+ */
+
+#ifndef MY_FUTEX_H
+#define MY_FUTEX_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+
+// Sleep while *word == expected. May return spuriously, so callers must re-check their condition.
+void my_futex_wait(atomic_uint *word, unsigned int expected);
+// As my_futex_wait, giving up at deadline (on CLOCK_MONOTONIC). False if the deadline has passed.
+bool my_futex_wait_until(atomic_uint *word, unsigned int expected, const struct timespec *deadline);
+// Wake up to count threads sleeping on word.
+void my_futex_wake(atomic_uint *word, int count);
+// As above, for a word in memory shared between processes.
+void my_futex_wait_shared(atomic_uint *word, unsigned int expected);
+void my_futex_wake_shared(atomic_uint *word, int count);
+
+// Hint to the CPU that we are in a spin-wait loop.
+void my_cpu_relax(void);
+// Number of times worth spinning before sleeping: limit, or 0 on a single CPU where the other thread can't progress.
+int my_spin_limit(int limit);
+
+
+#endif /* MY_FUTEX_H */
@@ -1,50 +1,83 @@
 #include "my_semaphore.h"
+#include "my_futex.h"
+
+#define MY_SEM_SPIN_MAX 100	// never spin more than this many times before sleeping
 
 int my_sem_init(my_sem_t *sem, int value){
-	sem->value = value;
-	if( (pthread_cond_init(&sem->cond, NULL)) == -1)
+	if(value < 0)
 		return -1;
-	return pthread_mutex_init(&sem->mutex, NULL);
+	atomic_init(&sem->value, (unsigned int)value);
+	atomic_init(&sem->waiters, 0);
+	atomic_init(&sem->spin, 0);
+	return 0;
 }
 
 void my_sem_destroy(my_sem_t *sem){
-	pthread_mutex_lock(&sem->mutex);
-	pthread_cond_destroy(&sem->cond);
-	sem->value = -1;
-	pthread_mutex_unlock(&sem->mutex);
-	pthread_mutex_destroy(&sem->mutex);
+	atomic_store(&sem->value, 0);
 }
 
+// Take one from the value if it is positive, leaving a counting semaphore's remainder or emptying a binary one.
+static int my_sem_tryDecrement(my_sem_t *sem){
+	unsigned int value = atomic_load_explicit(&sem->value, memory_order_relaxed);
+	while(value > 0){
+		if(atomic_compare_exchange_weak_explicit(&sem->value, &value, value - 1,
+		                                         memory_order_acquire, memory_order_relaxed))
+			return 1;
+	}
+	return 0;
+}
 
-void my_sem_wait(my_sem_t *sem){
-	pthread_mutex_lock(&sem->mutex);
-	if(sem->value <= 0){
-		pthread_cond_wait(&sem->cond, &sem->mutex);
+// Spin for a while, adapting the spin count towards what has been needed recently, then sleep until acquired.
+static void my_sem_acquire(my_sem_t *sem){
+	if(my_sem_tryDecrement(sem))
+		return;
+
+	int limit = my_spin_limit(MY_SEM_SPIN_MAX);
+	if(limit > 0){
+		int spin = atomic_load_explicit(&sem->spin, memory_order_relaxed);
+		int max = spin * 2 + 10;
+		if(max > limit)
+			max = limit;
+		int count;
+		for(count = 0; count < max; count++){
+			my_cpu_relax();
+			if(atomic_load_explicit(&sem->value, memory_order_relaxed) > 0 && my_sem_tryDecrement(sem)){
+				atomic_store_explicit(&sem->spin, spin + (count - spin) / 8, memory_order_relaxed);
+				return;
+			}
+		}
+		atomic_store_explicit(&sem->spin, spin + (count - spin) / 8, memory_order_relaxed);
+	}
+
+	// loop, since a futex wait can return without a post (or another thread can take the post first)
+	while(!my_sem_tryDecrement(sem)){
+		atomic_fetch_add(&sem->waiters, 1);
+		my_futex_wait(&sem->value, 0);
+		atomic_fetch_sub(&sem->waiters, 1);
 	}
-	sem->value--;
-	pthread_mutex_unlock(&sem->mutex);
+}
+
+void my_sem_wait(my_sem_t *sem){
+	my_sem_acquire(sem);
+}
+
+bool my_sem_trywait(my_sem_t *sem){
+	return my_sem_tryDecrement(sem);
 }
 
 void my_sem_post(my_sem_t *sem){
-	pthread_mutex_lock(&sem->mutex);
-	sem->value++;
-	pthread_cond_signal(&sem->cond);
-	pthread_mutex_unlock(&sem->mutex);
+	atomic_fetch_add(&sem->value, 1);
+	if(atomic_load(&sem->waiters) > 0)
+		my_futex_wake(&sem->value, 1);
 }
 
 void binary_sem_wait(my_sem_t *sem){
-	pthread_mutex_lock(&sem->mutex);
-	if(sem->value == 0){
-		pthread_cond_wait(&sem->cond, &sem->mutex);
-	}
-	sem->value = 0;
-	pthread_mutex_unlock(&sem->mutex);
+	my_sem_acquire(sem);	// value is only ever 0 or 1, so this takes it to 0
 }
 
 
 void binary_sem_post(my_sem_t *sem){
-	pthread_mutex_lock(&sem->mutex);
-	sem->value = 1;
-	pthread_cond_signal(&sem->cond);
-	pthread_mutex_unlock(&sem->mutex);
+	atomic_store(&sem->value, 1);
+	if(atomic_load(&sem->waiters) > 0)
+		my_futex_wake(&sem->value, 1);
 }
@@ -1,13 +1,17 @@
 #ifndef MY_SEMAPHORE_H
 #define MY_SEMAPHORE_H
 
-#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
 
 
+// Futex-backed semaphore. Waiting on a semaphore with a positive value, or posting one nobody is waiting on,
+// makes no system calls; a waiter spins for a while (adapted to how long spinning has paid off recently) before
+// sleeping on value with a futex.
 typedef struct my_sem {
-	pthread_mutex_t mutex;
-	pthread_cond_t cond;
-	volatile int value;
+	atomic_uint value;	// count, or 0/1 for a binary semaphore
+	atomic_uint waiters;	// number of threads sleeping (or about to sleep) on value
+	atomic_int spin;	// running estimate of how many spins it takes to acquire
 } my_sem_t;
 
 
@@ -15,6 +19,7 @@ int my_sem_init(my_sem_t *sem, int value);
 void my_sem_destroy(my_sem_t *sem);
 
 void my_sem_wait(my_sem_t *sem);
+bool my_sem_trywait(my_sem_t *sem);	// take one if the value is positive, without waiting; false if it wasn't
 void my_sem_post(my_sem_t *sem);
 void binary_sem_wait(my_sem_t *sem);
 void binary_sem_post(my_sem_t *sem);
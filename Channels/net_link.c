@@ -0,0 +1,543 @@
+#define _GNU_SOURCE
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "net_link.h"
+#include "my_semaphore.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+
+#define NET_LINK_DATA 1			// datagram kind: kind, nonce, first sequence number, count, then each message
+#define NET_LINK_ACK 2			// datagram kind: kind, nonce, messages received, messages taken
+#define NET_LINK_HEADER 17		// most bytes before a data datagram's messages
+#define NET_LINK_MAX_DATAGRAM 65000	// largest datagram sent, so a single message can't be much larger
+#define NET_LINK_MAX_COUNT 65535	// most messages in a datagram
+
+/*
+ * Integers on the wire are little endian: the nonce in 4 bytes, the count in 2, and sequence numbers and lengths as
+ * varints (7 bits a byte, least significant first, top bit set on all but the last byte).
+ */
+
+static size_t net_link_putVarint(char *buffer, uint64_t value){
+	size_t used = 0;
+	while(value >= 0x80){
+		buffer[used++] = (char)(value | 0x80);
+		value >>= 7;
+	}
+	buffer[used++] = (char)value;
+	return used;
+}
+
+// Read a varint from buffer[*used..length), advancing *used. False if it runs off the end.
+static bool net_link_getVarint(const char *buffer, size_t length, size_t *used, uint64_t *value){
+	*value = 0;
+	unsigned int shift;
+	for(shift = 0; *used < length && shift < 64; shift += 7){
+		uint8_t byte = (uint8_t)buffer[(*used)++];
+		*value |= (uint64_t)(byte & 0x7F) << shift;
+		if((byte & 0x80) == 0)
+			return true;
+	}
+	return false;
+}
+
+static size_t net_link_putHeader(char *buffer, uint8_t kind, uint32_t nonce){
+	buffer[0] = (char)kind;
+	for(int i = 0; i < 4; i++)
+		buffer[1 + i] = (char)(nonce >> (8 * i));
+	return 5;
+}
+
+static uint32_t net_link_getNonce(const char *buffer){
+	uint32_t nonce = 0;
+	for(int i = 0; i < 4; i++)
+		nonce |= (uint32_t)(uint8_t)buffer[1 + i] << (8 * i);
+	return nonce;
+}
+
+static uint64_t net_link_now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+
+struct net_pending {		// a datagram whose messages haven't all been acknowledged as taken
+	uint64_t end;		// sequence number after its last message
+	size_t length;
+	char *data;
+};
+
+struct net_peer {		// a sending end we have received from
+	uint32_t nonce;
+	struct sockaddr_storage address;	// where its acknowledgements go
+	socklen_t address_length;
+	uint64_t received;	// sequence number after the last message accepted
+	uint64_t consumed;	// sequence number after the last message taken
+};
+
+struct net_message {		// a message waiting to be taken
+	char *data;
+	size_t length;
+	unsigned int peer;	// index into peers of its sender
+	bool last;		// last of its datagram, acknowledged as taken once it is
+};
+
+struct net_link {
+	int fd;
+	char path[sizeof(((struct sockaddr_un*)0)->sun_path)];	// Unix socket to remove on close, or empty
+	unsigned int window;
+	pthread_mutex_t mutex;		// guards stats, and at the receiving end, peers and queue
+	struct net_link_stats stats;
+
+	// sending end
+	struct sockaddr_storage peer;
+	socklen_t peer_length;
+	uint32_t nonce;			// identifies this sending end to the receiver, so a restarted sender starts afresh
+	uint64_t sent;			// sequence number of the next message
+	uint64_t delivered;		// messages acknowledged as received
+	uint64_t consumed;		// messages acknowledged as taken
+	struct net_pending *pending;	// datagrams sent but not acknowledged as taken, oldest first
+	unsigned int pending_count;
+	unsigned int pending_capacity;
+	uint64_t resend_at;		// when to resend pending datagrams if nothing is acknowledged
+	unsigned int retries;		// resends since the last acknowledgement
+	char *datagram;			// NET_LINK_MAX_DATAGRAM bytes, for building datagrams
+
+	// receiving end
+	pthread_t reader;		// accepts datagrams as they arrive
+	bool reading;
+	struct net_peer *peers;
+	unsigned int peer_count;
+	unsigned int peer_capacity;
+	struct net_message *queue;	// ring of messages waiting to be taken
+	unsigned int queue_head;
+	unsigned int queue_count;
+	unsigned int queue_capacity;
+	my_sem_t queued;		// number of messages in queue
+};
+
+
+// Parse "unix:path" or "udp:a.b.c.d:port".
+static bool net_link_address(const char *text, struct sockaddr_storage *address, socklen_t *length){
+	memset(address, 0, sizeof(*address));
+	if(strncmp(text, "unix:", 5) == 0){
+		struct sockaddr_un *un = (struct sockaddr_un*)address;
+		if(text[5] == '\0' || strlen(text + 5) >= sizeof(un->sun_path))
+			return false;
+		un->sun_family = AF_UNIX;
+		strcpy(un->sun_path, text + 5);
+		*length = sizeof(struct sockaddr_un);
+		return true;
+	}
+	if(strncmp(text, "udp:", 4) == 0){
+		struct sockaddr_in *in = (struct sockaddr_in*)address;
+		const char *colon = strrchr(text + 4, ':');
+		char host[INET_ADDRSTRLEN];
+		if(colon == NULL || (size_t)(colon - (text + 4)) >= sizeof(host))
+			return false;
+		memcpy(host, text + 4, (size_t)(colon - (text + 4)));
+		host[colon - (text + 4)] = '\0';
+		char *end;
+		unsigned long port = strtoul(colon + 1, &end, 10);
+		if(colon[1] == '\0' || *end != '\0' || port > 65535 || inet_pton(AF_INET, host, &(in->sin_addr)) != 1)
+			return false;
+		in->sin_family = AF_INET;
+		in->sin_port = htons((uint16_t)port);
+		*length = sizeof(struct sockaddr_in);
+		return true;
+	}
+	return false;
+}
+
+static void net_link_sendAck(net_link_t *link, uint32_t nonce, uint64_t received, uint64_t consumed,
+                             const struct sockaddr_storage *address, socklen_t length){
+	char ack[NET_LINK_HEADER + 10];
+	size_t used = net_link_putHeader(ack, NET_LINK_ACK, nonce);
+	used += net_link_putVarint(ack + used, received);
+	used += net_link_putVarint(ack + used, consumed);
+	sendto(link->fd, ack, used, 0, (const struct sockaddr*)address, length);
+}
+
+
+/*
+ * Receiving end.
+ *
+ * A reader thread accepts each datagram in order, queueing its messages and acknowledging its receipt straight away.
+ * A datagram which skips ahead of what has been accepted from its sender means an earlier one was lost; it is dropped,
+ * and the sender resends both. One which has already been accepted is a resend whose acknowledgement was lost, and is
+ * just acknowledged again. Taking the last message of a datagram acknowledges everything in it as taken.
+ */
+
+// Find the peer a nonce belongs to, adding it (as having sent everything before first) if it's new. mutex must be held.
+static unsigned int net_link_peer(net_link_t *link, uint32_t nonce, uint64_t first){
+	unsigned int i;
+	for(i = 0; i < link->peer_count; i++)
+		if(link->peers[i].nonce == nonce)
+			return i;
+
+	if(link->peer_count == link->peer_capacity){
+		unsigned int capacity = link->peer_capacity == 0 ? 4 : 2 * link->peer_capacity;
+		struct net_peer *peers = GC_alloc(capacity * sizeof(struct net_peer), false);
+		if(link->peers != NULL){
+			memcpy(peers, link->peers, link->peer_count * sizeof(struct net_peer));
+			GC_decRef(link->peers);
+		}
+		link->peers = peers;
+		link->peer_capacity = capacity;
+	}
+	struct net_peer *peer = &(link->peers[link->peer_count]);
+	peer->nonce = nonce;
+	peer->received = first;
+	peer->consumed = first;
+	return link->peer_count++;
+}
+
+// Add a message to the tail of the queue. mutex must be held.
+static void net_link_enqueue(net_link_t *link, struct net_message *message){
+	if(link->queue_count == link->queue_capacity){
+		unsigned int capacity = link->queue_capacity == 0 ? 16 : 2 * link->queue_capacity;
+		struct net_message *queue = GC_alloc(capacity * sizeof(struct net_message), false);
+		unsigned int i;
+		for(i = 0; i < link->queue_count; i++)
+			queue[i] = link->queue[(link->queue_head + i) % link->queue_capacity];
+		if(link->queue != NULL)
+			GC_decRef(link->queue);
+		link->queue = queue;
+		link->queue_head = 0;
+		link->queue_capacity = capacity;
+	}
+	link->queue[(link->queue_head + link->queue_count++) % link->queue_capacity] = *message;
+}
+
+static void net_link_accept(net_link_t *link, const char *datagram, size_t length,
+                            const struct sockaddr_storage *from, socklen_t from_length){
+	size_t used = 5;
+	uint64_t first;
+	if(length < used + 3 || datagram[0] != NET_LINK_DATA || !net_link_getVarint(datagram, length, &used, &first) ||
+	   used + 2 > length)
+		return;	// not ours, or truncated
+	uint32_t nonce = net_link_getNonce(datagram);
+	unsigned int count = (uint8_t)datagram[used] | (unsigned int)(uint8_t)datagram[used + 1] << 8;
+	used += 2;
+
+	pthread_mutex_lock(&(link->mutex));
+	unsigned int index = net_link_peer(link, nonce, first);
+	struct net_peer *peer = &(link->peers[index]);
+	memcpy(&(peer->address), from, from_length);
+	peer->address_length = from_length;
+
+	unsigned int accepted = 0;
+	if(first > peer->received){
+		link->stats.discarded++;
+	} else if(first + count > peer->received){
+		// parse every message before queueing any, so a malformed datagram is dropped whole
+		size_t start = used;
+		unsigned int i;
+		for(i = 0; i < count; i++){
+			uint64_t size;
+			if(!net_link_getVarint(datagram, length, &used, &size) || size > length - used)
+				break;
+			used += size;
+		}
+		if(i < count){
+			link->stats.discarded++;
+		} else {
+			used = start;
+			for(i = 0; i < count; i++){
+				uint64_t size;
+				net_link_getVarint(datagram, length, &used, &size);
+				if(first + i >= peer->received){
+					struct net_message message = { GC_alloc(size > 0 ? size : 1, false), size, index, i == count - 1 };
+					memcpy(message.data, datagram + used, size);
+					net_link_enqueue(link, &message);
+					accepted++;
+				}
+				used += size;
+			}
+			peer->received = first + count;
+			link->stats.datagrams++;
+			link->stats.messages += accepted;
+		}
+	}
+	uint64_t received = peer->received;
+	uint64_t consumed = peer->consumed;
+	pthread_mutex_unlock(&(link->mutex));
+
+	net_link_sendAck(link, nonce, received, consumed, from, from_length);
+	for(; accepted > 0; accepted--)
+		my_sem_post(&(link->queued));
+}
+
+static void *net_link_read(void *arg){
+	net_link_t *link = arg;
+	char *datagram = malloc(NET_LINK_MAX_DATAGRAM);
+	pthread_cleanup_push(free, datagram);
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+	for(;;){
+		struct sockaddr_storage from;
+		socklen_t from_length = sizeof(from);
+		// only cancelled while waiting for a datagram, never with the mutex held
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+		ssize_t length = recvfrom(link->fd, datagram, NET_LINK_MAX_DATAGRAM, 0, (struct sockaddr*)&from, &from_length);
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		if(length > 0)
+			net_link_accept(link, datagram, (size_t)length, &from, from_length);
+	}
+	pthread_cleanup_pop(1);
+	return NULL;
+}
+
+void *net_link_receive(net_link_t *link, size_t *length){
+	my_sem_wait(&(link->queued));
+
+	pthread_mutex_lock(&(link->mutex));
+	struct net_message message = link->queue[link->queue_head];
+	link->queue_head = (link->queue_head + 1) % link->queue_capacity;
+	link->queue_count--;
+	struct net_peer peer = link->peers[message.peer];
+	peer.consumed = ++(link->peers[message.peer].consumed);
+	pthread_mutex_unlock(&(link->mutex));
+
+	if(message.last)
+		net_link_sendAck(link, peer.nonce, peer.received, peer.consumed, &(peer.address), peer.address_length);
+	*length = message.length;
+	return message.data;
+}
+
+
+/*
+ * Sending end.
+ *
+ * Messages are numbered and packed into datagrams of up to NET_LINK_DATAGRAM bytes, and at most the window's worth
+ * of messages (or 1) each, so that a receiver acknowledging whole datagrams as taken always lets the sender move on.
+ * After each datagram the sender reads acknowledgements until no more than the window's worth of messages are
+ * untaken. Every NET_LINK_RETRY_NS without an acknowledgement it resends whatever hasn't been acknowledged as
+ * received, or if everything has, the newest datagram, so that a lost acknowledgement of taking it is repeated. If
+ * nothing is acknowledged for NET_LINK_RETRIES resends in a row, the receiver is presumed unreachable and the send's
+ * status unknown, as InceOS's SendStatusUnknownException reports; the messages are written off and the send fails.
+ */
+
+static void net_link_addPending(net_link_t *link, uint64_t end, size_t length){
+	if(link->pending_count == link->pending_capacity){
+		unsigned int capacity = link->pending_capacity == 0 ? 4 : 2 * link->pending_capacity;
+		struct net_pending *pending = GC_alloc(capacity * sizeof(struct net_pending), false);
+		if(link->pending != NULL){
+			memcpy(pending, link->pending, link->pending_count * sizeof(struct net_pending));
+			GC_decRef(link->pending);
+		}
+		link->pending = pending;
+		link->pending_capacity = capacity;
+	}
+	struct net_pending *datagram = &(link->pending[link->pending_count++]);
+	datagram->end = end;
+	datagram->length = length;
+	datagram->data = GC_alloc(length, false);
+	memcpy(datagram->data, link->datagram, length);
+}
+
+// Forget datagrams acknowledged as taken.
+static void net_link_dropTaken(net_link_t *link){
+	unsigned int taken;
+	for(taken = 0; taken < link->pending_count && link->pending[taken].end <= link->consumed; taken++)
+		GC_decRef(link->pending[taken].data);
+	link->pending_count -= taken;
+	memmove(link->pending, link->pending + taken, link->pending_count * sizeof(struct net_pending));
+}
+
+// Read whatever acknowledgements have arrived, waiting until the next resend is due for the first.
+static void net_link_readAcks(net_link_t *link){
+	uint64_t now = net_link_now();
+	int timeout = link->resend_at > now ? (int)((link->resend_at - now + 999999) / 1000000) : 0;
+	struct pollfd poll_fd = { link->fd, POLLIN, 0 };
+	if(poll(&poll_fd, 1, timeout) <= 0)
+		return;
+
+	char ack[NET_LINK_HEADER + 10];
+	ssize_t length;
+	while((length = recv(link->fd, ack, sizeof(ack), MSG_DONTWAIT)) > 0){
+		size_t used = 5;
+		uint64_t received, consumed;
+		if(length < 7 || ack[0] != NET_LINK_ACK || net_link_getNonce(ack) != link->nonce ||
+		   !net_link_getVarint(ack, (size_t)length, &used, &received) ||
+		   !net_link_getVarint(ack, (size_t)length, &used, &consumed) || received > link->sent)
+			continue;
+		// the receiver is still there, even if it hasn't taken anything more
+		link->retries = 0;
+		link->resend_at = net_link_now() + NET_LINK_RETRY_NS;
+		if(received > link->delivered)
+			link->delivered = received;
+		if(consumed > link->consumed)
+			link->consumed = consumed;
+	}
+	net_link_dropTaken(link);
+}
+
+// Wait for the receiver to take all but window messages. False if it stopped responding and they were written off.
+static bool net_link_await(net_link_t *link){
+	while(link->sent - link->consumed > link->window){
+		net_link_readAcks(link);
+		if(link->sent - link->consumed <= link->window || net_link_now() < link->resend_at)
+			continue;
+
+		if(++(link->retries) > NET_LINK_RETRIES){
+			char address[INET_ADDRSTRLEN + 8] = "";
+			if(link->peer.ss_family == AF_INET)
+				inet_ntop(AF_INET, &(((struct sockaddr_in*)&(link->peer))->sin_addr), address, INET_ADDRSTRLEN);
+			log_logMessage(ERROR, "Channels", "SendStatusUnknownException: %llu messages to %s not acknowledged",
+			               (unsigned long long)(link->sent - link->delivered),
+			               link->peer.ss_family == AF_UNIX ? ((struct sockaddr_un*)&(link->peer))->sun_path : address);
+			pthread_mutex_lock(&(link->mutex));
+			link->stats.unknown += link->sent - link->delivered;
+			pthread_mutex_unlock(&(link->mutex));
+			link->delivered = link->consumed = link->sent;
+			net_link_dropTaken(link);
+			link->retries = 0;
+			return false;
+		}
+		unsigned int first;
+		for(first = 0; first < link->pending_count && link->pending[first].end <= link->delivered; first++);
+		if(first == link->pending_count)
+			first = link->pending_count - 1;	// all received; a resend of the newest is answered with where the receiver is up to
+		unsigned int i;
+		for(i = first; i < link->pending_count; i++)
+			sendto(link->fd, link->pending[i].data, link->pending[i].length, 0, (struct sockaddr*)&(link->peer), link->peer_length);
+		pthread_mutex_lock(&(link->mutex));
+		link->stats.resent += link->pending_count - first;
+		pthread_mutex_unlock(&(link->mutex));
+		link->resend_at = net_link_now() + NET_LINK_RETRY_NS;
+	}
+	return true;
+}
+
+int net_link_send(net_link_t *link, void *const *messages, const size_t *lengths, unsigned int n){
+	unsigned int most = link->window > 0 ? (link->window < NET_LINK_MAX_COUNT ? link->window : NET_LINK_MAX_COUNT) : 1;
+	int result = 0;
+	unsigned int next = 0;
+	while(next < n){
+		if(lengths[next] > NET_LINK_MAX_DATAGRAM - NET_LINK_HEADER - 10){
+			log_logMessage(ERROR, "Channels", "A %zu byte message is too large to send", lengths[next]);
+			next++;
+			result = -1;
+			continue;
+		}
+
+		// coalesce as many messages as fit, but always at least one
+		size_t used = net_link_putHeader(link->datagram, NET_LINK_DATA, link->nonce);
+		used += net_link_putVarint(link->datagram + used, link->sent);
+		size_t count_at = used;
+		used += 2;
+		unsigned int count;
+		for(count = 0; next + count < n && count < most; count++){
+			size_t length = lengths[next + count];
+			if(count > 0 && used + 10 + length > NET_LINK_DATAGRAM)
+				break;
+			if(used + 10 + length > NET_LINK_MAX_DATAGRAM)
+				break;
+			used += net_link_putVarint(link->datagram + used, length);
+			memcpy(link->datagram + used, messages[next + count], length);
+			used += length;
+		}
+		link->datagram[count_at] = (char)count;
+		link->datagram[count_at + 1] = (char)(count >> 8);
+
+		if(link->pending_count == 0)
+			link->resend_at = net_link_now() + NET_LINK_RETRY_NS;
+		sendto(link->fd, link->datagram, used, 0, (struct sockaddr*)&(link->peer), link->peer_length);
+		link->sent += count;
+		net_link_addPending(link, link->sent, used);
+		next += count;
+		pthread_mutex_lock(&(link->mutex));
+		link->stats.messages += count;
+		link->stats.datagrams++;
+		pthread_mutex_unlock(&(link->mutex));
+
+		if(!net_link_await(link))
+			result = -1;
+	}
+	return result;
+}
+
+
+net_link_t *net_link_open(const char *local, const char *peer, unsigned int window){
+	struct sockaddr_storage local_address;
+	socklen_t local_length;
+	net_link_t *link = GC_alloc(sizeof(net_link_t), false);
+	if(!net_link_address(local, &local_address, &local_length) ||
+	   (peer != NULL && (!net_link_address(peer, &(link->peer), &(link->peer_length)) ||
+	                     link->peer.ss_family != local_address.ss_family))){
+		log_logMessage(ERROR, "Channels", "Bad address for %s: expected unix:path or udp:a.b.c.d:port, both the same kind",
+		               peer != NULL ? peer : local);
+		GC_decRef(link);
+		return NULL;
+	}
+
+	link->fd = socket(local_address.ss_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+	if(local_address.ss_family == AF_UNIX){
+		strcpy(link->path, ((struct sockaddr_un*)&local_address)->sun_path);
+		unlink(link->path);	// left behind by an earlier run
+	}
+	if(link->fd < 0 || bind(link->fd, (struct sockaddr*)&local_address, local_length) != 0){
+		log_logMessage(ERROR, "Channels", "Can't bind %s: %s", local, strerror(errno));
+		if(link->fd >= 0)
+			close(link->fd);
+		GC_decRef(link);
+		return NULL;
+	}
+
+	link->window = window;
+	pthread_mutex_init(&(link->mutex), NULL);
+	my_sem_init(&(link->queued), 0);
+	if(peer != NULL){
+		link->nonce = (uint32_t)(net_link_now() ^ ((uint64_t)getpid() << 16) ^ (uintptr_t)link);
+		link->datagram = GC_alloc(NET_LINK_MAX_DATAGRAM, false);
+	} else {
+		pthread_create(&(link->reader), NULL, net_link_read, link);
+		link->reading = true;
+	}
+	log_logMessage(INFO, "Channels", "Opened %s link on %s%s%s", peer != NULL ? "sending" : "receiving", local,
+	               peer != NULL ? " to " : "", peer != NULL ? peer : "");
+	return link;
+}
+
+void net_link_close(net_link_t *link){
+	if(link->reading){
+		pthread_cancel(link->reader);
+		pthread_join(link->reader, NULL);
+	}
+	close(link->fd);
+	if(link->path[0] != '\0')
+		unlink(link->path);
+
+	unsigned int i;
+	for(i = 0; i < link->pending_count; i++)
+		GC_decRef(link->pending[i].data);
+	for(i = 0; i < link->queue_count; i++)
+		GC_decRef(link->queue[(link->queue_head + i) % link->queue_capacity].data);
+	if(link->pending != NULL)
+		GC_decRef(link->pending);
+	if(link->queue != NULL)
+		GC_decRef(link->queue);
+	if(link->peers != NULL)
+		GC_decRef(link->peers);
+	if(link->datagram != NULL)
+		GC_decRef(link->datagram);
+	pthread_mutex_destroy(&(link->mutex));
+	my_sem_destroy(&(link->queued));
+	GC_decRef(link);
+}
+
+void net_link_getStats(net_link_t *link, struct net_link_stats *stats){
+	pthread_mutex_lock(&(link->mutex));
+	*stats = link->stats;
+	pthread_mutex_unlock(&(link->mutex));
+}
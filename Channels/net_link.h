@@ -0,0 +1,49 @@
+/*
+ * net_link.h
+ *
+ * Acknowledged message link over Unix datagram or UDP sockets, for connecting channels of CVMs on different (emulated)
+ * nodes. The sending end numbers its messages and coalesces as many as fit into each datagram; the receiving end
+ * acknowledges datagrams as they arrive, so lost ones are resent, and acknowledges messages again once they have been
+ * taken by net_link_receive, which is what a sender waits for. A window of 0 makes each send synchronous: it returns
+ * once its message has been received. A larger window lets that many messages be in flight unreceived.
+ *
+ * Addresses are "unix:/path/to/socket" or "udp:a.b.c.d:port".
+ *
+ */
+
+#ifndef NET_LINK_H
+#define NET_LINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+#define NET_LINK_DATAGRAM 1400		// bytes of messages coalesced into a datagram, unless a single message is larger
+#define NET_LINK_RETRY_NS 100000000u	// time to wait for a datagram to be acknowledged before resending it
+#define NET_LINK_RETRIES 50		// resends without any progress before a send's status is declared unknown
+
+struct net_link_stats {
+	unsigned long messages;		// messages sent, or received
+	unsigned long datagrams;	// datagrams sent (not counting resends), or accepted
+	unsigned long resent;		// datagrams resent because they weren't acknowledged in time
+	unsigned long unknown;		// sends given up on, their messages' fate unknown (SendStatusUnknownException)
+	unsigned long discarded;	// datagrams received out of order or from a previous sender, and dropped
+};
+
+typedef struct net_link net_link_t;
+
+
+// Bind a socket to local and, for a sending end, direct it at peer; a receiving end passes NULL for peer. Returns
+// NULL, having logged why, if an address is malformed or the socket can't be set up.
+net_link_t *net_link_open(const char *local, const char *peer, unsigned int window);
+void net_link_close(net_link_t *link);
+
+// Send n messages, returning once no more than the window's worth are unreceived. Returns -1 if some were given up on.
+int net_link_send(net_link_t *link, void *const *messages, const size_t *lengths, unsigned int n);
+// Take the oldest message received, waiting for one. Returns a GC allocated copy, and its length in *length.
+void *net_link_receive(net_link_t *link, size_t *length);
+
+void net_link_getStats(net_link_t *link, struct net_link_stats *stats);
+
+
+#endif /* NET_LINK_H */
@@ -0,0 +1,227 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "shm_ring.h"
+#include "my_futex.h"
+#include "../GC/GC_mem.h"
+#include "../Logger/Logger.h"
+
+#define SHM_RING_MAGIC 0x49534d01u	// "ISM" and a layout version; change it whenever the header changes
+#define SHM_RING_WRAP 0xFFFFFFFFu	// record length marking the rest of the ring as unused; the next record is at 0
+#define SHM_RING_ALIGN 8		// records start on multiples of this
+#define SHM_RING_MIN_SIZE 4096
+#define SHM_RING_OPEN_TRIES 500		// times to look for another process to finish creating the segment, 10ms apart
+
+// Start of the segment. Positions are totals of bytes ever written or read, so the ring is empty when they are equal
+// and a position's offset into the records is its value modulo capacity.
+struct shm_ring_header {
+	atomic_uint magic;		// SHM_RING_MAGIC once the creator has initialised everything else
+	uint64_t capacity;		// bytes of records, a power of 2
+	pthread_mutex_t write_lock;	// robust and process-shared, held while appending
+	pthread_mutex_t read_lock;	// robust and process-shared, held while removing
+	_Atomic uint64_t tail;		// position after the newest record, changed with write_lock held
+	_Atomic uint64_t head;		// position of the oldest record, changed with read_lock held
+	atomic_uint written;		// bumped after each append; readers sleep on it
+	atomic_uint taken;		// bumped after each removal; writers sleep on it
+	atomic_uint readers_waiting;	// readers sleeping (or about to sleep) on written
+	atomic_uint writers_waiting;	// writers sleeping (or about to sleep) on taken
+};
+
+#define SHM_RING_DATA_OFFSET ((sizeof(struct shm_ring_header) + 63) & ~(size_t)63)
+
+struct shm_ring {
+	struct shm_ring_header *header;	// the mapped segment
+	char *data;			// the records, after the header
+	size_t mapped;			// bytes mapped
+};
+
+// Lock one of the segment's mutexes. If its last holder died, nothing it was doing had been published yet (positions
+// only move once a record is complete), so the ring is still consistent.
+static void shm_ring_lock(pthread_mutex_t *mutex){
+	if(pthread_mutex_lock(mutex) == EOWNERDEAD)
+		pthread_mutex_consistent(mutex);
+}
+
+static void shm_ring_initLock(pthread_mutex_t *mutex){
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	pthread_mutex_init(mutex, &attr);
+	pthread_mutexattr_destroy(&attr);
+}
+
+static void shm_ring_pause(void){
+	struct timespec pause = { 0, 10000000 };
+	nanosleep(&pause, NULL);
+}
+
+// Size the new segment and initialise its header, publishing it to other processes last.
+static struct shm_ring_header *shm_ring_create(int fd, size_t size){
+	uint64_t capacity = SHM_RING_MIN_SIZE;
+	while(capacity < size)
+		capacity *= 2;
+	if(ftruncate(fd, SHM_RING_DATA_OFFSET + capacity) != 0)
+		return NULL;
+	struct shm_ring_header *header = mmap(NULL, SHM_RING_DATA_OFFSET + capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(header == MAP_FAILED)
+		return NULL;
+
+	header->capacity = capacity;
+	shm_ring_initLock(&(header->write_lock));
+	shm_ring_initLock(&(header->read_lock));
+	atomic_init(&(header->tail), 0);
+	atomic_init(&(header->head), 0);
+	atomic_init(&(header->written), 0);
+	atomic_init(&(header->taken), 0);
+	atomic_init(&(header->readers_waiting), 0);
+	atomic_init(&(header->writers_waiting), 0);
+	atomic_store(&(header->magic), SHM_RING_MAGIC);
+	return header;
+}
+
+// Map a segment another process created, waiting for it to finish initialising it.
+static struct shm_ring_header *shm_ring_attach(int fd){
+	struct stat st;
+	int tries;
+	for(tries = 0; tries < SHM_RING_OPEN_TRIES; tries++){
+		if(fstat(fd, &st) == 0 && (size_t)st.st_size > SHM_RING_DATA_OFFSET){
+			struct shm_ring_header *header = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if(header == MAP_FAILED)
+				return NULL;
+			unsigned int magic = atomic_load(&(header->magic));
+			if(magic == SHM_RING_MAGIC && (size_t)st.st_size == SHM_RING_DATA_OFFSET + header->capacity)
+				return header;
+			munmap(header, (size_t)st.st_size);
+			if(magic != 0 && magic != SHM_RING_MAGIC){
+				errno = EPROTO;	// made by an incompatible version
+				return NULL;
+			}
+		}
+		shm_ring_pause();
+	}
+	errno = ETIMEDOUT;
+	return NULL;
+}
+
+shm_ring_t *shm_ring_open(const char *name, size_t size){
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	bool creator = fd >= 0;
+	if(!creator && errno == EEXIST)
+		fd = shm_open(name, O_RDWR, 0600);
+	if(fd < 0){
+		log_logMessage(ERROR, "Channels", "Can't open shared memory segment %s: %s", name, strerror(errno));
+		return NULL;
+	}
+
+	struct shm_ring_header *header = creator ? shm_ring_create(fd, size) : shm_ring_attach(fd);
+	int error = errno;
+	close(fd);
+	if(header == NULL){
+		log_logMessage(ERROR, "Channels", "Can't map shared memory segment %s: %s", name, strerror(error));
+		if(creator)
+			shm_unlink(name);
+		return NULL;
+	}
+
+	shm_ring_t *ring = GC_alloc(sizeof(shm_ring_t), false);
+	ring->header = header;
+	ring->data = (char*)header + SHM_RING_DATA_OFFSET;
+	ring->mapped = SHM_RING_DATA_OFFSET + header->capacity;
+	log_logMessage(INFO, "Channels", "%s shared memory segment %s, %llu bytes", creator ? "Created" : "Attached to", name,
+	               (unsigned long long)header->capacity);
+	return ring;
+}
+
+void shm_ring_close(shm_ring_t *ring){
+	munmap(ring->header, ring->mapped);
+	GC_decRef(ring);
+}
+
+size_t shm_ring_max_record(shm_ring_t *ring){
+	// a record that doesn't fit before the end of the ring is preceded by up to (its size - 1) bytes of padding
+	return ring->header->capacity / 2 - 2 * SHM_RING_ALIGN;
+}
+
+static uint64_t shm_ring_recordSize(size_t length){
+	return (sizeof(uint32_t) + length + SHM_RING_ALIGN - 1) & ~(uint64_t)(SHM_RING_ALIGN - 1);
+}
+
+bool shm_ring_write(shm_ring_t *ring, const void *data, size_t length){
+	struct shm_ring_header *header = ring->header;
+	if(length > shm_ring_max_record(ring))
+		return false;
+
+	shm_ring_lock(&(header->write_lock));
+	uint64_t position = atomic_load(&(header->tail));
+	uint64_t offset = position & (header->capacity - 1);
+	uint64_t size = shm_ring_recordSize(length);
+	uint64_t padding = header->capacity - offset < size ? header->capacity - offset : 0;
+
+	// wait for readers to make room
+	while(position + padding + size - atomic_load(&(header->head)) > header->capacity){
+		unsigned int taken = atomic_load(&(header->taken));
+		atomic_fetch_add(&(header->writers_waiting), 1);
+		if(position + padding + size - atomic_load(&(header->head)) > header->capacity)
+			my_futex_wait_shared(&(header->taken), taken);
+		atomic_fetch_sub(&(header->writers_waiting), 1);
+	}
+
+	if(padding > 0){
+		*(uint32_t*)(ring->data + offset) = SHM_RING_WRAP;
+		position += padding;
+		offset = 0;
+	}
+	*(uint32_t*)(ring->data + offset) = (uint32_t)length;
+	memcpy(ring->data + offset + sizeof(uint32_t), data, length);
+	atomic_store(&(header->tail), position + size);
+	pthread_mutex_unlock(&(header->write_lock));
+
+	atomic_fetch_add(&(header->written), 1);
+	if(atomic_load(&(header->readers_waiting)) > 0)
+		my_futex_wake_shared(&(header->written), INT_MAX);
+	return true;
+}
+
+void *shm_ring_read(shm_ring_t *ring, size_t *length){
+	struct shm_ring_header *header = ring->header;
+
+	shm_ring_lock(&(header->read_lock));
+	uint64_t position = atomic_load(&(header->head));
+
+	// wait for a writer to append something
+	while(atomic_load(&(header->tail)) == position){
+		unsigned int written = atomic_load(&(header->written));
+		atomic_fetch_add(&(header->readers_waiting), 1);
+		if(atomic_load(&(header->tail)) == position)
+			my_futex_wait_shared(&(header->written), written);
+		atomic_fetch_sub(&(header->readers_waiting), 1);
+	}
+
+	uint64_t offset = position & (header->capacity - 1);
+	uint32_t stored = *(uint32_t*)(ring->data + offset);
+	if(stored == SHM_RING_WRAP){
+		position += header->capacity - offset;
+		offset = 0;
+		stored = *(uint32_t*)(ring->data);
+	}
+	void *record = GC_alloc(stored > 0 ? stored : 1, false);
+	memcpy(record, ring->data + offset + sizeof(uint32_t), stored);
+	atomic_store(&(header->head), position + shm_ring_recordSize(stored));
+	pthread_mutex_unlock(&(header->read_lock));
+
+	atomic_fetch_add(&(header->taken), 1);
+	if(atomic_load(&(header->writers_waiting)) > 0)
+		my_futex_wake_shared(&(header->taken), INT_MAX);
+	*length = stored;
+	return record;
+}
@@ -0,0 +1,36 @@
+/*
+ * shm_ring.h
+ *
+ * Ring of variable length records in a POSIX shared memory segment, for passing channel data between processes on
+ * the same host. Any number of processes may open the same segment by name; writers and readers each take turns
+ * under a robust process-shared mutex, so a process dying mid-operation doesn't wedge the others, and wait for data
+ * or space on futexes in the segment.
+ *
+ */
+
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+
+#define SHM_RING_DEFAULT_SIZE 65536	// bytes of records, if the segment doesn't exist yet and no size is given
+
+typedef struct shm_ring shm_ring_t;
+
+
+// Map the named segment, creating it with size bytes of records (rounded up to a power of 2) if it doesn't exist.
+// Returns NULL, having logged why, if the segment can't be opened.
+shm_ring_t *shm_ring_open(const char *name, size_t size);
+void shm_ring_close(shm_ring_t *ring);
+
+// Append a record, waiting for space. False if the record could never fit.
+bool shm_ring_write(shm_ring_t *ring, const void *data, size_t length);
+// Remove the oldest record, waiting for one. Returns a GC allocated copy, and its length in *length.
+void *shm_ring_read(shm_ring_t *ring, size_t *length);
+// Largest record the ring can hold.
+size_t shm_ring_max_record(shm_ring_t *ring);
+
+
+#endif /* SHM_RING_H */
@@ -33,18 +33,20 @@
 
 // for garbage collection
 static void IteratedList_decRef(IteratedList_PNTR pntr);
+static void IteratedList_children(void* pntr, GC_visitFunc_t visit, void* context);
 
 // End of "private" function declarations
 
 
 // (public) functions and constructors 
 IteratedList_PNTR IteratedList_constructList(){
-    IteratedList_PNTR this = (IteratedList_PNTR) GC_alloc(sizeof(IteratedList_s), true);
+    IteratedList_PNTR this = (IteratedList_PNTR) GC_allocType(sizeof(IteratedList_s), true, "IteratedList");
     if(this == 0){
         log_logMessage(ERROR, ITERATED_LIST_NAME, ITERATED_LIST_CONSTRUCT_LIST_FAILED);
         return 0;
     }
     this->decRef = IteratedList_decRef;
+    GC_registerChildren((decRefFunc_t) IteratedList_decRef, IteratedList_children);
     return(this);
 }
 
@@ -63,4 +65,15 @@ static void IteratedList_decRef(IteratedList_PNTR pntr){
     }
 }
 
+// for cycle collection: the list's nodes belong to it alone, so the list is scanned as holding their payloads
+static void IteratedList_children(void* pntr, GC_visitFunc_t visit, void* context){
+    IteratedList_PNTR this = pntr;
+    IteratedListNode_PNTR node = this->first;
+    while(node != NULL){
+        visit(node->payload, context);
+        node = node->tail;
+        if(node == this->first) break;
+    }
+}
+
 // End of "private" functions
\ No newline at end of file
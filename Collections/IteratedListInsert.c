@@ -7,7 +7,9 @@
 static void IteratedListNode_decRef(IteratedListNode_PNTR pntr);
 
 static IteratedListNode_PNTR IteratedList_constructNode() {
-    IteratedListNode_PNTR this = (IteratedListNode_PNTR) GC_alloc(sizeof(IteratedListNode_s), true);
+    // only the list's own operations take or drop references to its nodes
+    IteratedListNode_PNTR this = (IteratedListNode_PNTR) GC_allocLocalType(sizeof(IteratedListNode_s), true,
+                                                                           "IteratedListNode");
     if (this == 0) {
         log_logMessage(ERROR, ITERATED_LIST_NAME, ITERATED_LIST_CONSTRUCT_NODE_FAILED);
         return 0;
@@ -78,7 +80,7 @@ void IteratedList_insertElementAtTail(IteratedList_PNTR l, void *element) {
     } else {
         l->last->tail = newNode;
     }
-    newNode->tail = l->first;
+    l->last = newNode;
 
 }
 
@@ -27,6 +27,7 @@ void IteratedList_removeElement(IteratedList_PNTR l, void *element) {
         l->first = oldFirst->tail;
         // take action if we are removing the next iterator node
         if(l->next == oldFirst) l->next = l->first;
+        if(l->last == oldFirst) l->last = NULL;
         GC_decRef(oldFirst);
         return;
     }
@@ -42,6 +43,7 @@ void IteratedList_removeElement(IteratedList_PNTR l, void *element) {
         if(l->next == NULL) l->next = l->first;
         // deal with removal
         previous->tail = current->tail;
+        if(l->last == current) l->last = previous;
         // explicitly free memory used by node
         GC_decRef(current);
     }
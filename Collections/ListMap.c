@@ -32,6 +32,7 @@
 #include "../GC/GC_mem.h"
 
 void ListMapEntry_decRef(ListMapEntry_PNTR pntr);
+static void ListMapEntry_children(void* pntr, GC_visitFunc_t visit, void* context);
 
 ListMap_PNTR ListMap_constructor() {
     return IteratedList_constructList();
@@ -39,7 +40,7 @@ ListMap_PNTR ListMap_constructor() {
 
 void ListMap_declare(ListMap_PNTR listMap, char *key) {
     if(ListMap_get(listMap, key)== NULL) { //Cannot "redeclare" a variable
-        ListMapEntry_PNTR newEntry = GC_alloc(sizeof(ListMapEntry_s), true);
+        ListMapEntry_PNTR newEntry = GC_allocType(sizeof(ListMapEntry_s), true, "ListMapEntry");
         newEntry->key = GC_alloc(strlen(key) + 1, false);
         strncpy(newEntry->key, key, strlen(key));
 
@@ -47,6 +48,7 @@ void ListMap_declare(ListMap_PNTR listMap, char *key) {
         //newEntry->value = NULL;
 
         newEntry->decRef = ListMapEntry_decRef;
+        GC_registerChildren((decRefFunc_t) ListMapEntry_decRef, ListMapEntry_children);
 
         IteratedList_insertElement(listMap, newEntry);
     }
@@ -83,4 +85,10 @@ bool ListMap_put(ListMap_PNTR listMap, char *key, void *value) {
 void ListMapEntry_decRef(ListMapEntry_PNTR pntr) {
     GC_decRef(pntr->key);
     GC_decRef(pntr->value);
-}
\ No newline at end of file
+}
+
+static void ListMapEntry_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    ListMapEntry_PNTR this = pntr;
+    visit(this->key, context);
+    visit(this->value, context);
+}
@@ -34,18 +34,21 @@
 
 static void Stack_decRef(Stack_PNTR pntr);
 static void StackEntry_decRef(StackEntry_PNTR pntr);
+static void Stack_children(void* pntr, GC_visitFunc_t visit, void* context);
+static void StackEntry_children(void* pntr, GC_visitFunc_t visit, void* context);
 
 Stack_PNTR Stack_constructor(){
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, STACK_NAME, STACK_CONSTRUCT);
 #endif
-    Stack_PNTR this = (Stack_PNTR) GC_alloc(sizeof(Stack_s), true);
+    Stack_PNTR this = (Stack_PNTR) GC_allocType(sizeof(Stack_s), true, "Stack");
     if(this == 0){
         log_logMessage(ERROR, STACK_NAME, STACK_CONSTRUCT_FAILED);
         return 0;
     }
     this->storage = IteratedList_constructList();
     this->decRef = Stack_decRef;
+    GC_registerChildren((decRefFunc_t) Stack_decRef, Stack_children);
     this->stackTop = 0;
     return(this);
 }
@@ -55,8 +58,10 @@ void Stack_push(Stack_PNTR this, void* item) {
     log_logMessage(DEBUG, STACK_NAME, STACK_PUSH, item, this);
 #endif
 
-    StackEntry_PNTR newEntry = GC_alloc(sizeof(StackEntry_s), true);
+    //Entries never leave the stack, so only its own operations take or drop references to them.
+    StackEntry_PNTR newEntry = GC_allocLocalType(sizeof(StackEntry_s), true, "StackEntry");
     newEntry->decRef = StackEntry_decRef;
+    GC_registerChildren((decRefFunc_t) StackEntry_decRef, StackEntry_children);
     newEntry->object = item;
 
     IteratedList_insertElement(this->storage, newEntry);
@@ -73,10 +78,11 @@ void* Stack_pop(Stack_PNTR this) {
     }
 
     StackEntry_PNTR element = IteratedList_getElementN(this->storage, 0);
-    GC_incRef(element->object);
+    void* object = element->object;    // removing the entry frees it
+    GC_incRef(object);
     IteratedList_removeElement(this->storage, element);
     this->stackTop--;
-    return element->object;
+    return object;
 }
 
 void* Stack_peek(Stack_PNTR this) {
@@ -113,9 +119,8 @@ static void Stack_decRef(Stack_PNTR this){
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, "Stack", "Decrementing reference to stack with %d entries", this->stackTop);
 #endif
-    if(this->stackTop != 0) {
-        Stack_clear(this); // forces decRef on IteratedList content (node payload)
-    }
+    //Dropping the storage drops its entries, and their objects with them. (Not popped one by one: the cycle
+    // collector may have had the storage drop its entries already.)
     GC_decRef(this->storage);
 }
 
@@ -124,4 +129,12 @@ static void StackEntry_decRef(StackEntry_PNTR this) {
     log_logMessage(DEBUG, "Stack", "Decrementing reference to stack entry");
 #endif
     GC_decRef(this->object);
-}
\ No newline at end of file
+}
+
+static void Stack_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    visit(((Stack_PNTR) pntr)->storage, context);
+}
+
+static void StackEntry_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    visit(((StackEntry_PNTR) pntr)->object, context);
+}
@@ -28,13 +28,24 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <limits.h>
+#include <stdatomic.h>
 #include "Component.h"
 #include "BytecodeTable.h"
 #include "Main.h"
 #include "ChannelWrapper.h"
 #include "Procedure.h"
+#include "ChannelConfig.h"
+#include "SharedChannel.h"
+#include "NetChannel.h"
+#include "Channels/channel_stats.h"
+#include "Trace.h"
+#include "GC/GC_profile.h"
 
 static void Component_decRef(Component_PNTR pntr);
+static void Component_children(void* pntr, GC_visitFunc_t visit, void* context);
+static void ChannelWrapper_decRef(ChannelWrapper_PNTR pntr);
+static void ChannelWrapper_children(void* pntr, GC_visitFunc_t visit, void* context);
 
 void component_cleanUpAndStop(Component_PNTR this, void* __retval);
 void component_enterScope(Component_PNTR this);
@@ -42,8 +53,10 @@ void component_exitScope(Component_PNTR this);
 TypedObject_PNTR component_readData(Component_PNTR this);
 char* component_readString(Component_PNTR this);
 void* component_readNBytes(Component_PNTR this, size_t nBytes);
+static void component_readBytes(Component_PNTR this, void* result, size_t nBytes);
 char* Component_getSourceFile(char* name);
 Component_PNTR component_call(Component_PNTR this);
+static unsigned int component_imageOf(const char* name);
 void component_constructor(Component_PNTR this);
 void component_declare(Component_PNTR this);
 void component_store(Component_PNTR this);
@@ -62,6 +75,9 @@ void component_connect(Component_PNTR this);
 void component_disconnect(Component_PNTR this);
 void component_send(Component_PNTR this);
 void component_receive(Component_PNTR this);
+void component_trySend(Component_PNTR this);
+void component_tryReceive(Component_PNTR this, bool timed);
+void component_flushChannels(Component_PNTR this);
 void component_proc(Component_PNTR this);
 void component_procCall(Component_PNTR this);
 void component_procReturn(Component_PNTR this);
@@ -73,6 +89,25 @@ void component_any(Component_PNTR this);
 void component_projectEntry(Component_PNTR this);
 void component_projectExit(Component_PNTR this);
 
+/*
+ * Literals in the bytecode are read again each time it runs over them, so each is made once, immortal (see
+ * TypedObject_constructImmortal), and shared by every instance of its component from then on. They are found by the
+ * bytecode file (image) they are in, and where in it they start.
+ */
+#define COMPONENT_IMAGES 64         // images literals are kept for; those of others are read afresh every time
+#define COMPONENT_LITERALS 4096     // a power of 2; once three quarters full, further literals are read afresh too
+
+static char* component_images[COMPONENT_IMAGES];    // component names, for their bytecode files
+static unsigned int component_imageCount = 0;
+static struct component_literal {
+    unsigned int image;                 // position in component_images + 1
+    long offset;
+    long end;                           // where the next instruction starts
+    _Atomic(TypedObject_PNTR) value;    // set once the rest is, so NULL until then
+} component_literals[COMPONENT_LITERALS];
+static unsigned int component_literalCount = 0;
+static pthread_mutex_t component_literalsLock = PTHREAD_MUTEX_INITIALIZER;  // held to add either
+
 /**
  * Construct a new component object
  * @param[in] sourceFile String containing path to bytecode source file
@@ -80,8 +115,9 @@ void component_projectExit(Component_PNTR this);
  * @return Pointer to new component object
  */
 Component_PNTR component_newComponent(char* name, char *sourceFile, IteratedList_PNTR params) {
-    Component_PNTR this = GC_alloc(sizeof(Component_s), true);
+    Component_PNTR this = GC_allocType(sizeof(Component_s), true, "Component");
     this->decRef = Component_decRef;
+    GC_registerChildren((decRefFunc_t) Component_decRef, Component_children);
 
     size_t componentNameSize = strlen(name);
     this->name = GC_alloc(componentNameSize+1, false);
@@ -92,10 +128,16 @@ Component_PNTR component_newComponent(char* name, char *sourceFile, IteratedList
         log_logMessage(FATAL, this->name, "Component Source file does not exist!");
         component_cleanUpAndStop(this, NULL);
     }
+    this->image = component_imageOf(name);
 
     this->parameters = params;
 
+    //The component and anything other components can reach through it (its name and channels) are allocated by
+    // whoever creates it. What only it uses goes in its own arena.
+    this->arena = GC_arena_create();
+    GC_arena_PNTR creatorArena = GC_arena_enter(this->arena);
     this->dataStack = Stack_constructor();
+    GC_arena_enter(creatorArena);
 
     this->channels = ListMap_constructor();
 
@@ -114,6 +156,8 @@ Component_PNTR component_newComponent(char* name, char *sourceFile, IteratedList
  */
 void* component_run(void* component) {
     Component_PNTR this = (Component_PNTR)component;
+    GC_arena_enter(this->arena);
+    GC_profile_enterComponent(this->name);
     log_logMessage(INFO, this->name, "Start");
 
     int nextByte;
@@ -191,6 +235,15 @@ void* component_run(void* component) {
             case BYTECODE_RECEIVE:
                 component_receive(this);
                 break;
+            case BYTECODE_TRY_SEND:
+                component_trySend(this);
+                break;
+            case BYTECODE_TRY_RECEIVE:
+                component_tryReceive(this, false);
+                break;
+            case BYTECODE_RECEIVE_TIMEOUT:
+                component_tryReceive(this, true);
+                break;
             case BYTECODE_PROC:
                 component_proc(this);
                 break;
@@ -228,6 +281,7 @@ void* component_run(void* component) {
 
 void component_cleanUpAndStop(Component_PNTR this, void* __retval) {
     log_logMessage(INFO, this->name, "Cleaning up Component and returning to caller.");
+    component_flushChannels(this);
 
     if(this->waitComponents != NULL) {
 #ifdef DEBUGGINGENABLED
@@ -244,6 +298,19 @@ void component_cleanUpAndStop(Component_PNTR this, void* __retval) {
 #ifdef DEBUGGINGENABLED
         log_logMessage(DEBUG, this->name, "All started components stopped.");
 #endif
+        GC_decRef(this->waitComponents);
+        this->waitComponents = NULL;
+    }
+
+    //Drop this component's own state now, rather than with the last reference to it (which its creator may hold),
+    // so that it is freed back into the arena before the arena is released.
+    if(this->scopeStack != NULL) {
+        GC_decRef(this->scopeStack);
+        this->scopeStack = NULL;
+    }
+    if(this->dataStack != NULL) {
+        GC_decRef(this->dataStack);
+        this->dataStack = NULL;
     }
 
     //Copy name so we can use it in the done message, after Component has been trashed.
@@ -251,7 +318,15 @@ void component_cleanUpAndStop(Component_PNTR this, void* __retval) {
     strcpy(name, this->name);
     name[strlen(this->name)] = '\0';
 
+    GC_arena_PNTR arena = this->arena;
     GC_decRef(this);
+    //Cycles left in the arena are freed back into it before it goes.
+    GC_cycles_collect();
+    if(arena != NULL) {
+        //Anything still live in the arena has escaped it, and keeps its slab going after the rest are freed.
+        GC_arena_enter(NULL);
+        GC_arena_release(arena);
+    }
     log_logMessage(INFO, name, "DONE. Component cleaned up.");
     free(name);
     Component_exit(__retval);
@@ -271,6 +346,94 @@ void component_exitScope(Component_PNTR this) {
     ScopeStack_exitScope(this->scopeStack);
 }
 
+/**
+ * Whether a channel carries traces rather than bare objects. Channels with a transport never do, since a trace can't
+ * leave the process.
+ * @param[in] channel Channel to check
+ * @return true if tracing is on and the channel is local
+ */
+static bool component_isTraced(Channel_PNTR channel) {
+    return Trace_isEnabled() && channel->transport == NULL;
+}
+
+/**
+ * Extend a path with this component, remembering the result, since a component usually extends the same path each
+ * time.
+ * @param[in] this Component the path is leaving
+ * @param[in] path Path so far, or 0
+ * @return The extended path
+ */
+static unsigned int component_tracePath(Component_PNTR this, unsigned int path) {
+    if(this->traceTo == 0 || this->traceFrom != path) {
+        this->traceFrom = path;
+        this->traceTo = Trace_extendPath(path, this->name);
+    }
+    return this->traceTo;
+}
+
+/**
+ * Wrap an object about to be sent, stamped with the origin of what this behaviour iteration has received, or with
+ * the current time if it hasn't received anything traced.
+ * @param[in] this Component sending
+ * @param[in] object Object to send, whose reference passes to the trace
+ * @return The trace to send instead
+ */
+static Trace_PNTR component_traceSend(Component_PNTR this, TypedObject_PNTR object) {
+    this->traceSent = true;
+    if(this->traceOrigin == 0) {
+        return Trace_wrap(object, Trace_now(), component_tracePath(this, 0));
+    }
+    return Trace_wrap(object, this->traceOrigin, component_tracePath(this, this->tracePath));
+}
+
+/**
+ * Unwrap a received trace, keeping its stamp if it is the oldest received this behaviour iteration.
+ * @param[in] this Component receiving
+ * @param[in] trace Trace received, whose reference passes to this function
+ * @return The object it carried
+ */
+static TypedObject_PNTR component_traceReceive(Component_PNTR this, Trace_PNTR trace) {
+    uint64_t origin;
+    unsigned int path;
+    TypedObject_PNTR object = Trace_unwrap(trace, &origin, &path);
+    if(this->traceOrigin == 0 || origin < this->traceOrigin) {
+        this->traceOrigin = origin;
+        this->tracePath = path;
+    }
+    return object;
+}
+
+/**
+ * End a behaviour iteration. If it received traced objects and sent nothing on, their pipeline ends here.
+ * @param[in] this Component whose behaviour is starting again
+ */
+static void component_traceIterationEnd(Component_PNTR this) {
+    if(this->traceOrigin != 0 && !this->traceSent) {
+        Trace_record(component_tracePath(this, this->tracePath), Trace_now() - this->traceOrigin);
+    }
+    this->traceOrigin = 0;
+    this->tracePath = 0;
+    this->traceSent = false;
+}
+
+/**
+ * Measure an item on one of a component's channels for the channel statistics, as its size when flattened.
+ * @param[in] item Address of the TypedObject_PNTR carried by the channel
+ * @return Bytes the object flattens to, or 0 if it can't be flattened
+ */
+static size_t component_measureItem(void* item) {
+    return TypedObject_encode(*(TypedObject_PNTR*)item, NULL, 0);
+}
+
+/**
+ * As component_measureItem, for a channel carrying traces.
+ * @param[in] item Address of the Trace_PNTR carried by the channel
+ * @return Bytes the traced object flattens to, or 0 if it can't be flattened
+ */
+static size_t component_measureTracedItem(void* item) {
+    return TypedObject_encode((*(Trace_PNTR*)item)->message, NULL, 0);
+}
+
 void component_component(Component_PNTR this) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "COMPONENT");
@@ -316,8 +479,43 @@ void component_component(Component_PNTR this) {
 #ifdef DEBUGGINGENABLED
             log_logMessage(DEBUG, this->name, "     Channel %d: %s", j, channel_name);
 #endif
-            Channel_PNTR new_channel = channel_create(channel_direction, TypedObject_getSize(channel_type));
-            ChannelWrapper_PNTR channelWrapper = GC_alloc(sizeof(ChannelWrapper_s), false);
+            Channel_PNTR new_channel = channel_createReference(channel_direction);
+            size_t segmentSize;
+            char* segment = ChannelConfig_getSegment(this->name, channel_name, &segmentSize);
+            unsigned int capacity = ChannelConfig_getCapacity(this->name, channel_name);
+            char* local;
+            char* peer;
+            unsigned int window;
+            if(segment != NULL) {
+                if(!SharedChannel_attach(new_channel, segment, segmentSize)) {
+                    log_logMessage(WARNING, this->name, "Channel %s can't be shared through %s, it will stay local", channel_name, segment);
+                } else if(capacity > 0) {
+                    log_logMessage(WARNING, this->name, "Channel %s is shared, so its buffer setting is ignored", channel_name);
+                    capacity = 0;
+                }
+                GC_decRef(segment);
+            } else if(ChannelConfig_getRemote(this->name, channel_name, &local, &peer, &window)) {
+                if(!NetChannel_attach(new_channel, local, peer, window)) {
+                    log_logMessage(WARNING, this->name, "Channel %s can't be connected through %s, it will stay local", channel_name, local);
+                } else if(capacity > 0) {
+                    log_logMessage(WARNING, this->name, "Channel %s is remote, so its buffer setting is ignored", channel_name);
+                    capacity = 0;
+                }
+                GC_decRef(local);
+                if(peer != NULL) {
+                    GC_decRef(peer);
+                }
+            }
+            if(capacity > 0 && !channel_setCapacity(new_channel, capacity)) {
+                log_logMessage(WARNING, this->name, "Channel %s can't be buffered, it will stay synchronous", channel_name);
+            }
+            if(channel_stats_isEnabled()) {
+                channel_setLabel(new_channel, this->name, channel_name,
+                                 component_isTraced(new_channel) ? component_measureTracedItem : component_measureItem);
+            }
+            ChannelWrapper_PNTR channelWrapper = GC_allocType(sizeof(ChannelWrapper_s), true, "ChannelWrapper");
+            channelWrapper->decRef = ChannelWrapper_decRef;
+            GC_registerChildren((decRefFunc_t) ChannelWrapper_decRef, ChannelWrapper_children);
             channelWrapper->channel = new_channel;
             channelWrapper->type = channel_type;
             ListMap_declare(this->channels, channel_name);
@@ -325,6 +523,7 @@ void component_component(Component_PNTR this) {
                 log_logMessage(FATAL, this->name, "Channel List refused to store the channel for an unknown reason.");
                 component_cleanUpAndStop(this, NULL);
             };
+            GC_decRef(channelWrapper);
             GC_decRef(channel_name);
         }
     }
@@ -353,13 +552,14 @@ Component_PNTR component_call(Component_PNTR this) {
     char* sourceFile = Component_getSourceFile(name);
     char* filePath = getFilePath(sourceFile);
     Component_PNTR newComponent = component_newComponent(name, filePath, paramsList);
+    // Take this component's reference before the new one starts, as it may run to completion and drop its own first
+    TypedObject_PNTR newObject = TypedObject_construct(BYTECODE_TYPE_COMPONENT, newComponent);
     Component_create(newComponent);
 
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "    Component %s is at address %p", name, newComponent);
 #endif
 
-    TypedObject_PNTR newObject = TypedObject_construct(BYTECODE_TYPE_COMPONENT, newComponent);
     Stack_push(this->dataStack, newObject);
 
     if(this->waitComponents == NULL) {
@@ -525,6 +725,25 @@ void component_load(Component_PNTR this) {
     GC_decRef(name);
 }
 
+/**
+ * Make the result of an expression, in place of one of its operands if nothing else holds it (see
+ * TypedObject_reuseScalar), or else as TypedObject_constructScalar does.
+ *
+ * @param[in] first The first operand, whose reference the caller still holds
+ * @param[in] second The second operand, likewise, or NULL if there is only one
+ * @param[in] type The type of the result
+ * @param[in] value The result
+ * @return The result, with a reference for the caller.
+ */
+static TypedObject_PNTR component_result(TypedObject_PNTR first, TypedObject_PNTR second, unsigned int type,
+                                         const void* value) {
+    TypedObject_PNTR result = TypedObject_reuseScalar(first, type, value);
+    if(result == NULL && second != NULL) {
+        result = TypedObject_reuseScalar(second, type, value);
+    }
+    return result != NULL ? result : TypedObject_constructScalar(type, value);
+}
+
 void component_expression(Component_PNTR this, int bytecode_op) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "EXPRESSION %u", bytecode_op);
@@ -572,17 +791,17 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
         if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_REAL || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_REAL) {
-            result = TypedObject_construct(BYTECODE_TYPE_REAL, GC_alloc(sizeof(double), false));
-            *(double*)TypedObject_getObject(result) = castFirst + castSecond;
+            double value = castFirst + castSecond;
+            result = component_result(first, second, BYTECODE_TYPE_REAL, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_UNSIGNED_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_UNSIGNED_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_UNSIGNED_INTEGER, GC_alloc(sizeof(unsigned int), false));
-            *(unsigned int*)TypedObject_getObject(result) = (unsigned int)(castFirst + castSecond);
+            unsigned int value = (unsigned int)(castFirst + castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_UNSIGNED_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_INTEGER, GC_alloc(sizeof(int), false));
-            *(int*)TypedObject_getObject(result) = (int)(castFirst + castSecond);
+            int value = (int)(castFirst + castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_BYTE || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_BYTE) {
-            result = TypedObject_construct(BYTECODE_TYPE_BYTE, GC_alloc(sizeof(char), false));
-            *(char*)TypedObject_getObject(result) = (char)(castFirst + castSecond);
+            char value = (char)(castFirst + castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_BYTE, &value);
         }
     } else if(bytecode_op == BYTECODE_SUB) {
 #ifdef DEBUGGINGENABLED
@@ -593,17 +812,17 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
         if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_REAL || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_REAL) {
-            result = TypedObject_construct(BYTECODE_TYPE_REAL, GC_alloc(sizeof(double), false));
-            *(double*)TypedObject_getObject(result) = castFirst - castSecond;
+            double value = castFirst - castSecond;
+            result = component_result(first, second, BYTECODE_TYPE_REAL, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_UNSIGNED_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_UNSIGNED_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_UNSIGNED_INTEGER, GC_alloc(sizeof(unsigned int), false));
-            *(unsigned int*)TypedObject_getObject(result) = (unsigned int)(castFirst - castSecond);
+            unsigned int value = (unsigned int)(castFirst - castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_UNSIGNED_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_INTEGER, GC_alloc(sizeof(int), false));
-            *(int*)TypedObject_getObject(result) = (int)(castFirst - castSecond);
+            int value = (int)(castFirst - castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_BYTE || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_BYTE) {
-            result = TypedObject_construct(BYTECODE_TYPE_BYTE, GC_alloc(sizeof(char), false));
-            *(char*)TypedObject_getObject(result) = (char)(castFirst - castSecond);
+            char value = (char)(castFirst - castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_BYTE, &value);
         }
     } else if(bytecode_op == BYTECODE_MUL) {
 #ifdef DEBUGGINGENABLED
@@ -614,17 +833,17 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
         if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_REAL || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_REAL) {
-            result = TypedObject_construct(BYTECODE_TYPE_REAL, GC_alloc(sizeof(double), false));
-            *(double*)TypedObject_getObject(result) = castFirst * castSecond;
+            double value = castFirst * castSecond;
+            result = component_result(first, second, BYTECODE_TYPE_REAL, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_UNSIGNED_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_UNSIGNED_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_UNSIGNED_INTEGER, GC_alloc(sizeof(unsigned int), false));
-            *(unsigned int*)TypedObject_getObject(result) = (unsigned int)(castFirst * castSecond);
+            unsigned int value = (unsigned int)(castFirst * castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_UNSIGNED_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_INTEGER, GC_alloc(sizeof(int), false));
-            *(int*)TypedObject_getObject(result) = (int)(castFirst * castSecond);
+            int value = (int)(castFirst * castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_BYTE || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_BYTE) {
-            result = TypedObject_construct(BYTECODE_TYPE_BYTE, GC_alloc(sizeof(char), false));
-            *(char*)TypedObject_getObject(result) = (char)(castFirst * castSecond);
+            char value = (char)(castFirst * castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_BYTE, &value);
         }
     } else if(bytecode_op == BYTECODE_DIV) {
 #ifdef DEBUGGINGENABLED
@@ -635,17 +854,17 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
         if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_REAL || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_REAL) {
-            result = TypedObject_construct(BYTECODE_TYPE_REAL, GC_alloc(sizeof(double), false));
-            *(double*)TypedObject_getObject(result) = castFirst / castSecond;
+            double value = castFirst / castSecond;
+            result = component_result(first, second, BYTECODE_TYPE_REAL, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_UNSIGNED_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_UNSIGNED_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_UNSIGNED_INTEGER, GC_alloc(sizeof(unsigned int), false));
-            *(unsigned int*)TypedObject_getObject(result) = (unsigned int)(castFirst / castSecond);
+            unsigned int value = (unsigned int)(castFirst / castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_UNSIGNED_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_INTEGER, GC_alloc(sizeof(int), false));
-            *(int*)TypedObject_getObject(result) = (int)(castFirst / castSecond);
+            int value = (int)(castFirst / castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_BYTE || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_BYTE) {
-            result = TypedObject_construct(BYTECODE_TYPE_BYTE, GC_alloc(sizeof(char), false));
-            *(char*)TypedObject_getObject(result) = (char)(castFirst / castSecond);
+            char value = (char)(castFirst / castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_BYTE, &value);
         }
     } else if(bytecode_op == BYTECODE_MOD) {
 #ifdef DEBUGGINGENABLED
@@ -660,14 +879,14 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             log_logMessage(FATAL, this->name, "Syntax error in EXPR %u - Operand Type Mismatched", bytecode_op);
             component_cleanUpAndStop(this, NULL);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_UNSIGNED_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_UNSIGNED_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_UNSIGNED_INTEGER, GC_alloc(sizeof(unsigned int), false));
-            *(unsigned int*)TypedObject_getObject(result) = (unsigned int)((int)castFirst % (int)castSecond);
+            unsigned int value = (unsigned int)((int)castFirst % (int)castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_UNSIGNED_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_INTEGER || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_INTEGER) {
-            result = TypedObject_construct(BYTECODE_TYPE_INTEGER, GC_alloc(sizeof(int), false));
-            *(int*)TypedObject_getObject(result) = (int)((int)castFirst % (int)castSecond);
+            int value = (int)((int)castFirst % (int)castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_INTEGER, &value);
         } else if(TypedObject_getTypeByteCode(first) == BYTECODE_TYPE_BYTE || TypedObject_getTypeByteCode(second) == BYTECODE_TYPE_BYTE) {
-            result = TypedObject_construct(BYTECODE_TYPE_BYTE, GC_alloc(sizeof(char), false));
-            *(char*)TypedObject_getObject(result) = (char)((int)castFirst % (int)castSecond);
+            char value = (char)((int)castFirst % (int)castSecond);
+            result = component_result(first, second, BYTECODE_TYPE_BYTE, &value);
         }
     } else if(bytecode_op == BYTECODE_AND) {
 #ifdef DEBUGGINGENABLED
@@ -678,8 +897,8 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
 
-        result = TypedObject_construct(BYTECODE_TYPE_BOOL, GC_alloc(sizeof(bool), false));
-        *(bool*)TypedObject_getObject(result) = *(bool*)TypedObject_getObject(first) && *(bool*)TypedObject_getObject(second);
+        bool value = *(bool*)TypedObject_getObject(first) && *(bool*)TypedObject_getObject(second);
+        result = component_result(first, second, BYTECODE_TYPE_BOOL, &value);
     } else if (bytecode_op == BYTECODE_OR) {
 #ifdef DEBUGGINGENABLED
         log_logMessage(DEBUG, this->name, "    OE");
@@ -689,8 +908,8 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
 
-        result = TypedObject_construct(BYTECODE_TYPE_BOOL, GC_alloc(sizeof(bool), false));
-        *(bool*)TypedObject_getObject(result) = *(bool*)TypedObject_getObject(first) || *(bool*)TypedObject_getObject(second);
+        bool value = *(bool*)TypedObject_getObject(first) || *(bool*)TypedObject_getObject(second);
+        result = component_result(first, second, BYTECODE_TYPE_BOOL, &value);
     } else if(bytecode_op == BYTECODE_LESS || bytecode_op == BYTECODE_LESSEQUAL || bytecode_op == BYTECODE_EQUAL
             || bytecode_op == BYTECODE_MOREEQUAL || bytecode_op == BYTECODE_MORE || bytecode_op == BYTECODE_UNEQUAL) {
 #ifdef DEBUGGINGENABLED
@@ -701,20 +920,21 @@ void component_expression(Component_PNTR this, int bytecode_op) {
             component_cleanUpAndStop(this, NULL);
         }
 
-        result = TypedObject_construct(BYTECODE_TYPE_BOOL, GC_alloc(sizeof(bool), false));
+        bool value = false;
         if(bytecode_op == BYTECODE_LESS) {
-            *(bool*)TypedObject_getObject(result) = castFirst < castSecond;
+            value = castFirst < castSecond;
         } else if(bytecode_op == BYTECODE_LESSEQUAL) {
-            *(bool*)TypedObject_getObject(result) = castFirst <= castSecond;
+            value = castFirst <= castSecond;
         } else if(bytecode_op == BYTECODE_EQUAL) {
-            *(bool*)TypedObject_getObject(result) = castFirst == castSecond;
+            value = castFirst == castSecond;
         } else if(bytecode_op == BYTECODE_MOREEQUAL) {
-            *(bool*)TypedObject_getObject(result) = castFirst >= castSecond;
+            value = castFirst >= castSecond;
         } else if (bytecode_op == BYTECODE_MORE) {
-            *(bool*)TypedObject_getObject(result) = castFirst > castSecond;
+            value = castFirst > castSecond;
         } else if(bytecode_op == BYTECODE_UNEQUAL) {
-            *(bool*)TypedObject_getObject(result) = castFirst != castSecond;
+            value = castFirst != castSecond;
         }
+        result = component_result(first, second, BYTECODE_TYPE_BOOL, &value);
     }
 
 #ifdef DEBUGGINGENABLED
@@ -742,9 +962,10 @@ void component_not(Component_PNTR this) {
         component_cleanUpAndStop(this, NULL);
     }
 
-    bool* object = TypedObject_getObject(first);
-    *object = !(*object);
-    Stack_push(this->dataStack, first);
+    bool value = !*(bool*)TypedObject_getObject(first);
+    TypedObject_PNTR result = component_result(first, NULL, BYTECODE_TYPE_BOOL, &value);
+    GC_decRef(first);
+    Stack_push(this->dataStack, result);
 }
 
 void component_stop(Component_PNTR this) {
@@ -771,6 +992,12 @@ void component_behaviourJump(Component_PNTR this) {
     log_logMessage(DEBUG, this->name, "BEHAVIOUR JUMP");
 #endif
 
+    component_flushChannels(this);
+    if(Trace_isEnabled()) {
+        component_traceIterationEnd(this);
+    }
+    //Between iterations is a safe point to collect cycles: nothing is locked, and nothing half built.
+    GC_cycles_poll();
     if(this->stop) {
         GC_decRef(component_readData(this));
     } else {
@@ -863,6 +1090,7 @@ void component_connect(Component_PNTR this) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "CONNECT");
 #endif
+    component_flushChannels(this);
     component_load(this);
     TypedObject_PNTR component1 = Stack_pop(this->dataStack);
 
@@ -932,6 +1160,7 @@ void component_disconnect(Component_PNTR this) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "DISCONNECT");
 #endif
+    component_flushChannels(this);
 
     component_load(this);
     TypedObject_PNTR component1 = Stack_pop(this->dataStack);
@@ -959,6 +1188,41 @@ void component_disconnect(Component_PNTR this) {
     GC_decRef(name1);
 }
 
+/**
+ * Send everything staged on an OUT channel, in one batch.
+ * @param[in] this Component which staged the sends
+ * @param[in] channel Channel to flush
+ */
+static void component_flushChannel(Component_PNTR this, ChannelWrapper_PNTR channel) {
+    //An IN channel's batch holds receives, which are the component's, not sends.
+    if(channel->channel->direction != CHAN_OUT || channel->stagedCount == 0) {
+        return;
+    }
+#ifdef DEBUGGINGENABLED
+    log_logMessage(DEBUG, this->name, "    Flushing %u staged sends", channel->stagedCount);
+#endif
+    channel_send_n(channel->channel, channel->batch, channel->stagedCount, NULL);
+    channel->stagedCount = 0;
+    this->stagedChannels--;
+}
+
+/**
+ * Send everything staged on any of this component's channels.
+ * Called before anything that might wait, and at the end of each behaviour, so staging never holds data back from a
+ * receiver for longer than one pass of a loop.
+ * @param[in] this Component to flush
+ */
+void component_flushChannels(Component_PNTR this) {
+    unsigned int length = IteratedList_getListLength(this->channels);
+    IteratedList_rewind(this->channels);
+    for(unsigned int i = 0; this->stagedChannels > 0 && i < length; i++) {
+        ListMapEntry_PNTR entry = IteratedList_getNextElement(this->channels);
+        if(entry->value != NULL) {
+            component_flushChannel(this, entry->value);
+        }
+    }
+}
+
 void component_send(Component_PNTR this) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "SEND");
@@ -975,13 +1239,32 @@ void component_send(Component_PNTR this) {
         component_cleanUpAndStop(this, NULL);
     }
 
-    TypedObject_PNTR poppedData = Stack_pop(this->dataStack);
-    channel_send(channel1->channel, TypedObject_getObject(poppedData), NULL);
+    //Our reference to the popped object moves to the receiver, so it isn't decRef'd here.
+    void* poppedData = Stack_pop(this->dataStack);
 #ifdef DEBUGGINGENABLED
-    log_logMessage(DEBUG, this->name, "    Sent object of type %d (loc: %p) on %s", TypedObject_getTypeByteCode(poppedData), TypedObject_getObject(poppedData), name1);
+    log_logMessage(DEBUG, this->name, "    Sending object of type %d (loc: %p) on %s", TypedObject_getTypeByteCode(poppedData), TypedObject_getObject(poppedData), name1);
 #endif
+    if(component_isTraced(channel1->channel)) {
+        poppedData = component_traceSend(this, poppedData);
+    }
+    if(channel_isBuffered(channel1->channel)) {
+        //A buffered send doesn't wait for the receiver anyway, so stage it and send a loop's worth in one batch.
+        if(channel1->batch == NULL) {
+            channel1->batch = GC_alloc(CHANNEL_WRAPPER_BATCH * sizeof(TypedObject_PNTR), false);
+        }
+        if(channel1->stagedCount == 0) {
+            this->stagedChannels++;
+        }
+        channel1->batch[channel1->stagedCount++] = poppedData;
+        if(channel1->stagedCount == CHANNEL_WRAPPER_BATCH) {
+            component_flushChannel(this, channel1);
+        }
+    } else {
+        //Anything staged earlier must reach its receiver before this send completes.
+        component_flushChannels(this);
+        channel_send(channel1->channel, &poppedData, NULL);
+    }
 
-    //GC_decRef(poppedData);
     GC_decRef(name1);
 }
 
@@ -993,11 +1276,28 @@ void component_receive(Component_PNTR this) {
     char *name1 = component_readString(this);
     ChannelWrapper_PNTR channel1 = ListMap_get(this->channels, name1);
 
-    TypedObject_PNTR receivedWrapper = TypedObject_construct(channel1->type, NULL);
-    void* receivedData = GC_alloc(TypedObject_getSize(channel1->type), false);
-    TypedObject_setObject(receivedWrapper, receivedData);
-
-    channel_receive(channel1->channel, receivedData, false);
+    //Takes over the sender's reference to the object, which the stack now owns.
+    TypedObject_PNTR receivedWrapper = NULL;
+    if(channel1->prefetchedNext < channel1->prefetchedCount) {
+        receivedWrapper = channel1->batch[channel1->prefetchedNext++];
+    } else {
+        //We may be about to wait, so senders waiting on us must be able to see what we've sent.
+        component_flushChannels(this);
+        if(channel_isBuffered(channel1->channel)) {
+            //Collect everything already buffered in one go; later receives are served from the batch.
+            if(channel1->batch == NULL) {
+                channel1->batch = GC_alloc(CHANNEL_WRAPPER_BATCH * sizeof(TypedObject_PNTR), false);
+            }
+            channel1->prefetchedCount = channel_receive_n(channel1->channel, channel1->batch, CHANNEL_WRAPPER_BATCH);
+            channel1->prefetchedNext = 1;
+            receivedWrapper = channel1->batch[0];
+        } else {
+            channel_receive(channel1->channel, &receivedWrapper, false);
+        }
+    }
+    if(component_isTraced(channel1->channel)) {
+        receivedWrapper = component_traceReceive(this, (Trace_PNTR)receivedWrapper);
+    }
     Stack_push(this->dataStack, receivedWrapper);
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "    Received object of type %d (loc: %p) on %s", TypedObject_getTypeByteCode(receivedWrapper), TypedObject_getObject(receivedWrapper), name1);
@@ -1006,6 +1306,107 @@ void component_receive(Component_PNTR this) {
     GC_decRef(name1);
 }
 
+/**
+ * Push a bool saying whether a channel operation completed.
+ * @param[in] this Component to push onto
+ * @param[in] value Whether it did
+ */
+static void component_pushResult(Component_PNTR this, bool value) {
+    Stack_push(this->dataStack, TypedObject_constructScalar(BYTECODE_TYPE_BOOL, &value));
+}
+
+void component_trySend(Component_PNTR this) {
+#ifdef DEBUGGINGENABLED
+    log_logMessage(DEBUG, this->name, "TRY SEND");
+#endif
+
+    char *name1 = component_readString(this);
+    ChannelWrapper_PNTR channel1 = ListMap_get(this->channels, name1);
+
+    if(channel1 == NULL) {
+        log_logMessage(FATAL, this->name, "Error in TRY SEND - couldn't find channel named %s", name1);
+        component_cleanUpAndStop(this, NULL);
+    }
+
+    //Whether staged sends would have gone through can't be known, so send them first and try this one on its own.
+    component_flushChannels(this);
+
+    void* poppedData = Stack_pop(this->dataStack);
+    bool traceSent = this->traceSent;
+    if(component_isTraced(channel1->channel)) {
+        poppedData = component_traceSend(this, poppedData);
+    }
+    bool sent = channel_try_send(channel1->channel, &poppedData);
+    if(!sent) {
+        //Nobody took our reference, so the object is dropped along with it.
+        this->traceSent = traceSent;
+        GC_decRef(poppedData);
+    }
+#ifdef DEBUGGINGENABLED
+    log_logMessage(DEBUG, this->name, "    %s on %s", sent ? "Sent" : "Nobody ready", name1);
+#endif
+    component_pushResult(this, sent);
+
+    GC_decRef(name1);
+}
+
+/**
+ * Receive from a channel only if something is waiting there, or (if timed) arrives within the number of ms popped
+ * from the stack. Pushes what was received, if anything, then whether something was.
+ * @param[in] this Component receiving
+ * @param[in] timed Whether to wait for a timeout
+ */
+void component_tryReceive(Component_PNTR this, bool timed) {
+#ifdef DEBUGGINGENABLED
+    log_logMessage(DEBUG, this->name, timed ? "RECEIVE TIMEOUT" : "TRY RECEIVE");
+#endif
+
+    char *name1 = component_readString(this);
+    ChannelWrapper_PNTR channel1 = ListMap_get(this->channels, name1);
+
+    if(channel1 == NULL) {
+        log_logMessage(FATAL, this->name, "Error in TRY RECEIVE - couldn't find channel named %s", name1);
+        component_cleanUpAndStop(this, NULL);
+    }
+
+    struct timespec deadline;
+    if(timed) {
+        TypedObject_PNTR timeout = Stack_pop(this->dataStack);
+        if(TypedObject_getTypeByteCode(timeout) != BYTECODE_TYPE_INTEGER) {
+            log_logMessage(FATAL, this->name, "Syntax error in RECEIVE TIMEOUT - integer number of ms expected");
+            component_cleanUpAndStop(this, NULL);
+        }
+        int ms = *(int*)TypedObject_getObject(timeout);
+        GC_decRef(timeout);
+
+        channel_deadlineAfter(&deadline, ms > 0 ? (unsigned int)ms : 0);
+        //We may be about to wait, so senders waiting on us must be able to see what we've sent.
+        component_flushChannels(this);
+    }
+
+    TypedObject_PNTR receivedWrapper = NULL;
+    bool received = true;
+    if(channel1->prefetchedNext < channel1->prefetchedCount) {
+        receivedWrapper = channel1->batch[channel1->prefetchedNext++];
+    } else if(timed) {
+        received = channel_receive_until(channel1->channel, &receivedWrapper, &deadline);
+    } else {
+        received = channel_try_receive(channel1->channel, &receivedWrapper);
+    }
+    if(received) {
+        if(component_isTraced(channel1->channel)) {
+            receivedWrapper = component_traceReceive(this, (Trace_PNTR)receivedWrapper);
+        }
+        Stack_push(this->dataStack, receivedWrapper);
+    }
+#ifdef DEBUGGINGENABLED
+    log_logMessage(DEBUG, this->name, "    %s on %s", received ? "Received" : "Nothing waiting", name1);
+#endif
+    component_pushResult(this, received);
+
+    GC_decRef(name1);
+}
+
 void component_proc(Component_PNTR this) {
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "PROC DECL");
@@ -1116,6 +1517,7 @@ void component_procCall(Component_PNTR this) {
             log_logMessage(DEBUG, this->name, "     Seeking to byte %ld", Procedure_getPosition(proc));
 #endif
             this->sourceFile = mainComponent->sourceFile;
+            this->image = mainComponent->image;
             fseek(this->sourceFile, Procedure_getPosition(proc), SEEK_SET);
         } else {
             //Not in this component or global, try std fns
@@ -1158,6 +1560,7 @@ void component_procReturn(Component_PNTR this) {
         log_logMessage(DEBUG, this->name, "    Jumping back to file at %p", newFile);
 #endif
         this->sourceFile = *newFile;
+        this->image = component_imageOf(this->name);
     }
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, this->name, "    Seeking to byte %ld", *newPos);
@@ -1355,7 +1758,7 @@ char* component_readString(Component_PNTR this) {
     //Rewind(+1 for \0)
     fseek(this->sourceFile, startPos, SEEK_SET);
 
-    char* string = GC_alloc((size_t) (numChars+1), false);
+    char* string = GC_allocType((size_t) (numChars+1), false, "string");
 
     numChars = 0;
     escapeChar = false;
@@ -1383,39 +1786,133 @@ char* component_readString(Component_PNTR this) {
     return string;
 }
 
+/**
+ * Find the image of a component's bytecode file, adding it if it is new.
+ *
+ * @param[in] name The component's name, which its file is named after
+ * @return The image's position in component_images + 1, or 0 if there is no room for it.
+ */
+static unsigned int component_imageOf(const char* name) {
+    pthread_mutex_lock(&component_literalsLock);
+    unsigned int image = 0;
+    for(unsigned int i = 0; i < component_imageCount && image == 0; i++) {
+        if(!strcmp(component_images[i], name)) {
+            image = i + 1;
+        }
+    }
+    if(image == 0 && component_imageCount < COMPONENT_IMAGES) {
+        component_images[component_imageCount] = malloc(strlen(name) + 1);
+        if(component_images[component_imageCount] != NULL) {
+            strcpy(component_images[component_imageCount], name);
+            image = ++component_imageCount;
+        }
+    }
+    pthread_mutex_unlock(&component_literalsLock);
+    return image;
+}
+
+// Slot in component_literals holding the literal at an offset in an image, or the empty one it would go in.
+static struct component_literal* component_findLiteral(unsigned int image, long offset) {
+    unsigned int slot = ((unsigned int) offset * 2654435761u + image) & (COMPONENT_LITERALS - 1);
+    for(;;) {
+        struct component_literal* literal = &component_literals[slot];
+        //Acquire, so the rest of the literal is seen as it was set.
+        if(atomic_load_explicit(&(literal->value), memory_order_acquire) == NULL ||
+           (literal->image == image && literal->offset == offset)) {
+            return literal;
+        }
+        slot = (slot + 1) & (COMPONENT_LITERALS - 1);
+    }
+}
+
+/**
+ * Keep a literal just read for the component's image, unless it is full.
+ *
+ * @param[in] offset Where the literal starts
+ * @param[in] type Its type
+ * @param[in] value Its value, which is copied
+ * @param[in] size The size of its value
+ * @return The literal kept, or NULL.
+ */
+static TypedObject_PNTR component_keepLiteral(Component_PNTR this, long offset, unsigned int type, const void* value,
+                                              size_t size) {
+    TypedObject_PNTR kept = NULL;
+    pthread_mutex_lock(&component_literalsLock);
+    struct component_literal* literal = component_findLiteral(this->image, offset);
+    kept = atomic_load_explicit(&(literal->value), memory_order_relaxed);
+    if(kept == NULL && component_literalCount < COMPONENT_LITERALS / 4 * 3) {
+        if(type == BYTECODE_TYPE_STRING) {
+            kept = TypedObject_constructImmortal(type, value, size);
+        } else {
+            kept = TypedObject_constructScalar(type, value);
+            if(GC_getRef(kept) != UINT_MAX) {
+                GC_decRef(kept);    //Too big to be shared already.
+                kept = TypedObject_constructImmortal(type, value, size);
+            }
+        }
+        literal->image = this->image;
+        literal->offset = offset;
+        literal->end = ftell(this->sourceFile);
+        atomic_store_explicit(&(literal->value), kept, memory_order_release);
+        component_literalCount++;
+    }
+    pthread_mutex_unlock(&component_literalsLock);
+    return kept;
+}
+
 TypedObject_PNTR component_readData(Component_PNTR this) {
+    long offset = 0;
+    if(this->image != 0) {
+        offset = ftell(this->sourceFile);
+        struct component_literal* literal = component_findLiteral(this->image, offset);
+        TypedObject_PNTR kept = atomic_load_explicit(&(literal->value), memory_order_acquire);
+        if(kept != NULL) {
+            fseek(this->sourceFile, literal->end, SEEK_SET);
+            return kept;
+        }
+    }
+
     int type = fgetc(this->sourceFile);
     switch(type) {
         case BYTECODE_TYPE_INTEGER:
-            return TypedObject_construct(BYTECODE_TYPE_INTEGER,
-                                         component_readNBytes(this, TypedObject_getSize(BYTECODE_TYPE_INTEGER)));
         case BYTECODE_TYPE_UNSIGNED_INTEGER:
-            return TypedObject_construct(BYTECODE_TYPE_UNSIGNED_INTEGER,
-                                         component_readNBytes(this, TypedObject_getSize(BYTECODE_TYPE_UNSIGNED_INTEGER)));
         case BYTECODE_TYPE_REAL:
-            return TypedObject_construct(BYTECODE_TYPE_REAL,
-                                         component_readNBytes(this, TypedObject_getSize(BYTECODE_TYPE_REAL)));
         case BYTECODE_TYPE_BOOL:
-            return TypedObject_construct(BYTECODE_TYPE_BOOL,
-                                         component_readNBytes(this, TypedObject_getSize(BYTECODE_TYPE_BOOL)));
-        case BYTECODE_TYPE_BYTE:
-            return TypedObject_construct(BYTECODE_TYPE_BYTE,
-                                         component_readNBytes(this, TypedObject_getSize(BYTECODE_TYPE_BYTE)));
-        case BYTECODE_TYPE_STRING:
+        case BYTECODE_TYPE_BYTE: {
+            uint64_t value = 0;
+            component_readBytes(this, &value, TypedObject_getSize(type));
+            TypedObject_PNTR kept = this->image != 0 ?
+                    component_keepLiteral(this, offset, type, &value, TypedObject_getSize(type)) : NULL;
+            return kept != NULL ? kept : TypedObject_constructScalar(type, &value);
+        }
+        case BYTECODE_TYPE_STRING: {
             fseek(this->sourceFile, -1, SEEK_CUR); //Rewind for the TYPE byte
-            return TypedObject_construct(BYTECODE_TYPE_STRING, component_readString(this));
+            char* string = component_readString(this);
+            TypedObject_PNTR kept = this->image != 0 ?
+                    component_keepLiteral(this, offset, type, string, strlen(string) + 1) : NULL;
+            if(kept == NULL) {
+                kept = TypedObject_construct(BYTECODE_TYPE_STRING, string);
+            }
+            GC_decRef(string);
+            return kept;
+        }
         default:
             log_logMessage(ERROR, this->name, "Unrecognised type - %d", type);
             return NULL;
     }
 }
 
-void* component_readNBytes(Component_PNTR this, size_t nBytes) {
-    char* result = GC_alloc(nBytes, false);
+// Read nBytes of a big-endian value into result.
+static void component_readBytes(Component_PNTR this, void* result, size_t nBytes) {
     for(unsigned int i = 1; i <= nBytes; i++) {
         int nextChar = fgetc(this->sourceFile);
-        result[nBytes-i] = (char)nextChar;
+        ((char*) result)[nBytes-i] = (char)nextChar;
     }
+}
+
+void* component_readNBytes(Component_PNTR this, size_t nBytes) {
+    char* result = GC_alloc(nBytes, false);
+    component_readBytes(this, result, nBytes);
     return result;
 }
 
@@ -1490,6 +1987,11 @@ int component_skipToNext(Component_PNTR this, int bytecode) {
             case BYTECODE_RECEIVE:
                 GC_decRef(component_readString(this));	// CHANNEL_NAME
                 break;
+            case BYTECODE_TRY_SEND:
+            case BYTECODE_TRY_RECEIVE:
+            case BYTECODE_RECEIVE_TIMEOUT:
+                GC_decRef(component_readString(this));	// CHANNEL_NAME
+                break;
             case BYTECODE_PROC:
                 GC_decRef(component_readString(this));          // PROC_NAME
                 parameters = fgetc(this->sourceFile);			// NUMBER_OF_PARAMETERS
@@ -1570,11 +2072,43 @@ static void Component_decRef(Component_PNTR this) {
         GC_decRef(this->parameters);
     }
     log_logMessage(DEBUG, this->name, "   Cleaning Scope Stack [3/6]");
-    GC_decRef(this->scopeStack);
+    if(this->scopeStack != NULL) {
+        GC_decRef(this->scopeStack);
+    }
     log_logMessage(DEBUG, this->name, "   Cleaning Data Stack [4/6]");
-    GC_decRef(this->dataStack);
+    if(this->dataStack != NULL) {
+        GC_decRef(this->dataStack);
+    }
     log_logMessage(DEBUG, this->name, "   Cleaning Channels [5/6]");
     GC_decRef(this->channels);
     log_logMessage(DEBUG, this->name, "   Cleaning Name [6/6]");
     GC_decRef(this->name);
 }
+
+// For the cycle collector. Only what the component's creator set up is visited: its stacks and wait list change as it
+// runs, on its own thread, and it drops them itself when it stops.
+static void Component_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    Component_PNTR this = pntr;
+    visit(this->parameters, context);
+    visit(this->channels, context);
+}
+
+// decRef function is called when ref count to a ChannelWrapper object is zero: drops the channel, and anything staged
+// on it or prefetched from it that the component never got round to.
+static void ChannelWrapper_decRef(ChannelWrapper_PNTR this) {
+    if(this->batch != NULL) {
+        for(unsigned int i = 0; i < this->stagedCount; i++) {
+            GC_decRef(this->batch[i]);
+        }
+        for(unsigned int i = this->prefetchedNext; i < this->prefetchedCount; i++) {
+            GC_decRef(this->batch[i]);
+        }
+        GC_decRef(this->batch);
+    }
+    GC_decRef(this->channel);
+}
+
+// For the cycle collector. The batch is left out, as its component may be sending from it.
+static void ChannelWrapper_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    visit(((ChannelWrapper_PNTR) pntr)->channel, context);
+}
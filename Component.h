@@ -28,6 +28,7 @@
 #ifndef CVM_COMPONENT_H
 #define CVM_COMPONENT_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <libgen.h>
 #include <string.h>
@@ -51,16 +52,24 @@ struct Component {
     void (*decRef)(Component_PNTR component); //!< A pointer to the garbage collection function. Automatically set by constructor.
     char* name;                               //!< Pointer to a char* with the Component's friendly name.
     FILE* sourceFile;                         //!< Pointer to a file object with this component's bytecode source.
+    unsigned int image;                       //!< Which bytecode sourceFile holds, for the literals kept from it (see component_readData), or 0 if none are.
     IteratedList_PNTR parameters;             //!< A list of parameters passed into this component.
     ScopeStack_PNTR scopeStack;               //!< The scope stack, where local variables are stored.
     Stack_PNTR dataStack;                     //!< The data stack, where date being operated on is stored.
     Stack_PNTR waitComponents;                //!< Identifiers/Pointers to components started by this component, that must be waited on before this Component may terminate.
     ListMap_PNTR channels;                    //!< List of channels used for inter-component communication.
+    unsigned int stagedChannels;              //!< Number of channels holding staged sends, see component_send.
     ListMap_PNTR procs;                       //!< List of procedures and their byte positions in this component.
+    GC_arena_PNTR arena;                      //!< Heap for what this component allocates as it runs, released when it stops.
     bool stop;                                //!< If true, Component will terminate on next instruction.
     bool running;                             //!< Certain operations require the component to be fully initialised. True on this flag indicates this status.
     bool inProject;                           //!< Project blocks need skipping out of at the end, so this marks if a project block is being executed.
     pthread_t threadId;                       //!< On Unix, the thread ID that this component is running in.
+    uint64_t traceOrigin;                     //!< When tracing, origin of the oldest traced object received this behaviour iteration, or 0.
+    unsigned int tracePath;                   //!< When tracing, the path that object came along.
+    bool traceSent;                           //!< When tracing, whether this behaviour iteration has sent anything.
+    unsigned int traceFrom;                   //!< Path last extended with this component, see component_tracePath.
+    unsigned int traceTo;                     //!< The path it was extended to.
 };
 
 /**
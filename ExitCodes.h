@@ -30,5 +30,7 @@ static const int EXITCODE_SUCCESS = 0;
 static const int EXITCODE_INVALID_ARGUMENTS = -1;
 static const int EXITCODE_UNKNOWN_LOG_LEVEL = -2;
 static const int EXITCODE_SYNTAX_ERROR = -3;
+static const int EXITCODE_INVALID_CONFIG = -4;
+static const int EXITCODE_OUT_OF_MEMORY = -5;
 
 #endif //CVM_EXITCODES_H
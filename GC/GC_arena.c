@@ -0,0 +1,320 @@
+/*
+ * @file GC_arena.c
+ *
+ * Arenas: heaps owned by one thread at a time, such as a component's.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GC_arena.h"
+#include "GC_slab.h"
+
+// Flags on a slab's state once its arena has been released, and if it is shared (never freed, and its freed blocks
+// reused by every arena); the rest of the state counts its live blocks.
+#define GC_ARENA_RELEASED 0x80000000u
+#define GC_ARENA_SHARED   0x40000000u
+
+typedef struct GC_arena_slab GC_arena_slab_s, *GC_arena_slab_PNTR;
+struct GC_arena_slab {
+    GC_arena_PNTR arena;
+    GC_arena_slab_PNTR next;    // the arena's other slabs
+    atomic_uint state;          // blocks allocated from the slab and not yet freed, and GC_ARENA_RELEASED
+};
+// blocks start after the slab's header, 8 byte aligned as their sizes are
+#define GC_ARENA_SLAB_HEADER ((sizeof(GC_arena_slab_s) + 7) & ~(size_t) 7)
+
+struct GC_arena {
+    // Only touched by the thread in the arena.
+    void* free[GC_SLAB_CLASSES + 1];    // freed blocks by size class, each holding a pointer to the next
+    char* bump;                         // next unused byte of the newest slab
+    char* end;                          // end of the newest slab
+    GC_arena_slab_PNTR slabs;
+
+    // Blocks freed by other threads, by size class, pushed without locking for the owner to take back in one go.
+    _Atomic(void*) remote[GC_SLAB_CLASSES + 1];
+    // Slabs not yet freed, and 1 for the owner until it releases the arena; the arena goes with the last of them.
+    atomic_uint references;
+};
+
+static _Thread_local GC_arena_PNTR GC_arena_thread = NULL;  // the arena the thread has entered
+static _Thread_local GC_arena_PNTR GC_arena_cache = NULL;   // the thread's own, for when it isn't in an arena
+
+static pthread_once_t GC_arena_once = PTHREAD_ONCE_INIT;
+static pthread_key_t GC_arena_cacheKey;                     // releases a thread's cache when it exits
+
+static atomic_ulong GC_arena_slabs;
+static atomic_ulong GC_arena_promoted;
+static atomic_ulong GC_arena_shared;
+
+// Blocks freed in shared slabs, by size class, pushed without locking for an arena to take in one go.
+static _Atomic(void*) GC_arena_sharedFree[GC_SLAB_CLASSES + 1];
+
+static inline GC_arena_slab_PNTR GC_arena_slabOf(void* block) {
+    return (GC_arena_slab_PNTR) ((uintptr_t) block & ~(uintptr_t) (GC_ARENA_SLAB_SIZE - 1));
+}
+
+/**
+ * Create an arena, which no thread is in yet.
+ *
+ * @return The arena, or NULL if memory could not be allocated.
+ */
+GC_arena_PNTR GC_arena_create(void) {
+    GC_arena_PNTR arena = calloc(1, sizeof(GC_arena_s));
+    if(arena != NULL) {
+        for(unsigned int class = 0; class <= GC_SLAB_CLASSES; class++) {
+            atomic_init(&(arena->remote[class]), NULL);
+        }
+        atomic_init(&(arena->references), 1);
+    }
+    return arena;
+}
+
+/**
+ * Make the calling thread allocate from an arena, until it enters another. Only one thread may be in an arena at a
+ * time, and none once it has been released.
+ *
+ * @param[in] arena The arena, or NULL to go back to the thread's own cache
+ * @return The arena the thread was in before, or NULL
+ */
+GC_arena_PNTR GC_arena_enter(GC_arena_PNTR arena) {
+    GC_arena_PNTR previous = GC_arena_thread;
+    GC_arena_thread = arena;
+    return previous;
+}
+
+static void GC_arena_dropReference(GC_arena_PNTR arena) {
+    if(atomic_fetch_sub_explicit(&(arena->references), 1, memory_order_acq_rel) == 1) {
+        free(arena);
+    }
+}
+
+static void GC_arena_freeSlab(GC_arena_slab_PNTR slab) {
+    GC_arena_PNTR arena = slab->arena;
+    free(slab);
+    GC_arena_dropReference(arena);
+}
+
+// Push a block onto a list of free blocks that other threads push to as well.
+static void GC_arena_push(_Atomic(void*)* list, void* block) {
+    void* head = atomic_load_explicit(list, memory_order_relaxed);
+    do {
+        *(void**) block = head;
+    } while(!atomic_compare_exchange_weak_explicit(list, &head, block, memory_order_release, memory_order_relaxed));
+}
+
+// Take one of the GC_ARENA_SHARED_MAX places for shared slabs, returning false if they have all gone.
+static bool GC_arena_reserveShared(void) {
+    unsigned long shared = atomic_load_explicit(&GC_arena_shared, memory_order_relaxed);
+    do {
+        if(shared >= GC_ARENA_SHARED_MAX) {
+            return false;
+        }
+    } while(!atomic_compare_exchange_weak_explicit(&GC_arena_shared, &shared, shared + 1, memory_order_relaxed,
+                                                   memory_order_relaxed));
+    return true;
+}
+
+/**
+ * Hand an arena back once its owner is done with it. Its slabs without live blocks are freed now. The rest are
+ * shared, while there is room, so the blocks already free in them and those freed later are reused by every arena;
+ * the others are freed as soon as their last block is. The calling thread must have left it.
+ *
+ * @param[in] arena The arena
+ */
+void GC_arena_release(GC_arena_PNTR arena) {
+    //Shared first, so that from now on blocks freed in them go to the shared lists rather than this arena's.
+    GC_arena_slab_PNTR slab;
+    for(slab = arena->slabs; slab != NULL; slab = slab->next) {
+        if(atomic_load_explicit(&(slab->state), memory_order_relaxed) != 0 && GC_arena_reserveShared()) {
+            atomic_fetch_or_explicit(&(slab->state), GC_ARENA_SHARED, memory_order_relaxed);
+        }
+    }
+
+    //Nothing is released yet, so every slab is still there to read the free lists through.
+    for(unsigned int class = 0; class <= GC_SLAB_CLASSES; class++) {
+        void* lists[2] = {
+            arena->free[class], atomic_exchange_explicit(&(arena->remote[class]), NULL, memory_order_acquire)
+        };
+        for(unsigned int i = 0; i < 2; i++) {
+            void* block = lists[i];
+            while(block != NULL) {
+                void* next = *(void**) block;
+                if(atomic_load_explicit(&(GC_arena_slabOf(block)->state), memory_order_relaxed) & GC_ARENA_SHARED) {
+                    GC_arena_push(&(GC_arena_sharedFree[class]), block);
+                }
+                block = next;
+            }
+        }
+    }
+
+    slab = arena->slabs;
+    while(slab != NULL) {
+        //Once flagged, an unshared slab with live blocks can be freed by another thread at any moment.
+        GC_arena_slab_PNTR next = slab->next;
+        unsigned int state = atomic_fetch_or_explicit(&(slab->state), GC_ARENA_RELEASED, memory_order_acq_rel);
+        if(state == 0) {
+            GC_arena_freeSlab(slab);
+        } else {
+            atomic_fetch_add_explicit(&GC_arena_promoted, 1, memory_order_relaxed);
+        }
+        slab = next;
+    }
+    GC_arena_dropReference(arena);
+}
+
+static void GC_arena_releaseCache(void* arena) {
+    GC_arena_cache = NULL;
+    GC_arena_release(arena);
+}
+
+static void GC_arena_createKey(void) {
+    pthread_key_create(&GC_arena_cacheKey, GC_arena_releaseCache);
+}
+
+/**
+ * The arena the calling thread allocates from: the one it is in, or else its own cache, created the first time it
+ * is needed and released when the thread exits.
+ *
+ * @return The arena, or NULL if memory could not be allocated.
+ */
+GC_arena_PNTR GC_arena_current(void) {
+    if(GC_arena_thread != NULL) {
+        return GC_arena_thread;
+    }
+    if(GC_arena_cache == NULL) {
+        pthread_once(&GC_arena_once, GC_arena_createKey);
+        GC_arena_cache = GC_arena_create();
+        pthread_setspecific(GC_arena_cacheKey, GC_arena_cache);
+    }
+    return GC_arena_cache;
+}
+
+/**
+ * Start a new slab for the arena to bump blocks out of.
+ *
+ * @return false if memory could not be allocated.
+ */
+static bool GC_arena_addSlab(GC_arena_PNTR arena) {
+    GC_arena_slab_PNTR slab = aligned_alloc(GC_ARENA_SLAB_SIZE, GC_ARENA_SLAB_SIZE);
+    if(slab == NULL) {
+        return false;
+    }
+    slab->arena = arena;
+    slab->next = arena->slabs;
+    atomic_init(&(slab->state), 0);
+    arena->slabs = slab;
+    atomic_fetch_add_explicit(&(arena->references), 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&GC_arena_slabs, 1, memory_order_relaxed);
+
+    arena->bump = (char*) slab + GC_ARENA_SLAB_HEADER;
+    arena->end = (char*) slab + GC_ARENA_SLAB_SIZE;
+    return true;
+}
+
+/**
+ * Allocate a zeroed block from the calling thread's arena.
+ *
+ * @param[in] arena The calling thread's arena, see GC_arena_current
+ * @param[in] size_class Size class of the block
+ * @param[in] size Bytes needed, which must fit the class
+ * @return The block, or NULL if memory could not be allocated.
+ */
+void* GC_arena_alloc(GC_arena_PNTR arena, unsigned char size_class, size_t size) {
+    void* block = arena->free[size_class];
+    if(block == NULL && atomic_load_explicit(&(arena->remote[size_class]), memory_order_relaxed) != NULL) {
+        //Take back everything other threads have freed of this class at once.
+        block = atomic_exchange_explicit(&(arena->remote[size_class]), NULL, memory_order_acquire);
+    }
+    size_t blockSize = GC_slab_classSize(size_class);
+    if(block == NULL && (size_t) (arena->end - arena->bump) < blockSize &&
+       atomic_load_explicit(&(GC_arena_sharedFree[size_class]), memory_order_relaxed) != NULL) {
+        //Rather than start a slab, take every block of this class free in the shared slabs.
+        block = atomic_exchange_explicit(&(GC_arena_sharedFree[size_class]), NULL, memory_order_acquire);
+    }
+
+    if(block != NULL) {
+        arena->free[size_class] = *(void**) block;
+    } else {
+        if((size_t) (arena->end - arena->bump) < blockSize && !GC_arena_addSlab(arena)) {
+            return NULL;
+        }
+        block = arena->bump;
+        arena->bump += blockSize;
+    }
+    memset(block, 0, size);
+    atomic_fetch_add_explicit(&(GC_arena_slabOf(block)->state), 1, memory_order_relaxed);
+    return block;
+}
+
+/**
+ * Free a block allocated by GC_arena_alloc, from whichever thread.
+ *
+ * @param[in] block The block
+ * @param[in] size_class Size class of the block
+ */
+void GC_arena_free(void* block, unsigned char size_class) {
+    GC_arena_slab_PNTR slab = GC_arena_slabOf(block);
+    GC_arena_PNTR arena = slab->arena;
+
+    if(arena == GC_arena_thread || arena == GC_arena_cache) {
+        *(void**) block = arena->free[size_class];
+        arena->free[size_class] = block;
+        atomic_fetch_sub_explicit(&(slab->state), 1, memory_order_relaxed);
+        return;
+    }
+
+    unsigned int state = atomic_load_explicit(&(slab->state), memory_order_relaxed);
+    if(state & GC_ARENA_SHARED) {
+        //A shared slab is never freed, so its blocks are always safe to hand on.
+        GC_arena_push(&(GC_arena_sharedFree[size_class]), block);
+        atomic_fetch_sub_explicit(&(slab->state), 1, memory_order_relaxed);
+        return;
+    }
+    if(!(state & GC_ARENA_RELEASED)) {
+        //Pushed before the count drops, as the slab (and the arena, if it is the last) may go as soon as it does.
+        GC_arena_push(&(arena->remote[size_class]), block);
+    }
+    if(atomic_fetch_sub_explicit(&(slab->state), 1, memory_order_acq_rel) == (GC_ARENA_RELEASED | 1)) {
+        //The last object to escape from this slab.
+        GC_arena_freeSlab(slab);
+    }
+}
+
+bool GC_arena_isOwned(void* block) {
+    GC_arena_slab_PNTR slab = GC_arena_slabOf(block);
+    return slab->arena == GC_arena_thread || slab->arena == GC_arena_cache;
+}
+
+bool GC_arena_isReleased(void* block) {
+    return atomic_load_explicit(&(GC_arena_slabOf(block)->state), memory_order_acquire) & GC_ARENA_RELEASED;
+}
+
+void GC_arena_getSlabs(unsigned long* slabs, unsigned long* promoted, unsigned long* shared) {
+    *slabs = atomic_load_explicit(&GC_arena_slabs, memory_order_relaxed);
+    *promoted = atomic_load_explicit(&GC_arena_promoted, memory_order_relaxed);
+    *shared = atomic_load_explicit(&GC_arena_shared, memory_order_relaxed);
+}
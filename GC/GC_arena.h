@@ -0,0 +1,71 @@
+/*
+ * @file GC_arena.h
+ *
+ * Arenas: heaps owned by one thread at a time, such as a component's, or a thread's own allocation cache.
+ *
+ * A thread allocates from the arena it is in (GC_arena_enter), or, outside any, from a cache of its own that is
+ * created the first time it allocates and released when it exits. Its small blocks are carved out of the arena's own
+ * slabs, and blocks it frees go back on the arena's own free lists, neither taking a lock. Blocks freed by other
+ * threads, which happens to objects that escape the arena (a message is allocated by its sender and freed by its
+ * receiver), are pushed onto a lock-free list for their size class, which the owner takes back whole, with a single
+ * exchange, the next time it runs out of free blocks of that class.
+ *
+ * When the owner is done with it, the arena is released: every slab without a live block goes back to the system at
+ * once, whatever was on the free lists. Slabs still holding escaped objects pass to the shared heap. Up to
+ * GC_ARENA_SHARED_MAX of them are kept for good, their free blocks (and those freed later) pushed onto shared lists by
+ * size class, which an arena takes whole before it starts a new slab; the others are freed in their turn when the last
+ * of their objects is.
+ *
+ * Arena slabs are GC_ARENA_SLAB_SIZE bytes, aligned to their size, so a block finds its slab (and the slab its
+ * arena) by rounding its address down. Blocks of every size class are bumped out of the same slab.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_GC_ARENA_H
+#define CVM_GC_ARENA_H
+
+#include <stddef.h>
+#include "GC_mem.h"
+
+#define GC_ARENA_SLAB_SIZE 16384    // bytes in each arena slab, a power of 2
+#define GC_ARENA_SHARED_MAX 256     // slabs outliving their arena that are kept for reuse, rather than freed
+
+// The arena the calling thread allocates from: the one it is in, or its own cache. NULL if memory ran out.
+GC_arena_PNTR GC_arena_current(void);
+
+// Allocate a zeroed block of a size class (see GC_slab.h) from the calling thread's arena, which must be arena.
+void* GC_arena_alloc(GC_arena_PNTR arena, unsigned char size_class, size_t size);
+// Free a block allocated by GC_arena_alloc, from whichever thread.
+void GC_arena_free(void* block, unsigned char size_class);
+
+// Whether a block is in the calling thread's arena or own cache, so that no other thread is allocating objects from it
+// as it runs.
+bool GC_arena_isOwned(void* block);
+// Whether a block is in an arena that has been released, so that no thread will own it again.
+bool GC_arena_isReleased(void* block);
+
+// Number of slabs given to arenas (and thread caches), of those, slabs that outlived their arena, and of those, slabs
+// kept for reuse.
+void GC_arena_getSlabs(unsigned long* slabs, unsigned long* promoted, unsigned long* shared);
+
+#endif //CVM_GC_ARENA_H
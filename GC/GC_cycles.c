@@ -0,0 +1,495 @@
+/*
+ * @file GC_cycles.c
+ *
+ * Cycle collection, see GC_cycles.h.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "GC_cycles.h"
+#include "GC_arena.h"
+#include "GC_slab.h"
+#include "GC_static.h"
+#include "../Logger/Logger.h"
+#include "Strings.h"
+
+#define GC_CYCLES_TYPES 64                              // types that can be registered, a power of 2
+#define GC_CYCLES_INDEX (2 * GC_CYCLES_MAX_OBJECTS)     // slots in the index of objects scanned, a power of 2
+
+_Thread_local size_t GC_cycles_allocated = 0;
+
+// Registered types, by their decRef function, linearly probed. A slot's children function is written before its
+// decRef function is published, and neither changes after.
+static struct GC_cycles_type {
+    _Atomic(decRefFunc_t) decRef;
+    GC_childrenFunc_t children;
+} GC_cycles_types[GC_CYCLES_TYPES];
+static pthread_mutex_t GC_cycles_typesLock = PTHREAD_MUTEX_INITIALIZER;
+
+struct GC_cycles_roots {
+    void** roots;
+    size_t count;
+    size_t capacity;
+};
+
+static _Thread_local struct GC_cycles_roots GC_cycles_local;   // possible roots buffered by the thread
+static _Thread_local bool GC_cycles_collecting = false;         // so the references a collection drops aren't buffered
+static pthread_once_t GC_cycles_once = PTHREAD_ONCE_INIT;
+static pthread_key_t GC_cycles_exitKey;                        // hands a thread's roots on when it exits
+
+// Roots buffered by threads that have exited, and roots that couldn't be scanned yet, for any thread to collect.
+static struct GC_cycles_roots GC_cycles_orphans;
+static pthread_mutex_t GC_cycles_orphansLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Only one collection runs at a time, so that no object is scanned or freed by two. The state of the root it is
+// scanning: the objects reached, in the order they were found, and an index of them by address.
+static pthread_mutex_t GC_cycles_lock = PTHREAD_MUTEX_INITIALIZER;
+struct GC_cycles_object {
+    void* pntr;                 // NULL once freed
+    unsigned long internal;     // references to it from the other objects scanned
+    unsigned int slot;          // its slot in GC_cycles_index
+    bool live;                  // referenced from outside those scanned, directly or through others that are
+};
+static struct GC_cycles_object* GC_cycles_objects;
+static unsigned int* GC_cycles_index;   // position of the object in GC_cycles_objects + 1, or 0 for an empty slot
+static unsigned int* GC_cycles_marking; // live objects whose children have yet to be marked live
+static unsigned int GC_cycles_found;
+static bool GC_cycles_overflowed;       // the root reaches more than GC_CYCLES_MAX_OBJECTS
+
+static atomic_ulong GC_cycles_freedObjects;
+static atomic_ulong GC_cycles_freedBytes;
+
+static inline unsigned int GC_cycles_typeSlot(decRefFunc_t decRef) {
+    return (unsigned int) ((uintptr_t) decRef >> 4) & (GC_CYCLES_TYPES - 1);
+}
+
+/**
+ * Find a type's children function.
+ *
+ * @param[in] decRef The type's decRef function
+ * @return The children function, or NULL if the type hasn't registered one.
+ */
+static GC_childrenFunc_t GC_cycles_childrenOf(decRefFunc_t decRef) {
+    unsigned int slot = GC_cycles_typeSlot(decRef);
+    for(unsigned int i = 0; i < GC_CYCLES_TYPES; i++, slot = (slot + 1) & (GC_CYCLES_TYPES - 1)) {
+        decRefFunc_t registered = atomic_load_explicit(&(GC_cycles_types[slot].decRef), memory_order_acquire);
+        if(registered == decRef) {
+            return GC_cycles_types[slot].children;
+        }
+        if(registered == NULL) {
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Let the cycle collector scan objects of a type. Types register themselves as their objects are constructed, so
+ * this is cheap once a type is registered.
+ *
+ * @param[in] decRef The type's decRef function, as set in its objects' first field
+ * @param[in] children Function visiting each object an object of the type holds a reference to, that its decRef
+ *                     function drops. It may be called from any thread while the object is in use.
+ */
+void GC_registerChildren(decRefFunc_t decRef, GC_childrenFunc_t children) {
+    if(GC_cycles_childrenOf(decRef) != NULL) {
+        return;
+    }
+    pthread_mutex_lock(&GC_cycles_typesLock);
+    unsigned int slot = GC_cycles_typeSlot(decRef);
+    for(unsigned int i = 0; i < GC_CYCLES_TYPES; i++, slot = (slot + 1) & (GC_CYCLES_TYPES - 1)) {
+        decRefFunc_t registered = atomic_load_explicit(&(GC_cycles_types[slot].decRef), memory_order_relaxed);
+        if(registered == decRef) {
+            break;
+        }
+        if(registered == NULL) {
+            GC_cycles_types[slot].children = children;
+            atomic_store_explicit(&(GC_cycles_types[slot].decRef), decRef, memory_order_release);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&GC_cycles_typesLock);
+}
+
+static bool GC_cycles_push(struct GC_cycles_roots* roots, void* pntr) {
+    if(roots->count == roots->capacity) {
+        size_t capacity = roots->capacity == 0 ? 64 : roots->capacity * 2;
+        void** grown = realloc(roots->roots, capacity * sizeof(void*));
+        if(grown == NULL) {
+            return false;
+        }
+        roots->roots = grown;
+        roots->capacity = capacity;
+    }
+    roots->roots[roots->count++] = pntr;
+    return true;
+}
+
+// Add roots to those for any thread to collect, taking the orphans' lock.
+static void GC_cycles_orphan(void** roots, size_t count) {
+    pthread_mutex_lock(&GC_cycles_orphansLock);
+    for(size_t i = 0; i < count; i++) {
+        if(!GC_cycles_push(&GC_cycles_orphans, roots[i])) {
+            //Left buffered for good, so never freed.
+            log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_OOM);
+        }
+    }
+    pthread_mutex_unlock(&GC_cycles_orphansLock);
+}
+
+static void GC_cycles_threadExit(void* roots) {
+    (void) roots;
+    GC_cycles_orphan(GC_cycles_local.roots, GC_cycles_local.count);
+    free(GC_cycles_local.roots);
+    GC_cycles_local = (struct GC_cycles_roots) { NULL, 0, 0 };
+}
+
+static void GC_cycles_createKey(void) {
+    pthread_key_create(&GC_cycles_exitKey, GC_cycles_threadExit);
+}
+
+/**
+ * Decide whether to buffer an object, as a possible root, when a reference to it is dropped and others remain.
+ * Objects are only buffered once until they are collected, and not at all if they can't be scanned.
+ *
+ * @param[in] pntr The object, which contains pointers
+ * @return true if the caller must pass the object to GC_cycles_buffer once it has dropped its reference.
+ */
+bool GC_cycles_claim(void* pntr) {
+    GC_Header_PNTR header = GC_header(pntr);
+    if(GC_cycles_collecting || (GC_header_flags(header) & GC_CYCLES_BUFFERED) || GC_static_contains(header)) {
+        return false;
+    }
+    if(GC_cycles_childrenOf(((GC_Container_PNTR) pntr)->decRef) == NULL) {
+        return false;
+    }
+    return !(atomic_fetch_or_explicit(&(header->word), GC_CYCLES_BUFFERED, memory_order_relaxed) & GC_CYCLES_BUFFERED);
+}
+
+/**
+ * Buffer an object claimed with GC_cycles_claim.
+ *
+ * @param[in] pntr The object, which the thread need no longer hold a reference to
+ */
+void GC_cycles_buffer(void* pntr) {
+    if(GC_cycles_local.roots == NULL) {
+        pthread_once(&GC_cycles_once, GC_cycles_createKey);
+        pthread_setspecific(GC_cycles_exitKey, &GC_cycles_local);
+    }
+    if(!GC_cycles_push(&GC_cycles_local, pntr)) {
+        log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_OOM);
+    }
+}
+
+/**
+ * Settle which thread frees an object whose last reference has gone, once its decRef function has run: the caller,
+ * unless the object is buffered, in which case the thread taking it off the buffer does.
+ *
+ * @param[in] header The object's header
+ * @return true if the caller must free the object.
+ */
+bool GC_cycles_release(GC_Header_PNTR header) {
+    if(!(atomic_load_explicit(&(header->word), memory_order_acquire) & GC_CYCLES_BUFFERED)) {
+        return true;
+    }
+    return !(atomic_fetch_or_explicit(&(header->word), GC_CYCLES_FREED, memory_order_acq_rel) & GC_CYCLES_BUFFERED);
+}
+
+/**
+ * Take a reference to an object, unless it has already lost its last one.
+ *
+ * @return false if the object has no references.
+ */
+static bool GC_cycles_hold(GC_Header_PNTR header) {
+    unsigned long word = atomic_load_explicit(&(header->word), memory_order_acquire);
+    if(word & GC_HEADER_LOCAL) {
+        if(GC_header_count(word) == 0) {
+            return false;
+        }
+        atomic_store_explicit(&(header->word), word + GC_HEADER_REFERENCE, memory_order_relaxed);
+        return true;
+    }
+    do {
+        if(GC_header_count(word) == 0) {
+            return false;
+        }
+    } while(!atomic_compare_exchange_weak_explicit(&(header->word), &word, word + GC_HEADER_REFERENCE,
+                                                   memory_order_acquire, memory_order_acquire));
+    return true;
+}
+
+// Whether the collecting thread may scan an object: it has a children function, and is in the thread's own arena or
+// cache. Objects in the static heap, which every thread allocates from, never are, nor are immortal ones,
+// which can't be garbage.
+static bool GC_cycles_scannable(void* pntr) {
+    GC_Header_PNTR header = GC_header(pntr);
+    return GC_header_sizeClass(header) != GC_SLAB_LARGE && !GC_static_contains(header) &&
+           !(GC_header_flags(header) & GC_HEADER_IMMORTAL) &&
+           GC_arena_isOwned(header) && GC_cycles_childrenOf(((GC_Container_PNTR) pntr)->decRef) != NULL;
+}
+
+// Slot in GC_cycles_index holding an object, or the empty one it would go in.
+static unsigned int GC_cycles_find(void* pntr) {
+    unsigned int slot = (unsigned int) ((uintptr_t) pntr >> 4) * 2654435761u & (GC_CYCLES_INDEX - 1);
+    while(GC_cycles_index[slot] != 0 && GC_cycles_objects[GC_cycles_index[slot] - 1].pntr != pntr) {
+        slot = (slot + 1) & (GC_CYCLES_INDEX - 1);
+    }
+    return slot;
+}
+
+static void GC_cycles_add(void* pntr, unsigned int slot, unsigned long internal) {
+    GC_cycles_objects[GC_cycles_found] = (struct GC_cycles_object) { pntr, internal, slot, false };
+    GC_cycles_index[slot] = ++GC_cycles_found;
+}
+
+// Visit function counting a reference between objects scanned, holding and adding to those to scan any object it
+// reaches that can be.
+static void GC_cycles_countReference(void* child, void* context) {
+    (void) context;
+    if(child == NULL || !(GC_header_flags(GC_header(child)) & GC_HEADER_POINTERS)) {
+        return;     //Refers to nothing, so can't be in a cycle.
+    }
+    unsigned int slot = GC_cycles_find(child);
+    if(GC_cycles_index[slot] != 0) {
+        GC_cycles_objects[GC_cycles_index[slot] - 1].internal++;
+    } else if(!GC_cycles_overflowed && GC_cycles_scannable(child)) {
+        if(GC_cycles_found == GC_CYCLES_MAX_OBJECTS) {
+            GC_cycles_overflowed = true;
+        } else if(GC_cycles_hold(GC_header(child))) {
+            GC_cycles_add(child, slot, 1);
+        }
+    }
+}
+
+// Visit function marking an object scanned live, for its own children to be marked in turn.
+static void GC_cycles_markLive(void* child, void* context) {
+    unsigned int* marking = context;
+    if(child == NULL) {
+        return;
+    }
+    unsigned int position = GC_cycles_index[GC_cycles_find(child)];
+    if(position != 0 && !GC_cycles_objects[position - 1].live) {
+        GC_cycles_objects[position - 1].live = true;
+        GC_cycles_marking[(*marking)++] = position - 1;
+    }
+}
+
+static inline void GC_cycles_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    GC_cycles_childrenOf(((GC_Container_PNTR) pntr)->decRef)(pntr, visit, context);
+}
+
+/**
+ * Free the objects scanned that weren't marked live: garbage, only referenced from each other. Each drops its
+ * references first, leaving it with the collector's alone, before any of them go.
+ */
+static void GC_cycles_freeGarbage(unsigned long* objects, unsigned long* bytes) {
+    for(unsigned int i = 0; i < GC_cycles_found; i++) {
+        if(!GC_cycles_objects[i].live) {
+            ((GC_Container_PNTR) GC_cycles_objects[i].pntr)->decRef(GC_cycles_objects[i].pntr);
+        }
+    }
+    for(unsigned int i = 0; i < GC_cycles_found; i++) {
+        void* pntr = GC_cycles_objects[i].pntr;
+        if(GC_cycles_objects[i].live) {
+            continue;
+        }
+        GC_cycles_objects[i].pntr = NULL;
+        GC_Header_PNTR header = GC_header(pntr);
+        if(GC_header_count(atomic_load_explicit(&(header->word), memory_order_acquire)) != 1) {
+            //Only possible if a children function visits something its decRef function doesn't drop. It has let go
+            // of its own references, so is left as it is rather than released again.
+            log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_CYCLES_REFERENCED, pntr);
+            continue;
+        }
+        atomic_fetch_sub_explicit(&(header->word), GC_HEADER_REFERENCE, memory_order_relaxed);
+        (*objects)++;
+        *bytes += GC_slab_classSize(GC_header_sizeClass(header));
+        if(GC_cycles_release(header)) {
+            GC_free(pntr);
+        }
+    }
+}
+
+/**
+ * Collect whatever garbage cycles pass through a root.
+ *
+ * @param[in] root The root, which the collector holds a reference to
+ * @return The number of objects scanned.
+ */
+static unsigned int GC_cycles_scan(void* root, unsigned long* objects, unsigned long* bytes) {
+    GC_cycles_found = 0;
+    GC_cycles_overflowed = false;
+    GC_cycles_add(root, GC_cycles_find(root), 0);
+    for(unsigned int i = 0; i < GC_cycles_found && !GC_cycles_overflowed; i++) {
+        GC_cycles_children(GC_cycles_objects[i].pntr, GC_cycles_countReference, NULL);
+    }
+
+    if(!GC_cycles_overflowed) {
+        //Objects with more references than the others scanned (and the collector) account for are live, and so is
+        // everything they refer to.
+        unsigned int marking = 0;
+        for(unsigned int i = 0; i < GC_cycles_found; i++) {
+            GC_Header_PNTR header = GC_header(GC_cycles_objects[i].pntr);
+            if(GC_header_count(atomic_load_explicit(&(header->word), memory_order_acquire)) - 1 !=
+               GC_cycles_objects[i].internal) {
+                GC_cycles_objects[i].live = true;
+                GC_cycles_marking[marking++] = i;
+            }
+        }
+        while(marking > 0) {
+            GC_cycles_children(GC_cycles_objects[GC_cycles_marking[--marking]].pntr, GC_cycles_markLive, &marking);
+        }
+        GC_cycles_freeGarbage(objects, bytes);
+    }
+
+    for(unsigned int i = 0; i < GC_cycles_found; i++) {
+        GC_cycles_index[GC_cycles_objects[i].slot] = 0;
+        if(GC_cycles_objects[i].pntr != NULL) {
+            GC_decRef(GC_cycles_objects[i].pntr);
+        }
+    }
+    return GC_cycles_found;
+}
+
+/**
+ * Take a root off a buffer and collect through it.
+ *
+ * @param[in] root The root
+ * @param[in,out] later Where to put the root if it can't be scanned yet
+ * @return The number of objects scanned, at least 1.
+ */
+static unsigned int GC_cycles_collectRoot(void* root, struct GC_cycles_roots* later, unsigned long* objects,
+                                          unsigned long* bytes) {
+    GC_Header_PNTR header = GC_header(root);
+    if(!(atomic_load_explicit(&(header->word), memory_order_acquire) & GC_CYCLES_FREED) &&
+       GC_header_sizeClass(header) != GC_SLAB_LARGE && !GC_arena_isOwned(header) && !GC_arena_isReleased(header)) {
+        //Another thread's arena, which it is still allocating from. Roots in released arenas can never be scanned,
+        // so are dropped below instead.
+        if(!GC_cycles_push(later, root)) {
+            log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_OOM);
+        }
+        return 1;
+    }
+
+    if(!GC_cycles_hold(header)) {
+        //Its last reference went while it was buffered: it's freed here if its decRef function has finished, and
+        // otherwise by the thread running it.
+        if(atomic_fetch_and_explicit(&(header->word), ~GC_CYCLES_BUFFERED, memory_order_acq_rel) &
+           GC_CYCLES_FREED) {
+            GC_free(root);
+        }
+        return 1;
+    }
+    atomic_fetch_and_explicit(&(header->word), ~GC_CYCLES_BUFFERED, memory_order_relaxed);
+    if(!GC_cycles_scannable(root)) {
+        GC_decRef(root);
+        return 1;
+    }
+    return GC_cycles_scan(root, objects, bytes);
+}
+
+/**
+ * Collect through the thread's own roots, then those left for any thread, until a number of objects have been
+ * scanned. The collector's lock must be held.
+ */
+static void GC_cycles_run(size_t budget) {
+    if(GC_cycles_objects == NULL) {
+        GC_cycles_objects = malloc(GC_CYCLES_MAX_OBJECTS * sizeof(struct GC_cycles_object));
+        GC_cycles_index = calloc(GC_CYCLES_INDEX, sizeof(unsigned int));
+        GC_cycles_marking = malloc(GC_CYCLES_MAX_OBJECTS * sizeof(unsigned int));
+        if(GC_cycles_objects == NULL || GC_cycles_index == NULL || GC_cycles_marking == NULL) {
+            free(GC_cycles_objects);
+            free(GC_cycles_index);
+            free(GC_cycles_marking);
+            GC_cycles_objects = NULL;
+            log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_OOM);
+            return;
+        }
+    }
+
+    GC_cycles_collecting = true;
+    unsigned long objects = 0;
+    unsigned long bytes = 0;
+    size_t spent = 0;
+    struct GC_cycles_roots later = { NULL, 0, 0 };
+    while(spent < budget && GC_cycles_local.count > 0) {
+        spent += GC_cycles_collectRoot(GC_cycles_local.roots[--GC_cycles_local.count], &later, &objects, &bytes);
+    }
+
+    //Oldest first, with those that still can't be scanned going to the back.
+    pthread_mutex_lock(&GC_cycles_orphansLock);
+    struct GC_cycles_roots orphans = GC_cycles_orphans;
+    GC_cycles_orphans = (struct GC_cycles_roots) { NULL, 0, 0 };
+    pthread_mutex_unlock(&GC_cycles_orphansLock);
+    size_t taken = 0;
+    while(spent < budget && taken < orphans.count) {
+        spent += GC_cycles_collectRoot(orphans.roots[taken++], &later, &objects, &bytes);
+    }
+    GC_cycles_orphan(orphans.roots + taken, orphans.count - taken);
+    GC_cycles_orphan(later.roots, later.count);
+    free(orphans.roots);
+    free(later.roots);
+    GC_cycles_collecting = false;
+
+    if(objects > 0) {
+        atomic_fetch_add_explicit(&GC_cycles_freedObjects, objects, memory_order_relaxed);
+        atomic_fetch_add_explicit(&GC_cycles_freedBytes, bytes, memory_order_relaxed);
+        log_logMessage(INFO, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_CYCLES_FREED, objects, bytes);
+    }
+}
+
+/**
+ * Collect cycles, if the calling thread has allocated GC_CYCLES_TRIGGER bytes since it last did, for up to
+ * GC_CYCLES_BUDGET objects scanned. Skipped if another thread is collecting. Must be called with no locks held that
+ * a decRef function may take.
+ */
+void GC_cycles_poll(void) {
+    if(GC_cycles_allocated < GC_CYCLES_TRIGGER) {
+        return;
+    }
+    GC_cycles_allocated = 0;
+    if(pthread_mutex_trylock(&GC_cycles_lock) == 0) {
+        GC_cycles_run(GC_CYCLES_BUDGET);
+        pthread_mutex_unlock(&GC_cycles_lock);
+    }
+}
+
+/**
+ * Collect every cycle through the roots the calling thread can scan now, waiting for any other collection to
+ * finish first. Must be called with no locks held that a decRef function may take.
+ */
+void GC_cycles_collect(void) {
+    GC_cycles_allocated = 0;
+    pthread_mutex_lock(&GC_cycles_lock);
+    GC_cycles_run(SIZE_MAX);
+    pthread_mutex_unlock(&GC_cycles_lock);
+}
+
+void GC_cycles_getStats(unsigned long* objects, unsigned long* bytes) {
+    *objects = atomic_load_explicit(&GC_cycles_freedObjects, memory_order_relaxed);
+    *bytes = atomic_load_explicit(&GC_cycles_freedBytes, memory_order_relaxed);
+}
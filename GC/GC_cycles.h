@@ -0,0 +1,74 @@
+/*
+ * @file GC_cycles.h
+ *
+ * Cycle collection, by trial deletion (after Bacon and Rajan, "Concurrent Cycle Collection in Reference Counted
+ * Systems", 2001).
+ *
+ * Reference counting never frees objects that refer to each other in a cycle, such as two bound channels, each in
+ * the other's connection set. When a reference to an object that contains pointers is dropped and others remain,
+ * the object may just have become the way into such a cycle, so it is buffered as a possible root. Every so many
+ * bytes a thread allocates, GC_cycles_poll takes roots off its buffer, and for each one, finds the objects it
+ * reaches, counts the references they hold to each other, and frees those whose references all come from others
+ * that are also only referenced from within. Nothing's counts change while this is worked out; the objects found to
+ * be garbage have their decRef functions run and are freed together afterwards.
+ *
+ * Only objects whose type has registered a children function (GC_registerChildren) are scanned, and of those, only
+ * ones in the collecting thread's own arena or cache. Objects elsewhere, including those that escaped an arena that
+ * has since been released, may be reached and changed by other threads while they are scanned, and trial deletion
+ * can't tell a count that changed under it from one that never did. Anything not scanned counts as a reference from
+ * outside, keeping what it refers to alive, so types and objects that aren't scanned are never freed by mistake, only
+ * not collected. A root in another thread's arena is left for that thread, or given up on once the arena is released;
+ * so is a cycle larger than GC_CYCLES_MAX_OBJECTS. Objects in the static heap (see GC_static.h) aren't in any arena,
+ * so aren't collected. A component collects before its arena is released, which frees the cycles left in it, but a
+ * cycle spanning two components' arenas, such as channels bound between them, outlives them both.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_GC_CYCLES_H
+#define CVM_GC_CYCLES_H
+
+#include <stddef.h>
+#include "GC_mem_private.h"
+
+#define GC_CYCLES_BUFFERED GC_HEADER_BUFFERED  // the object is in a buffer of possible roots
+#define GC_CYCLES_FREED GC_HEADER_FREED        // it lost its last reference while buffered, see GC_cycles_release
+
+#define GC_CYCLES_TRIGGER 262144    // bytes a thread allocates between collections
+#define GC_CYCLES_BUDGET 4096       // objects scanned by each collection, at most, before it stops for the next
+#define GC_CYCLES_MAX_OBJECTS 4096  // objects a root may reach for its cycles to be collected
+
+extern _Thread_local size_t GC_cycles_allocated;   // bytes allocated by the thread since it last collected
+
+// Called for each reference dropped that leaves the object referenced, before it is dropped: true if the object
+// is now to be buffered, by passing it to GC_cycles_buffer once the reference has gone.
+bool GC_cycles_claim(void* pntr);
+void GC_cycles_buffer(void* pntr);
+
+// Called once an object's last reference has gone and it has released its own: false if it is still buffered, in
+// which case the thread that takes it off the buffer frees it instead.
+bool GC_cycles_release(GC_Header_PNTR header);
+
+// Objects and bytes, including headers, freed by the cycle collector.
+void GC_cycles_getStats(unsigned long* objects, unsigned long* bytes);
+
+#endif //CVM_GC_CYCLES_H
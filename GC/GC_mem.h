@@ -43,13 +43,62 @@
 
 typedef void (*decRefFunc_t)(void* pntr);
 
+// Calls visit, with context, on each object that an object holds a counted reference to (see GC_registerChildren).
+typedef void (*GC_visitFunc_t)(void* child, void* context);
+typedef void (*GC_childrenFunc_t)(void* pntr, GC_visitFunc_t visit, void* context);
+
+typedef struct GC_arena GC_arena_s, *GC_arena_PNTR;     // see GC_arena.h
+
+// running totals since the program started
+struct GC_stats {
+    unsigned long allocations;  // objects allocated
+    unsigned long frees;        // objects freed
+    unsigned long immortal;     // objects made immortal, which never are
+    unsigned long bytes;        // bytes allocated, not counting headers
+    unsigned long blockBytes;   // bytes of the blocks they were allocated in, with their headers and rounding up
+    unsigned long mallocs;      // calls to malloc, for slabs of small objects or for large ones
+    unsigned long arenaSlabs;   // of those, slabs (all of them, for components' arenas and threads' caches)
+    unsigned long promoted;     // slabs that outlived their arena or thread, holding objects that escaped it
+    unsigned long shared;       // of those, slabs kept for every arena to reuse (see GC_arena.h), never freed
+    unsigned long cycleObjects; // objects freed by the cycle collector, having only been referenced from cycles
+    unsigned long cycleBytes;   // and the memory they took up, with headers
+    unsigned long staticBudget; // bytes the static heap may use (see GC_static.h), 0 unless it is in use
+    unsigned long staticHighWater;  // the most it has used
+    unsigned long staticInUse;  // bytes of its blocks not yet freed
+};
+
 extern void GC_init();
 extern void GC_assign(void *generic_var_pntr, void *new_mem);
-extern void* GC_alloc(size_t size, bool contains_pointers);
-//extern unsigned GC_getRef(void* pntr);
+extern void* GC_allocAt(size_t size, bool contains_pointers, const char* site, const char* type);
+extern void* GC_allocLocalAt(size_t size, bool contains_pointers, const char* site, const char* type);
+
+// Allocations name where they were made, and optionally what they are, for the heap profiler (see GC_profile.h).
+#define GC_STRINGIFY(x) #x
+#define GC_LINE(line) GC_STRINGIFY(line)
+#define GC_SITE __FILE__ ":" GC_LINE(__LINE__)
+#define GC_alloc(size, contains_pointers) GC_allocAt(size, contains_pointers, GC_SITE, NULL)
+#define GC_allocType(size, contains_pointers, type) GC_allocAt(size, contains_pointers, GC_SITE, type)
+// only ever referenced by one thread at a time
+#define GC_allocLocal(size, contains_pointers) GC_allocLocalAt(size, contains_pointers, GC_SITE, NULL)
+#define GC_allocLocalType(size, contains_pointers, type) GC_allocLocalAt(size, contains_pointers, GC_SITE, type)
+extern unsigned GC_getRef(void* pntr);
 extern bool GC_mem_contains_pointers(void* pntr);
 //extern void GC_mem_set_contains_pointers(void* pntr, bool mem_contains_pointers);
 extern void GC_decRef(void* pntr);
 extern void GC_incRef(void* pntr);
+// Never free an object, or count references to it, again (see GC_getRef), for objects shared by many threads which
+// never change.
+extern void GC_makeImmortal(void* pntr);
+extern void GC_getStats(struct GC_stats* stats);
+
+extern GC_arena_PNTR GC_arena_create(void);
+extern GC_arena_PNTR GC_arena_enter(GC_arena_PNTR arena);
+extern void GC_arena_release(GC_arena_PNTR arena);
+
+// Objects of a type, identified by its decRef function, hold the references its children function visits, which
+// must be exactly those its decRef function drops (or, to keep the cycle collector from scanning further, fewer).
+extern void GC_registerChildren(decRefFunc_t decRef, GC_childrenFunc_t children);
+extern void GC_cycles_poll(void);       // collect cycles, a budget's worth, if the thread has allocated enough since
+extern void GC_cycles_collect(void);    // collect every cycle the thread can now, whatever it has allocated
 
 #endif /*GC_MEM_H*/
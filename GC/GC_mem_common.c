@@ -30,14 +30,30 @@
  */
 
 
+#include <limits.h>
+#include <stdatomic.h>
 #include "GC_mem_private.h"
+#include "GC_slab.h"
+#include "GC_arena.h"
+#include "GC_cycles.h"
+#include "GC_profile.h"
+#include "GC_static.h"
 #include "../Logger/Logger.h"
 #include "Strings.h"
 
-// mutex to serialise memory operation when using a shared heap
-pthread_mutex_t* GC_mutex;
+static bool GC_initialised = false;
 
-void GC_free(void* pntr);
+// allocation counters; nothing is ordered by them, so they are updated relaxed
+static atomic_ulong GC_allocations;
+static atomic_ulong GC_frees;
+static atomic_ulong GC_immortal;
+static atomic_ulong GC_bytes;
+static atomic_ulong GC_blockBytes;
+
+_Static_assert(sizeof(GC_Header_s) == 8, "a GC header is one word");
+_Static_assert(GC_SLAB_CLASSES < 1 << (GC_HEADER_TAG_SHIFT - GC_HEADER_CLASS_SHIFT), "size classes fit the header");
+_Static_assert(GC_PROFILE_MAX_TAGS <= GC_HEADER_TAG_MASK, "profiler tags fit the header");
+_Static_assert(GC_HEADER_TAG_MASK << GC_HEADER_TAG_SHIFT < GC_HEADER_IMMORTAL, "profiler tags leave the immortal bit");
 
 /**
  * Initialise the Garbage Collection subsystem.
@@ -46,9 +62,9 @@ void GC_free(void* pntr);
  * Subsequent calls to this method are ignored.
  */
 void GC_init() {
-    if(GC_mutex == NULL) {
-        GC_mutex = malloc(sizeof(pthread_mutex_t));
-        pthread_mutex_init(GC_mutex, NULL);
+    if(!GC_initialised) {
+        GC_initialised = true;
+        GC_slab_init();
         log_logMessage(INFO, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_INITIALISED);
     }
 }
@@ -89,18 +105,20 @@ void GC_assign(void *generic_var_pntr, void *new_mem) {
 }
 
 /**
- * Allocate space in memory for a new, garbage collected object.
- *
- * The newly allocated memory is automatically zero'd.
+ * Allocate and set up a zeroed object with a reference count of 1.
  *
  * @param[in] size The size, in bytes, to allocate
  * @param[in] mem_contains_pointers If this memory will contain pointers, set to true.
+ * @param[in] local If references to the object will only be taken and dropped by one thread at a time.
+ * @param[in] site Where the object is being allocated, see GC_SITE
+ * @param[in] type What the object is, or NULL
  *
  * @return A pointer to the newly allocated memory, or NULL if memory could not be allocated.
  */
-void* GC_alloc(size_t size, bool mem_contains_pointers){
-	//Allocate memory (required memory + GC overhead)
-	void* new_memory = malloc(size + sizeof(GC_Header_s));
+static void* GC_allocObject(size_t size, bool mem_contains_pointers, bool local, const char* site, const char* type) {
+	//Allocate zeroed memory (required memory + GC overhead), which avoids having to set all pointer types to NULL
+	unsigned char size_class;
+	void* new_memory = GC_slab_alloc(size + sizeof(GC_Header_s), &size_class);
 
     if(new_memory == NULL) {
         log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_OOM);
@@ -111,12 +129,21 @@ void* GC_alloc(size_t size, bool mem_contains_pointers){
     log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_ALLOCATING_BYTES, size, new_memory);
 #endif
 
-	// zero memory area to avoid having to set all pointer types to NULL
-	memset(new_memory, 0, (size + sizeof(GC_Header_s)));
+	size_t blockSize = GC_slab_blockSize(new_memory, size_class);
+	unsigned int tag = GC_profile_tag(site, type);
+	if(tag != 0) {
+		GC_profile_alloc(tag, blockSize);
+	}
+
 	GC_Header_PNTR header = ((GC_Header_PNTR) new_memory);
-	header->ref_count = 1;
-	header->mem_contains_pointers = mem_contains_pointers;
-	header->mutex = GC_mutex;
+	atomic_init(&(header->word), GC_HEADER_REFERENCE | (mem_contains_pointers ? GC_HEADER_POINTERS : 0) |
+	                             (local ? GC_HEADER_LOCAL : 0) | (unsigned long) size_class << GC_HEADER_CLASS_SHIFT |
+	                             (unsigned long) tag << GC_HEADER_TAG_SHIFT);
+
+	GC_cycles_allocated += size;
+	atomic_fetch_add_explicit(&GC_allocations, 1, memory_order_relaxed);
+	atomic_fetch_add_explicit(&GC_bytes, size, memory_order_relaxed);
+	atomic_fetch_add_explicit(&GC_blockBytes, blockSize, memory_order_relaxed);
 
 	//Only return the required memory.
     //We cast new_memory to a char* for this operation, because
@@ -125,6 +152,38 @@ void* GC_alloc(size_t size, bool mem_contains_pointers){
 	return ((char*)new_memory + sizeof(GC_Header_s));
 }
 
+/**
+ * Allocate space in memory for a new, garbage collected object.
+ *
+ * The newly allocated memory is automatically zero'd.
+ *
+ * @param[in] size The size, in bytes, to allocate
+ * @param[in] mem_contains_pointers If this memory will contain pointers, set to true.
+ * @param[in] site Where the object is being allocated, see GC_SITE
+ * @param[in] type What the object is, or NULL
+ *
+ * @return A pointer to the newly allocated memory, or NULL if memory could not be allocated.
+ */
+void* GC_allocAt(size_t size, bool mem_contains_pointers, const char* site, const char* type){
+    return GC_allocObject(size, mem_contains_pointers, false, site, type);
+}
+
+/**
+ * Allocate an object whose references are only ever taken and dropped by one thread at a time, such as the nodes of
+ * a collection, which only its own operations touch and whose users must not run those concurrently. Its reference
+ * count is updated without atomic instructions; the final decRef of whatever holds it orders it with other threads.
+ *
+ * @param[in] size The size, in bytes, to allocate
+ * @param[in] mem_contains_pointers If this memory will contain pointers, set to true.
+ * @param[in] site Where the object is being allocated, see GC_SITE
+ * @param[in] type What the object is, or NULL
+ *
+ * @return A pointer to the newly allocated memory, or NULL if memory could not be allocated.
+ */
+void* GC_allocLocalAt(size_t size, bool mem_contains_pointers, const char* site, const char* type){
+    return GC_allocObject(size, mem_contains_pointers, true, site, type);
+}
+
 /*
  * Decrements references to a given memory object.
  * If the object has no references left, also garbage collects it.
@@ -138,21 +197,33 @@ void GC_decRef(void* pntr) {
 		return;
 	}
 
-    //We cast pntr to a char* for this operation, because
-    //  pointer arithmetic is forbidden on void pointers,
-    //  and we want to add a number of bytes (i.e. chars)
-    GC_Header_PNTR header = (GC_Header_PNTR) ((char*)pntr - sizeof(GC_Header_s));
+    GC_Header_PNTR header = GC_header(pntr);
 #ifdef DEBUGGINGENABLED
-    log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_DECREFING, header, header->ref_count);
+    log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_DECREFING, header, (int) GC_header_count(atomic_load_explicit(&(header->word), memory_order_relaxed)));
 #endif
-	pthread_mutex_lock(header->mutex);
-	header->ref_count -= 1;
-    pthread_mutex_unlock(header->mutex);
+    unsigned long flags = GC_header_flags(header);
+    if(flags & GC_HEADER_IMMORTAL) {
+        return;
+    }
+    unsigned long old_word;
+    bool possibleRoot = false;
+    if(flags & GC_HEADER_LOCAL) {
+        old_word = atomic_load_explicit(&(header->word), memory_order_relaxed);
+        atomic_store_explicit(&(header->word), old_word - GC_HEADER_REFERENCE, memory_order_relaxed);
+    } else {
+        //Unless this is the last reference, the object may now only be referenced from a garbage cycle (see
+        // GC_cycles.h). It is claimed for buffering first, as once the reference has gone another thread may free it.
+        possibleRoot = (flags & GC_HEADER_POINTERS) && GC_cycles_claim(pntr);
+        //Release, so everything this thread did with the object happens before whichever thread frees it, and
+        // acquire, so the thread freeing it sees all of that. (An acquire fence on the zero transition alone would
+        // do, but costs the same on x86 and isn't understood by ThreadSanitizer.)
+        old_word = atomic_fetch_sub_explicit(&(header->word), GC_HEADER_REFERENCE, memory_order_acq_rel);
+    }
 
     // If the memory is now not pointed to by anything, free it.
-	if(header->ref_count <= 0) {
+	if(GC_header_count(old_word) == 1) {
         //If the memory containers pointers to other objects, decrement their reference counts first.
-		if(header->mem_contains_pointers) {
+		if(flags & GC_HEADER_POINTERS) {
             //This is done by casting to a GC_Container_PNTR and calling the first field, the decRef method.
 			GC_Container_PNTR thisMem = (GC_Container_PNTR) pntr;
 			thisMem->decRef(pntr);
@@ -160,11 +231,34 @@ void GC_decRef(void* pntr) {
 			log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, "Decrementing contained pointers");
 #endif
 		}
-		GC_free(pntr);
+		if(possibleRoot || GC_cycles_release(header)) {
+			GC_free(pntr);
+		}
+	} else if(possibleRoot) {
+		GC_cycles_buffer(pntr);
 	}
 
 }
 
+/*
+ * Reads the reference count of memory referenced by pntr.
+ *
+ * Other threads may change the count as soon as it has been read, so a count of 1 only means the caller's
+ * reference is the only one if no other thread could be about to take a new reference.
+ *
+ * @param[in] pntr The memory location to read the reference count of.
+ * @return The number of references to the memory, 0 for NULL, or UINT_MAX if it is immortal (see GC_makeImmortal).
+ */
+unsigned GC_getRef(void *pntr) {
+    if(pntr==NULL){
+        return 0;
+    }
+
+    //Acquire, so a caller finding itself the only holder sees everything done by those that let go.
+    unsigned long word = atomic_load_explicit(&(GC_header(pntr)->word), memory_order_acquire);
+    return (word & GC_HEADER_IMMORTAL) ? UINT_MAX : (unsigned) GC_header_count(word);
+}
+
 /*
  * Increments reference count for memory referenced by pntr.
  *
@@ -176,16 +270,35 @@ void GC_incRef(void *pntr) {
         return;
     }
 
-    //We cast pntr to a char* for this operation, because
-    //  pointer arithmetic is forbidden on void pointers,
-    //  and we want to add a number of bytes (i.e. chars)
-    GC_Header_PNTR header = (GC_Header_PNTR) ((char*)pntr - sizeof(GC_Header_s));
+    GC_Header_PNTR header = GC_header(pntr);
 #ifdef DEBUGGINGENABLED
-    log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_INCREFING, header, header->ref_count);
+    log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_INCREFING, header, (int) GC_header_count(atomic_load_explicit(&(header->word), memory_order_relaxed)));
 #endif
-    pthread_mutex_lock(header->mutex);
-    header->ref_count += 1;
-    pthread_mutex_unlock(header->mutex);
+    //A new reference can only be taken through an existing one, so nothing needs ordering here.
+    unsigned long flags = GC_header_flags(header);
+    if(flags & GC_HEADER_IMMORTAL) {
+        return;
+    }
+    if(flags & GC_HEADER_LOCAL) {
+        atomic_store_explicit(&(header->word), atomic_load_explicit(&(header->word), memory_order_relaxed) +
+                                               GC_HEADER_REFERENCE, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&(header->word), GC_HEADER_REFERENCE, memory_order_relaxed);
+    }
+}
+
+/**
+ * Keep an object for the rest of the program: from now on it is never freed, and references to it aren't counted, so
+ * threads can share it without contending for its header. As it may then be anywhere, nothing may change it.
+ *
+ * @param[in] pntr An object allocated by GC_alloc, not GC_allocLocal, which only the caller holds a reference to
+ */
+void GC_makeImmortal(void* pntr) {
+    GC_Header_PNTR header = GC_header(pntr);
+    //Published to other threads by whatever hands the object to them.
+    if(!(atomic_fetch_or_explicit(&(header->word), GC_HEADER_IMMORTAL, memory_order_relaxed) & GC_HEADER_IMMORTAL)) {
+        atomic_fetch_add_explicit(&GC_immortal, 1, memory_order_relaxed);
+    }
 }
 
 /*
@@ -202,11 +315,8 @@ void GC_free(void *pntr){
         return;
 	}
 
-    //We cast pntr to a char* for this operation, because
-    //  pointer arithmetic is forbidden on void pointers,
-    //  and we want to add a number of bytes (i.e. chars)
-	GC_Header_PNTR header = (GC_Header_PNTR) ((char*)pntr - sizeof(GC_Header_s));
-	if(header->ref_count > 0){
+	GC_Header_PNTR header = GC_header(pntr);
+	if(GC_header_count(atomic_load_explicit(&(header->word), memory_order_relaxed)) > 0){
         log_logMessage(ERROR, GARBAGE_COLLECTOR_NAME, "Cannot free memory object that is still referenced.");
 		return;
 	}
@@ -214,7 +324,30 @@ void GC_free(void *pntr){
 #ifdef DEBUGGINGENABLED
     log_logMessage(DEBUG, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_FREEING_BYTES, header);
 #endif
-	free(header);
+	unsigned char size_class = GC_header_sizeClass(header);
+	unsigned int tag = GC_header_tag(header);
+	if(tag != 0) {
+		GC_profile_free(tag, GC_slab_blockSize(header, size_class));
+	}
+	GC_slab_free(header, size_class);
+	atomic_fetch_add_explicit(&GC_frees, 1, memory_order_relaxed);
+}
+
+/**
+ * Read the allocation counters.
+ *
+ * @param[out] stats Totals since the program started
+ */
+void GC_getStats(struct GC_stats* stats) {
+    stats->allocations = atomic_load_explicit(&GC_allocations, memory_order_relaxed);
+    stats->frees = atomic_load_explicit(&GC_frees, memory_order_relaxed);
+    stats->immortal = atomic_load_explicit(&GC_immortal, memory_order_relaxed);
+    stats->bytes = atomic_load_explicit(&GC_bytes, memory_order_relaxed);
+    stats->blockBytes = atomic_load_explicit(&GC_blockBytes, memory_order_relaxed);
+    GC_arena_getSlabs(&(stats->arenaSlabs), &(stats->promoted), &(stats->shared));
+    GC_cycles_getStats(&(stats->cycleObjects), &(stats->cycleBytes));
+    GC_static_getUsage(&(stats->staticBudget), &(stats->staticHighWater), &(stats->staticInUse));
+    stats->mallocs = GC_slab_getMallocs() + stats->arenaSlabs;
 }
 
 /**
@@ -224,9 +357,5 @@ void GC_free(void *pntr){
  * @return True if pointers are contained, False otherwise.
  */
 bool GC_mem_contains_pointers(void *pntr) {
-    //We cast pntr to a char* for this operation, because
-    //  pointer arithmetic is forbidden on void pointers,
-    //  and we want to add a number of bytes (i.e. chars)
-    GC_Header_PNTR header = (GC_Header_PNTR) ((char*)pntr - sizeof(GC_Header_s));
-    return header->mem_contains_pointers;
+    return GC_header_flags(GC_header(pntr)) & GC_HEADER_POINTERS;
 }
@@ -27,21 +27,60 @@
 #ifndef CVM_GC_MEM_PRIVATE_H
 #define CVM_GC_MEM_PRIVATE_H
 
+#include <stdatomic.h>
 #include "GC_mem.h"
 
-// mutex to serialise memory operation
-extern pthread_mutex_t* GC_mutex;
-
+// An object's header is one word: its reference count, above a bit marking it immortal (see GC_makeImmortal), the
+// object's heap profiler tag (see GC_profile.h) and a byte holding its flags and the slab size class it came from (see
+// GC_slab.h). Taking or dropping a reference adds or subtracts GC_HEADER_REFERENCE, which leaves the rest as it is,
+// so the count and the flags share the word without sharing updates.
 typedef struct GC_Header {
-    unsigned long ref_count; // 64-bit architecture
-    bool mem_contains_pointers;
-    pthread_mutex_t* mutex;       // pntr to mutex to serialise memory operations
+    atomic_ulong word;            // updated atomically, unless the object is local (see GC_allocLocal)
 } GC_Header_s, *GC_Header_PNTR;
 
+#define GC_HEADER_POINTERS 0x01ul       // the object contains pointers
+#define GC_HEADER_LOCAL 0x02ul          // allocated by GC_allocLocal
+#define GC_HEADER_BUFFERED 0x04ul       // cycle collector flags, see GC_cycles.h
+#define GC_HEADER_FREED 0x08ul
+#define GC_HEADER_CLASS_SHIFT 4         // the size class takes the rest of the low byte
+#define GC_HEADER_TAG_SHIFT 8
+#define GC_HEADER_TAG_MASK 0xfffful
+#define GC_HEADER_IMMORTAL (1ul << 24)  // never freed, and its references not counted
+#define GC_HEADER_COUNT_SHIFT 25
+#define GC_HEADER_REFERENCE (1ul << GC_HEADER_COUNT_SHIFT)
+
+static inline GC_Header_PNTR GC_header(void* pntr) {
+    //We cast pntr to a char* for this operation, because
+    //  pointer arithmetic is forbidden on void pointers,
+    //  and we want to add a number of bytes (i.e. chars)
+    return (GC_Header_PNTR) ((char*) pntr - sizeof(GC_Header_s));
+}
+
+// Reference count held in a header word.
+static inline unsigned long GC_header_count(unsigned long word) {
+    return word >> GC_HEADER_COUNT_SHIFT;
+}
+
+// The flags, size class and tag, which (but for the cycle collector's flags) never change once the object is
+// allocated.
+static inline unsigned long GC_header_flags(GC_Header_PNTR header) {
+    return atomic_load_explicit(&(header->word), memory_order_relaxed) & (GC_HEADER_REFERENCE - 1);
+}
+
+static inline unsigned char GC_header_sizeClass(GC_Header_PNTR header) {
+    return (unsigned char) ((GC_header_flags(header) >> GC_HEADER_CLASS_SHIFT) & 0xf);
+}
+
+static inline unsigned int GC_header_tag(GC_Header_PNTR header) {
+    return (unsigned int) ((GC_header_flags(header) >> GC_HEADER_TAG_SHIFT) & GC_HEADER_TAG_MASK);
+}
+
 // Every object crated by the garbage collector must have a function that decrements its reference count
 // and garbage collects when at 0 references. It must be pointed to by the first field.
 typedef struct GC_Container {
     decRefFunc_t decRef;
 } GC_Container_s, *GC_Container_PNTR;
 
+void GC_free(void* pntr);
+
 #endif //CVM_GC_MEM_PRIVATE_H
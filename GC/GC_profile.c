@@ -0,0 +1,331 @@
+/*
+ * @file GC_profile.c
+ *
+ * Heap profiling: where memory goes, by allocation site and by component.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "GC_profile.h"
+
+#define GC_PROFILE_NAME 32      // longest component name kept, with its terminator
+#define GC_PROFILE_CACHE 64     // sites each thread remembers its tag for, a power of 2
+
+// Allocations counted against a site or component. Nothing is ordered by them, so they are updated relaxed.
+struct GC_profile_counts {
+    atomic_ulong allocations;
+    atomic_ulong bytes;         // allocated, in blocks with their headers
+    atomic_ulong live;          // of those, not yet freed
+    atomic_ulong peak;          // most that were live at once
+};
+
+// Sites, by the address of their name (a literal, one per call site), linearly probed. A slot's type is written
+// before its site is published, and neither changes after.
+static struct GC_profile_site {
+    _Atomic(const char*) site;
+    const char* type;
+    struct GC_profile_counts counts;
+} GC_profile_sites[GC_PROFILE_MAX_SITES];
+
+// Components, by name, in the order they were first seen. The first is the VM's own threads'.
+static struct GC_profile_component {
+    char name[GC_PROFILE_NAME];
+    struct GC_profile_counts counts;
+} GC_profile_components[GC_PROFILE_MAX_COMPONENTS] = { { .name = "(VM)" } };
+static unsigned int GC_profile_componentCount = 1;
+
+// (site, component) pairs, linearly probed by their key: site slot * GC_PROFILE_MAX_COMPONENTS + component + 1. A
+// pair's tag is its slot + 1.
+static struct GC_profile_pair {
+    atomic_uint key;
+    atomic_ulong bytes;
+} GC_profile_pairs[GC_PROFILE_MAX_TAGS];
+
+// Taken to add sites, components or pairs, and to write them out.
+static pthread_mutex_t GC_profile_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static atomic_bool GC_profile_enabled = false;
+static struct timespec GC_profile_started;
+
+static _Thread_local unsigned int GC_profile_component = 0;    // the component the thread allocates for
+static _Thread_local struct GC_profile_cached {
+    const char* site;
+    unsigned int tag;
+} GC_profile_cache[GC_PROFILE_CACHE];                          // tags of the thread's recent sites, for it
+
+static inline unsigned int GC_profile_hash(uintptr_t key) {
+    return (unsigned int) (key >> 3) * 2654435761u;
+}
+
+void GC_profile_enable(void) {
+    clock_gettime(CLOCK_MONOTONIC, &GC_profile_started);
+    atomic_store(&GC_profile_enabled, true);
+}
+
+bool GC_profile_isEnabled(void) {
+    return atomic_load_explicit(&GC_profile_enabled, memory_order_relaxed);
+}
+
+/**
+ * Count what the calling thread allocates from now on against a component. Components with the same name (several
+ * instances of one component) are counted together.
+ *
+ * @param[in] name The component's name, or NULL for the VM's own
+ */
+void GC_profile_enterComponent(const char* name) {
+    unsigned int component = 0;
+    if(name != NULL) {
+        pthread_mutex_lock(&GC_profile_lock);
+        for(component = 1; component < GC_profile_componentCount; component++) {
+            if(strncmp(GC_profile_components[component].name, name, GC_PROFILE_NAME - 1) == 0) {
+                break;
+            }
+        }
+        if(component == GC_profile_componentCount) {
+            if(component < GC_PROFILE_MAX_COMPONENTS) {
+                strncpy(GC_profile_components[component].name, name, GC_PROFILE_NAME - 1);
+                GC_profile_componentCount++;
+            } else {
+                component = 0;
+            }
+        }
+        pthread_mutex_unlock(&GC_profile_lock);
+    }
+    GC_profile_component = component;
+    memset(GC_profile_cache, 0, sizeof(GC_profile_cache));
+}
+
+/**
+ * Find a site's slot, adding it if it is new.
+ *
+ * @return The slot, or GC_PROFILE_MAX_SITES if the table is full.
+ */
+static unsigned int GC_profile_findSite(const char* site, const char* type) {
+    unsigned int start = GC_profile_hash((uintptr_t) site) & (GC_PROFILE_MAX_SITES - 1);
+    for(int locked = 0; locked < 2; locked++) {
+        unsigned int slot = start;
+        for(unsigned int i = 0; i < GC_PROFILE_MAX_SITES; i++, slot = (slot + 1) & (GC_PROFILE_MAX_SITES - 1)) {
+            const char* found = atomic_load_explicit(&(GC_profile_sites[slot].site), memory_order_acquire);
+            if(found == site) {
+                if(locked) {
+                    pthread_mutex_unlock(&GC_profile_lock);
+                }
+                return slot;
+            }
+            if(found == NULL) {
+                if(locked) {
+                    GC_profile_sites[slot].type = type;
+                    atomic_store_explicit(&(GC_profile_sites[slot].site), site, memory_order_release);
+                    pthread_mutex_unlock(&GC_profile_lock);
+                    return slot;
+                }
+                break;
+            }
+        }
+        if(!locked) {
+            //Not there: look again with the lock held, adding it unless another thread just has.
+            pthread_mutex_lock(&GC_profile_lock);
+        }
+    }
+    pthread_mutex_unlock(&GC_profile_lock);
+    return GC_PROFILE_MAX_SITES;
+}
+
+/**
+ * Find a pair's tag, adding it if it is new.
+ *
+ * @return The tag, or 0 if the table is full.
+ */
+static unsigned int GC_profile_findPair(unsigned int key) {
+    unsigned int start = GC_profile_hash((uintptr_t) key << 3) & (GC_PROFILE_MAX_TAGS - 1);
+    for(int locked = 0; locked < 2; locked++) {
+        unsigned int slot = start;
+        for(unsigned int i = 0; i < GC_PROFILE_MAX_TAGS; i++, slot = (slot + 1) & (GC_PROFILE_MAX_TAGS - 1)) {
+            unsigned int found = atomic_load_explicit(&(GC_profile_pairs[slot].key), memory_order_relaxed);
+            if(found == key) {
+                if(locked) {
+                    pthread_mutex_unlock(&GC_profile_lock);
+                }
+                return slot + 1;
+            }
+            if(found == 0) {
+                if(locked) {
+                    atomic_store_explicit(&(GC_profile_pairs[slot].key), key, memory_order_relaxed);
+                    pthread_mutex_unlock(&GC_profile_lock);
+                    return slot + 1;
+                }
+                break;
+            }
+        }
+        if(!locked) {
+            pthread_mutex_lock(&GC_profile_lock);
+        }
+    }
+    pthread_mutex_unlock(&GC_profile_lock);
+    return 0;
+}
+
+/**
+ * Tag an allocation by the calling thread.
+ *
+ * @param[in] site Where it was allocated, see GC_SITE
+ * @param[in] type What was allocated, or NULL to go by the site alone
+ * @return The tag to count the object's block with, or 0 if it isn't to be counted.
+ */
+unsigned int GC_profile_tag(const char* site, const char* type) {
+    if(!atomic_load_explicit(&GC_profile_enabled, memory_order_relaxed)) {
+        return 0;
+    }
+    struct GC_profile_cached* cached = &GC_profile_cache[GC_profile_hash((uintptr_t) site) & (GC_PROFILE_CACHE - 1)];
+    if(cached->site == site) {
+        return cached->tag;
+    }
+    unsigned int slot = GC_profile_findSite(site, type);
+    unsigned int tag = 0;
+    if(slot < GC_PROFILE_MAX_SITES) {
+        tag = GC_profile_findPair(slot * GC_PROFILE_MAX_COMPONENTS + GC_profile_component + 1);
+    }
+    *cached = (struct GC_profile_cached) { site, tag };
+    return tag;
+}
+
+static void GC_profile_add(struct GC_profile_counts* counts, size_t bytes) {
+    atomic_fetch_add_explicit(&(counts->allocations), 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&(counts->bytes), bytes, memory_order_relaxed);
+    unsigned long live = atomic_fetch_add_explicit(&(counts->live), bytes, memory_order_relaxed) + bytes;
+    unsigned long peak = atomic_load_explicit(&(counts->peak), memory_order_relaxed);
+    while(live > peak && !atomic_compare_exchange_weak_explicit(&(counts->peak), &peak, live, memory_order_relaxed,
+                                                                memory_order_relaxed));
+}
+
+void GC_profile_alloc(unsigned int tag, size_t bytes) {
+    unsigned int key = atomic_load_explicit(&(GC_profile_pairs[tag - 1].key), memory_order_relaxed) - 1;
+    atomic_fetch_add_explicit(&(GC_profile_pairs[tag - 1].bytes), bytes, memory_order_relaxed);
+    GC_profile_add(&(GC_profile_sites[key / GC_PROFILE_MAX_COMPONENTS].counts), bytes);
+    GC_profile_add(&(GC_profile_components[key % GC_PROFILE_MAX_COMPONENTS].counts), bytes);
+}
+
+void GC_profile_free(unsigned int tag, size_t bytes) {
+    unsigned int key = atomic_load_explicit(&(GC_profile_pairs[tag - 1].key), memory_order_relaxed) - 1;
+    atomic_fetch_sub_explicit(&(GC_profile_sites[key / GC_PROFILE_MAX_COMPONENTS].counts.live), bytes,
+                              memory_order_relaxed);
+    atomic_fetch_sub_explicit(&(GC_profile_components[key % GC_PROFILE_MAX_COMPONENTS].counts.live), bytes,
+                              memory_order_relaxed);
+}
+
+// Name of a site: its type, if it has one, and its file (without directories) and line.
+static void GC_profile_siteName(unsigned int slot, char separator, char* name, size_t size) {
+    const char* site = atomic_load_explicit(&(GC_profile_sites[slot].site), memory_order_acquire);
+    const char* file = site;
+    for(const char* c = site; *c != '\0'; c++) {
+        if(*c == '/') {
+            file = c + 1;
+        }
+    }
+    if(GC_profile_sites[slot].type != NULL) {
+        snprintf(name, size, "%s%c%s", GC_profile_sites[slot].type, separator, file);
+    } else {
+        snprintf(name, size, "%s", file);
+    }
+}
+
+static void GC_profile_dumpCounts(FILE* out, const char* name, struct GC_profile_counts* counts, double seconds) {
+    unsigned long allocations = atomic_load_explicit(&(counts->allocations), memory_order_relaxed);
+    fprintf(out, "%-40s %12lu %12.0f %14lu %12lu %12lu\n", name, allocations,
+            seconds > 0 ? allocations / seconds : 0.0, atomic_load_explicit(&(counts->bytes), memory_order_relaxed),
+            atomic_load_explicit(&(counts->live), memory_order_relaxed),
+            atomic_load_explicit(&(counts->peak), memory_order_relaxed));
+}
+
+static int GC_profile_byPeak(const void* a, const void* b) {
+    unsigned long peakA = atomic_load_explicit(&(GC_profile_sites[*(const unsigned int*) a].counts.peak),
+                                               memory_order_relaxed);
+    unsigned long peakB = atomic_load_explicit(&(GC_profile_sites[*(const unsigned int*) b].counts.peak),
+                                               memory_order_relaxed);
+    return (peakA < peakB) - (peakA > peakB);
+}
+
+/**
+ * Write tables of allocations by site (largest peak first) and by component, in bytes of blocks with their headers.
+ *
+ * @param[in] out Where to write them.
+ */
+void GC_profile_dump(FILE* out) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double seconds = (now.tv_sec - GC_profile_started.tv_sec) + (now.tv_nsec - GC_profile_started.tv_nsec) / 1e9;
+
+    static unsigned int order[GC_PROFILE_MAX_SITES];
+    unsigned int sites = 0;
+    pthread_mutex_lock(&GC_profile_lock);
+    for(unsigned int slot = 0; slot < GC_PROFILE_MAX_SITES; slot++) {
+        if(atomic_load_explicit(&(GC_profile_sites[slot].site), memory_order_acquire) != NULL) {
+            order[sites++] = slot;
+        }
+    }
+    qsort(order, sites, sizeof(order[0]), GC_profile_byPeak);
+
+    fprintf(out, "Heap profile (bytes in blocks, with headers):\n");
+    fprintf(out, "%-40s %12s %12s %14s %12s %12s\n", "type or site", "allocations", "per second", "bytes", "live",
+            "peak");
+    char name[64];
+    for(unsigned int i = 0; i < sites; i++) {
+        GC_profile_siteName(order[i], ' ', name, sizeof(name));
+        GC_profile_dumpCounts(out, name, &(GC_profile_sites[order[i]].counts), seconds);
+    }
+    fprintf(out, "%-40s %12s %12s %14s %12s %12s\n", "component", "allocations", "per second", "bytes", "live",
+            "peak");
+    for(unsigned int component = 0; component < GC_profile_componentCount; component++) {
+        GC_profile_dumpCounts(out, GC_profile_components[component].name,
+                              &(GC_profile_components[component].counts), seconds);
+    }
+    pthread_mutex_unlock(&GC_profile_lock);
+    fflush(out);
+}
+
+/**
+ * Write the bytes allocated by each (site, component) pair as a collapsed stack: component;type;site bytes.
+ *
+ * @param[in] out Where to write them.
+ */
+void GC_profile_dumpCollapsed(FILE* out) {
+    char name[64];
+    pthread_mutex_lock(&GC_profile_lock);
+    for(unsigned int slot = 0; slot < GC_PROFILE_MAX_TAGS; slot++) {
+        unsigned int key = atomic_load_explicit(&(GC_profile_pairs[slot].key), memory_order_relaxed);
+        unsigned long bytes = atomic_load_explicit(&(GC_profile_pairs[slot].bytes), memory_order_relaxed);
+        if(key == 0 || bytes == 0) {
+            continue;
+        }
+        GC_profile_siteName((key - 1) / GC_PROFILE_MAX_COMPONENTS, ';', name, sizeof(name));
+        fprintf(out, "%s;%s %lu\n", GC_profile_components[(key - 1) % GC_PROFILE_MAX_COMPONENTS].name, name, bytes);
+    }
+    pthread_mutex_unlock(&GC_profile_lock);
+    fflush(out);
+}
@@ -0,0 +1,67 @@
+/*
+ * @file GC_profile.h
+ *
+ * Heap profiling: where memory goes, by allocation site and by component.
+ *
+ * Every GC_alloc names its call site (GC_SITE), and GC_allocType a type as well. Once the profiler is enabled, each
+ * object allocated is tagged, in its header, with the pair of its site and the component whose thread allocated it,
+ * and its block (with header, see GC_slab.h) is counted against both until it is freed. For each site and each
+ * component the profiler keeps the allocations and bytes allocated, the bytes still live, and the most that were
+ * live at once; for each pair, the bytes allocated, which are written out as collapsed stacks
+ * (component;type;site bytes) for flamegraph.pl and the tools that read its input.
+ *
+ * Objects allocated before the profiler was enabled, or once GC_PROFILE_MAX_TAGS pairs have been seen, are untagged
+ * and go uncounted.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_GC_PROFILE_H
+#define CVM_GC_PROFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#define GC_PROFILE_MAX_SITES 1024       // allocation sites recorded, a power of 2
+#define GC_PROFILE_MAX_COMPONENTS 64    // component names recorded; further ones are counted as the VM's
+#define GC_PROFILE_MAX_TAGS 4096        // (site, component) pairs, a power of 2 that fits GC_HEADER_TAG_MASK
+
+// Start profiling allocations from now on. Off unless turned on at startup.
+void GC_profile_enable(void);
+bool GC_profile_isEnabled(void);
+
+// Count what the calling thread allocates from now on against a component, by name (or the VM's, for NULL).
+void GC_profile_enterComponent(const char* name);
+
+// Tag for an allocation from a site by the calling thread, or 0 if it isn't to be counted.
+unsigned int GC_profile_tag(const char* site, const char* type);
+// Count a block of bytes allocated, or freed, with a tag.
+void GC_profile_alloc(unsigned int tag, size_t bytes);
+void GC_profile_free(unsigned int tag, size_t bytes);
+
+// Write tables of the sites and components that have allocated anything.
+void GC_profile_dump(FILE* out);
+// Write the bytes allocated as collapsed stacks, one line per (site, component) pair.
+void GC_profile_dumpCollapsed(FILE* out);
+
+#endif //CVM_GC_PROFILE_H
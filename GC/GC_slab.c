@@ -0,0 +1,124 @@
+/*
+ * @file GC_slab.c
+ *
+ * Size-class slab allocator for the garbage collector's small objects.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <malloc.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "GC_slab.h"
+#include "GC_arena.h"
+#include "GC_static.h"
+
+// Block sizes, in bytes including the GC header. Multiples of 8, so objects after the 8 byte header are aligned for
+// anything but long doubles; the smallest holds a header and a number or pointer.
+static const size_t GC_slab_sizes[GC_SLAB_CLASSES] = { 16, 24, 32, 40, 48, 64, 80, 96, 128, 160, 192, 256, 384, 512 };
+
+// size class for each size up to GC_SLAB_MAX, in 8 byte steps
+static unsigned char GC_slab_classFor[GC_SLAB_MAX / 8 + 1];
+
+static atomic_bool GC_slab_enabled = true;
+static atomic_ulong GC_slab_mallocs;
+
+/**
+ * Set up the size classes. Must be called (once) before anything is allocated.
+ */
+void GC_slab_init(void) {
+    unsigned int class = 1;
+    for(unsigned int i = 0; i <= GC_SLAB_MAX / 8; i++) {
+        while(GC_slab_sizes[class - 1] < i * 8) {
+            class++;
+        }
+        GC_slab_classFor[i] = (unsigned char) class;
+    }
+}
+
+/**
+ * Allocate a zeroed block.
+ *
+ * @param[in] size Bytes needed, including the GC header
+ * @param[out] size_class Where to store the size class to pass to GC_slab_free
+ * @return The block, or NULL if memory could not be allocated.
+ */
+void* GC_slab_alloc(size_t size, unsigned char* size_class) {
+    if(GC_static_isEnabled()) {
+        return GC_static_alloc(size, size_class);
+    }
+    if(size > GC_SLAB_MAX || !atomic_load_explicit(&GC_slab_enabled, memory_order_relaxed)) {
+        *size_class = GC_SLAB_LARGE;
+        atomic_fetch_add_explicit(&GC_slab_mallocs, 1, memory_order_relaxed);
+        return calloc(1, size);
+    }
+
+    GC_arena_PNTR arena = GC_arena_current();
+    if(arena == NULL) {
+        return NULL;
+    }
+    *size_class = GC_slab_classOf(size);
+    return GC_arena_alloc(arena, *size_class, size);
+}
+
+/**
+ * Free a block allocated by GC_slab_alloc.
+ *
+ * @param[in] block The block
+ * @param[in] size_class The size class GC_slab_alloc gave it
+ */
+void GC_slab_free(void* block, unsigned char size_class) {
+    if(GC_static_contains(block)) {
+        GC_static_free(block, size_class);
+        return;
+    }
+    if(size_class == GC_SLAB_LARGE) {
+        free(block);
+        return;
+    }
+    GC_arena_free(block, size_class);
+}
+
+unsigned char GC_slab_classOf(size_t size) {
+    return GC_slab_classFor[(size + 7) / 8];
+}
+
+size_t GC_slab_classSize(unsigned char size_class) {
+    return GC_slab_sizes[size_class - 1];
+}
+
+size_t GC_slab_blockSize(void* block, unsigned char size_class) {
+    if(GC_static_contains(block)) {
+        return GC_static_blockSize(block, size_class);
+    }
+    return size_class == GC_SLAB_LARGE ? malloc_usable_size(block) : GC_slab_classSize(size_class);
+}
+
+void GC_slab_setEnabled(bool enabled) {
+    atomic_store(&GC_slab_enabled, enabled);
+}
+
+unsigned long GC_slab_getMallocs(void) {
+    return atomic_load_explicit(&GC_slab_mallocs, memory_order_relaxed);
+}
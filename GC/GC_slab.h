@@ -0,0 +1,61 @@
+/*
+ * @file GC_slab.h
+ *
+ * Size-class slab allocator for the garbage collector's small objects.
+ *
+ * Blocks (an object and its GC header) of up to GC_SLAB_MAX bytes are rounded up to one of a few size classes and
+ * carved out of slabs belonging to the allocating thread's arena or cache (see GC_arena.h): a slab is handed out a
+ * block at a time by bumping a pointer, and freed blocks go on a per-class free list threaded through the blocks
+ * themselves, to be handed out again before the slab is bumped further. Larger blocks are malloc'd individually.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_GC_SLAB_H
+#define CVM_GC_SLAB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define GC_SLAB_MAX 512         // largest block served from a slab
+#define GC_SLAB_LARGE 0         // size class of blocks malloc'd individually
+#define GC_SLAB_CLASSES 14      // size classes served from slabs, numbered from 1 (up to 15, see GC_Header_s)
+
+void GC_slab_init(void);
+
+// Allocate a zeroed block of size bytes, storing the size class it must be freed with in *size_class. Blocks come from
+// the static heap while it is enabled (see GC_static.h), and are freed back to wherever they came from.
+void* GC_slab_alloc(size_t size, unsigned char* size_class);
+void GC_slab_free(void* block, unsigned char size_class);
+
+// Size class for blocks of up to GC_SLAB_MAX bytes, and the bytes in each block of a class.
+unsigned char GC_slab_classOf(size_t size);
+size_t GC_slab_classSize(unsigned char size_class);
+// Bytes taken by a block: its class's size, or what malloc (or the static heap) gave it.
+size_t GC_slab_blockSize(void* block, unsigned char size_class);
+
+// Serve every block from malloc instead (or go back to slabs). Blocks already allocated are freed as they were made.
+void GC_slab_setEnabled(bool enabled);
+// Number of times malloc has been called for large blocks (or every block, while slabs are disabled).
+unsigned long GC_slab_getMallocs(void);
+
+#endif //CVM_GC_SLAB_H
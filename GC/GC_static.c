@@ -0,0 +1,180 @@
+/*
+ * @file GC_static.c
+ *
+ * A static heap: a fixed budget of memory that every object is allocated from once it is enabled.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include "GC_static.h"
+#include "GC_slab.h"
+#include "../Logger/Logger.h"
+#include "Strings.h"
+
+// Large blocks are preceded by their size, in a word that keeps them 8 byte aligned.
+#define GC_STATIC_SIZE_WORD sizeof(size_t)
+
+static _Alignas(16) unsigned char GC_static_heap[GC_STATIC_HEAP_SIZE];
+
+// Everything below is only touched with the lock held, but for the budget, which is set before other threads start.
+static pthread_mutex_t GC_static_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t GC_static_budget = 0;         // 0 while the static heap isn't in use
+static size_t GC_static_top = 0;            // bytes bumped out of the heap so far, its high-water mark
+static size_t GC_static_inUse = 0;          // of those, bytes in blocks not yet freed
+static void* GC_static_freed[GC_SLAB_CLASSES + 1];  // freed blocks by size class, each holding a pointer to the next
+static void* GC_static_freedLarge = NULL;   // freed large blocks, likewise
+
+static inline size_t GC_static_largeSize(void* block) {
+    return *(size_t*) ((unsigned char*) block - GC_STATIC_SIZE_WORD);
+}
+
+/**
+ * Set the budget objects are allocated within from now on. Objects allocated before are freed as they were made.
+ *
+ * @param[in] budget Bytes objects may take up, with their headers and the sizes in front of large blocks
+ * @return false if the budget is larger than the heap set aside for it.
+ */
+bool GC_static_enable(size_t budget) {
+    if(budget == 0 || budget > GC_STATIC_HEAP_SIZE) {
+        return false;
+    }
+    GC_static_budget = budget;
+    return true;
+}
+
+bool GC_static_isEnabled(void) {
+    return GC_static_budget != 0;
+}
+
+bool GC_static_contains(void* block) {
+    return (uintptr_t) block >= (uintptr_t) GC_static_heap &&
+           (uintptr_t) block < (uintptr_t) GC_static_heap + GC_STATIC_HEAP_SIZE;
+}
+
+/**
+ * Give up on an allocation the budget can't hold. Doesn't return.
+ */
+static void GC_static_exhausted(size_t size) {
+    size_t top = GC_static_top;
+    size_t inUse = GC_static_inUse;
+    pthread_mutex_unlock(&GC_static_lock);
+    log_logMessage(FATAL, GARBAGE_COLLECTOR_NAME, GARBAGE_COLLECTOR_STATIC_EXHAUSTED, size, GC_static_budget, top,
+                   inUse);
+    exit(EXITCODE_OUT_OF_MEMORY);
+}
+
+// Take the smallest freed large block that holds size bytes off the list. NULL if there is none.
+static void* GC_static_reuseLarge(size_t size) {
+    void** best = NULL;
+    for(void** link = &GC_static_freedLarge; *link != NULL; link = (void**) *link) {
+        size_t blockSize = GC_static_largeSize(*link);
+        if(blockSize >= size && (best == NULL || blockSize < GC_static_largeSize(*best))) {
+            best = link;
+        }
+    }
+    if(best == NULL) {
+        return NULL;
+    }
+    void* block = *best;
+    *best = *(void**) block;
+    return block;
+}
+
+/**
+ * Allocate a zeroed block from the static heap, exiting the VM if the budget can't hold it.
+ *
+ * @param[in] size Bytes needed, including the GC header
+ * @param[out] size_class Where to store the size class to pass to GC_static_free
+ * @return The block.
+ */
+void* GC_static_alloc(size_t size, unsigned char* size_class) {
+    size_t blockSize;
+    void* block;
+    pthread_mutex_lock(&GC_static_lock);
+    if(size <= GC_SLAB_MAX) {
+        *size_class = GC_slab_classOf(size);
+        blockSize = GC_slab_classSize(*size_class);
+        block = GC_static_freed[*size_class];
+        if(block != NULL) {
+            GC_static_freed[*size_class] = *(void**) block;
+        } else if(blockSize <= GC_static_budget - GC_static_top) {
+            block = GC_static_heap + GC_static_top;
+            GC_static_top += blockSize;
+        } else {
+            GC_static_exhausted(size);
+        }
+    } else {
+        *size_class = GC_SLAB_LARGE;
+        block = GC_static_reuseLarge(size);
+        if(block != NULL) {
+            blockSize = GC_static_largeSize(block);
+        } else {
+            blockSize = (size + GC_STATIC_SIZE_WORD - 1) & ~(GC_STATIC_SIZE_WORD - 1);
+            if(blockSize + GC_STATIC_SIZE_WORD > GC_static_budget - GC_static_top) {
+                GC_static_exhausted(size);
+            }
+            block = GC_static_heap + GC_static_top + GC_STATIC_SIZE_WORD;
+            *(size_t*) ((unsigned char*) block - GC_STATIC_SIZE_WORD) = blockSize;
+            GC_static_top += blockSize + GC_STATIC_SIZE_WORD;
+        }
+    }
+    GC_static_inUse += blockSize;
+    pthread_mutex_unlock(&GC_static_lock);
+
+    memset(block, 0, size);
+    return block;
+}
+
+/**
+ * Put a block allocated by GC_static_alloc back, for the next allocation of its size class to take.
+ *
+ * @param[in] block The block
+ * @param[in] size_class The size class GC_static_alloc gave it
+ */
+void GC_static_free(void* block, unsigned char size_class) {
+    pthread_mutex_lock(&GC_static_lock);
+    if(size_class == GC_SLAB_LARGE) {
+        GC_static_inUse -= GC_static_largeSize(block);
+        *(void**) block = GC_static_freedLarge;
+        GC_static_freedLarge = block;
+    } else {
+        GC_static_inUse -= GC_slab_classSize(size_class);
+        *(void**) block = GC_static_freed[size_class];
+        GC_static_freed[size_class] = block;
+    }
+    pthread_mutex_unlock(&GC_static_lock);
+}
+
+size_t GC_static_blockSize(void* block, unsigned char size_class) {
+    return size_class == GC_SLAB_LARGE ? GC_static_largeSize(block) : GC_slab_classSize(size_class);
+}
+
+void GC_static_getUsage(unsigned long* budget, unsigned long* highWater, unsigned long* inUse) {
+    pthread_mutex_lock(&GC_static_lock);
+    *budget = GC_static_budget;
+    *highWater = GC_static_top;
+    *inUse = GC_static_inUse;
+    pthread_mutex_unlock(&GC_static_lock);
+}
@@ -0,0 +1,61 @@
+/*
+ * @file GC_static.h
+ *
+ * A static heap: a fixed budget of memory, set aside at build time, that every object is allocated from once it is
+ * enabled, instead of malloc, as it would be on a mote with a few KB of RAM.
+ *
+ * Blocks are bumped out of the heap in the slab size classes (see GC_slab.h), and freed blocks are kept on a list for
+ * their class, to be handed out again before the heap grows. Larger blocks carry their size in front of them, and
+ * are reused by the smallest freed one that fits. Nothing is coalesced or moved, so the heap's high-water mark, the
+ * most of it that has been used, is what the program needs to run in the same order again. An allocation that would
+ * take it past its budget logs how far it got and exits the VM with EXITCODE_OUT_OF_MEMORY.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_GC_STATIC_H
+#define CVM_GC_STATIC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifndef GC_STATIC_HEAP_SIZE
+#define GC_STATIC_HEAP_SIZE 16777216    // bytes set aside for the static heap, the largest budget it can be given
+#endif
+
+// Allocate every object from the static heap from now on, up to budget bytes. Must be called before any thread but
+// the caller's is started. False if the budget is larger than GC_STATIC_HEAP_SIZE.
+bool GC_static_enable(size_t budget);
+bool GC_static_isEnabled(void);
+
+// Allocate a zeroed block, storing the size class to free it with in *size_class. Exits the VM if it doesn't fit.
+void* GC_static_alloc(size_t size, unsigned char* size_class);
+void GC_static_free(void* block, unsigned char size_class);
+
+// Whether a block is in the static heap, and the bytes it takes up there.
+bool GC_static_contains(void* block);
+size_t GC_static_blockSize(void* block, unsigned char size_class);
+
+// The budget (0 unless enabled), the heap's high-water mark, and the bytes of blocks in use.
+void GC_static_getUsage(unsigned long* budget, unsigned long* highWater, unsigned long* inUse);
+
+#endif //CVM_GC_STATIC_H
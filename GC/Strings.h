@@ -31,6 +31,10 @@
 #define GARBAGE_COLLECTOR_NAME "Garbage Collector"
 #define GARBAGE_COLLECTOR_INITIALISED "GC Subsystem Initialised"
 #define GARBAGE_COLLECTOR_OOM "Could not allocate memory (possibly OOM?)"
+#define GARBAGE_COLLECTOR_CYCLES_FREED "Cycle collector freed %lu objects (%lu bytes)"
+#define GARBAGE_COLLECTOR_CYCLES_REFERENCED "Cycle collector left %p, referenced from outside its cycle after all"
+#define GARBAGE_COLLECTOR_STATIC_EXHAUSTED "Static heap exhausted: %zu bytes don't fit in the budget of %zu (%zu used, " \
+                                           "%zu in blocks still live)"
 #define GARBAGE_COLLECTOR_DECREF_NULL "Ignoring call to decrement NULL pointer references"
 
 #ifdef DEBUGGINGENABLED
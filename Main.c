@@ -29,11 +29,104 @@
  * THE SOFTWARE.
  */
 
+#define _POSIX_C_SOURCE 200809L
+#include <signal.h>
+#include <time.h>
 #include "Main.h"
 #include "Strings.h"
+#include "Channels/channel_stats.h"
+#include "Trace.h"
+#include "GC/GC_profile.h"
+#include "GC/GC_static.h"
 
 char* directory;
 Component_PNTR mainComponent;
+static struct timespec statsStarted;  //!< When recording started, for allocation rates.
+static char* profileFile = NULL;      //!< Where to write the heap profile's collapsed stacks, with -p.
+
+/**
+ * Write whichever of the channel statistics (with the heap's allocation counts), end-to-end latencies, static heap
+ * usage and heap profile are being recorded to stderr, and the heap profile's collapsed stacks to their file.
+ * Registered with atexit when any is.
+ */
+static void main_dumpStats(void) {
+    fflush(stdout);
+    if(channel_stats_isEnabled()) {
+        channel_stats_dump(stderr);
+
+        struct GC_stats heap;
+        GC_getStats(&heap);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double seconds = (now.tv_sec - statsStarted.tv_sec) + (now.tv_nsec - statsStarted.tv_nsec) / 1e9;
+        fprintf(stderr, "Heap: %lu allocations (%.0f/s), %lu frees, %lu immortal, %lu bytes allocated (%lu with headers, "
+                "in their blocks), %lu slabs (%lu outlived their component or thread, %lu of them kept for reuse), %lu "
+                "objects (%lu bytes) freed from garbage cycles\n", heap.allocations,
+                seconds > 0 ? heap.allocations / seconds : 0.0, heap.frees, heap.immortal, heap.bytes, heap.blockBytes,
+                heap.arenaSlabs, heap.promoted, heap.shared, heap.cycleObjects, heap.cycleBytes);
+    }
+    if(Trace_isEnabled()) {
+        Trace_dump(stderr);
+    }
+    if(GC_static_isEnabled()) {
+        struct GC_stats heap;
+        GC_getStats(&heap);
+        fprintf(stderr, "Static heap: %lu of %lu bytes used at most, %lu in blocks still live\n",
+                heap.staticHighWater, heap.staticBudget, heap.staticInUse);
+    }
+    if(GC_profile_isEnabled()) {
+        GC_profile_dump(stderr);
+        FILE* collapsed = fopen(profileFile, "w");
+        if(collapsed != NULL) {
+            GC_profile_dumpCollapsed(collapsed);
+            fclose(collapsed);
+        } else {
+            perror(profileFile);
+        }
+    }
+}
+
+/**
+ * Wait for signals asking for the statistics: SIGUSR1 dumps them, SIGINT and SIGTERM exit (dumping them on the way
+ * out).
+ * @param[in] signals The set of signals to wait for, blocked in every thread
+ */
+static void* main_statsSignals(void* signals) {
+    int signal;
+    while(sigwait(signals, &signal) == 0) {
+        if(signal == SIGUSR1) {
+            main_dumpStats();
+        } else {
+            exit(128 + signal);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Arrange for the statistics to be dumped on request and at exit. Must be called before any other thread is started,
+ * so they all inherit the blocked signals.
+ */
+static void main_startStats(void) {
+    static sigset_t signals;
+    static bool started = false;
+    if(started) {
+        return;
+    }
+    started = true;
+    clock_gettime(CLOCK_MONOTONIC, &statsStarted);
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    pthread_t signalThread;
+    pthread_create(&signalThread, NULL, main_statsSignals, &signals);
+    pthread_detach(signalThread);
+
+    atexit(main_dumpStats);
+}
 
 /**
  * Main program entry point.
@@ -44,25 +137,61 @@ int main(int argc, char* argv[]) {
     printf("%s %s\n", PROGRAM_NAME, PROGRAM_VERSION);
     log_init();
     GC_init();
-    StandardFunction_init();
     
-    //Can have exactly 2 or 4 args:
+    //Args are:
     // 0: executable name
     // 1: Insense Bytecode directory
-    // 2: -l flag
-    // 3: -l value
-    if(argc < 2 || argc == 3 || argc > 4) {
+    // then, in any order:
+    // -l and its value: log level
+    // -s: record channel statistics
+    // -t: trace end-to-end latency
+    // -p and a file: profile the heap, writing collapsed stacks to the file
+    // -m and a number of bytes: allocate every object from a static heap of that size
+    if(argc < 2) {
         printf(PROGRAM_USAGE, argv[0]);
         return EXITCODE_INVALID_ARGUMENTS;
     }
 
-    if(argc == 4) {
-        log_setLogLevel(argv[3]);
+    for(int i = 2; i < argc; i++) {
+        if(strcmp(argv[i], "-l") == 0 && i + 1 < argc) {
+            log_setLogLevel(argv[++i]);
+        } else if(strcmp(argv[i], "-s") == 0) {
+            channel_stats_setEnabled(true);
+            main_startStats();
+        } else if(strcmp(argv[i], "-t") == 0) {
+            Trace_enable();
+            main_startStats();
+        } else if(strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profileFile = argv[++i];
+            GC_profile_enable();
+            main_startStats();
+        } else if(strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+            char* end;
+            unsigned long budget = strtoul(argv[++i], &end, 10);
+            if(*end != '\0' || !GC_static_enable(budget)) {
+                printf(PROGRAM_USAGE, argv[0]);
+                printf(STATIC_HEAP_TOO_LARGE, (unsigned long) GC_STATIC_HEAP_SIZE);
+                return EXITCODE_INVALID_ARGUMENTS;
+            }
+            main_startStats();
+        } else {
+            printf(PROGRAM_USAGE, argv[0]);
+            return EXITCODE_INVALID_ARGUMENTS;
+        }
     }
+    //Allocated once the heap has been set up.
+    StandardFunction_init();
 
     directory = GC_alloc(strlen(argv[1])+1, false);
     strncpy(directory, argv[1], strlen(argv[1]));
 
+    char* configFile = getFilePath(CHANNEL_CONFIG_FILE);
+    bool configLoaded = ChannelConfig_load(configFile);
+    GC_decRef(configFile);
+    if(!configLoaded) {
+        return EXITCODE_INVALID_CONFIG;
+    }
+
     char* mainFile = getFilePath("Main.isc");
     mainComponent = component_newComponent("Main", mainFile, NULL);
 
@@ -36,6 +36,7 @@
 #include <string.h>
 #include <pthread.h>
 #include "Component.h"
+#include "ChannelConfig.h"
 
 int main(int argc, char* argv[]);
 char* getFilePath(char* fileName);
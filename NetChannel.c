@@ -0,0 +1,166 @@
+/*
+ * Network channels.
+ *
+ * A channel transport which exchanges a component channel's objects with a CVM on another (possibly emulated) node,
+ * over Unix datagram or UDP sockets.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "NetChannel.h"
+#include "Channels/net_link.h"
+#include "GC/GC_mem.h"
+#include "Logger/Logger.h"
+#include "TypedObject.h"
+
+#define NETCHANNEL_NAME "NetChannel"
+
+typedef struct NetChannel {
+    struct channel_transport transport;
+    net_link_t* link;
+    char* scratch;          //!< Flattened objects being sent, reused from send to send.
+    size_t scratchSize;
+    TypedObject_Recycler_s recycler;    //!< Numbers received, reused once the receiver has finished with them.
+} NetChannel_s, *NetChannel_PNTR;
+
+// Flatten an object onto the end of the scratch buffer, growing it if need be. Returns its length, or 0 if it can't be sent.
+static size_t NetChannel_flatten(NetChannel_PNTR this, TypedObject_PNTR object, size_t used) {
+    size_t length = TypedObject_encodeCompact(object, this->scratch + used, this->scratchSize - used);
+    if(length > this->scratchSize - used) {
+        size_t size = this->scratchSize;
+        while(size < used + length) {
+            size *= 2;
+        }
+        char* scratch = GC_alloc(size, false);
+        memcpy(scratch, this->scratch, used);
+        GC_decRef(this->scratch);
+        this->scratch = scratch;
+        this->scratchSize = size;
+        TypedObject_encodeCompact(object, this->scratch + used, length);
+    }
+    if(length == 0) {
+        log_logMessage(ERROR, NETCHANNEL_NAME, "Objects of type %d can't be sent to another node",
+                       TypedObject_getTypeByteCode(object));
+    }
+    return length;
+}
+
+static int NetChannel_sendN(struct channel_transport* transport, void* buffer, unsigned int n) {
+    NetChannel_PNTR this = (NetChannel_PNTR) transport;
+    //The channel carries references, and the sender has given us theirs.
+    TypedObject_PNTR* objects = buffer;
+
+    size_t* lengths = GC_alloc(n * sizeof(size_t), false);
+    void** messages = GC_alloc(n * sizeof(void*), false);
+    int result = 0;
+    unsigned int flattened = 0;
+    size_t used = 0;
+    for(unsigned int i = 0; i < n; i++) {
+        size_t length = NetChannel_flatten(this, objects[i], used);
+        if(length > 0) {
+            lengths[flattened++] = length;
+            used += length;
+        } else {
+            result = -1;
+        }
+        GC_decRef(objects[i]);
+    }
+    //Only point into the scratch buffer once it has stopped moving.
+    used = 0;
+    for(unsigned int i = 0; i < flattened; i++) {
+        messages[i] = this->scratch + used;
+        used += lengths[i];
+    }
+
+    if(flattened > 0 && net_link_send(this->link, messages, lengths, flattened) != 0) {
+        result = -1;
+    }
+    GC_decRef(lengths);
+    GC_decRef(messages);
+    return result;
+}
+
+static int NetChannel_send(struct channel_transport* transport, void* buffer) {
+    return NetChannel_sendN(transport, buffer, 1);
+}
+
+static int NetChannel_receive(struct channel_transport* transport, void* buffer) {
+    NetChannel_PNTR this = (NetChannel_PNTR) transport;
+
+    TypedObject_PNTR object = NULL;
+    while(object == NULL) {
+        size_t length;
+        char* flattened = net_link_receive(this->link, &length);
+        object = TypedObject_decodeRecycled(&(this->recycler), flattened, length, true);
+        if(object == NULL) {
+            log_logMessage(ERROR, NETCHANNEL_NAME, "Discarding a malformed %zu byte message", length);
+        }
+        GC_decRef(flattened);
+    }
+
+    //The receiver owns the rebuilt object's only reference, besides the recycler's.
+    *(TypedObject_PNTR*) buffer = object;
+    return 0;
+}
+
+static void NetChannel_close(struct channel_transport* transport) {
+    NetChannel_PNTR this = (NetChannel_PNTR) transport;
+    struct net_link_stats stats;
+    net_link_getStats(this->link, &stats);
+    log_logMessage(INFO, NETCHANNEL_NAME, "%lu messages in %lu datagrams, %lu resent, %lu unknown, %lu discarded",
+                   stats.messages, stats.datagrams, stats.resent, stats.unknown, stats.discarded);
+    net_link_close(this->link);
+    TypedObject_clearRecycler(&(this->recycler));
+    if(this->scratch != NULL) {
+        GC_decRef(this->scratch);
+    }
+}
+
+bool NetChannel_attach(Channel_PNTR channel, char* local, char* peer, unsigned int window) {
+    if((channel->direction == CHAN_OUT) != (peer != NULL)) {
+        log_logMessage(ERROR, NETCHANNEL_NAME, "OUT channels need an address to send to, and IN channels can't have one");
+        return false;
+    }
+    net_link_t* link = net_link_open(local, peer, window);
+    if(link == NULL) {
+        return false;
+    }
+
+    NetChannel_PNTR this = GC_alloc(sizeof(NetChannel_s), false);
+    this->transport.send = NetChannel_send;
+    this->transport.send_n = NetChannel_sendN;
+    this->transport.receive = NetChannel_receive;
+    this->transport.close = NetChannel_close;
+    this->transport.buffered = peer != NULL && window > 0;
+    this->link = link;
+    if(peer != NULL) {
+        this->scratchSize = 256;
+        this->scratch = GC_alloc(this->scratchSize, false);
+    }
+
+    if(!channel_setTransport(channel, &(this->transport))) {
+        NetChannel_close(&(this->transport));
+        GC_decRef(this);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,54 @@
+/*
+ * Network channels.
+ *
+ * A channel transport which exchanges a component channel's objects with a CVM on another (possibly emulated) node,
+ * over Unix datagram or UDP sockets.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_NETCHANNEL_H
+#define CVM_NETCHANNEL_H
+
+#include <stdbool.h>
+#include "Channels/channel.h"
+
+/**
+ * Connect a component channel to a channel on another node.
+ *
+ * Objects sent on the channel are flattened with TypedObject_encodeCompact and sent over a net_link (see
+ * Channels/net_link.h), and receives rebuild them. With a window of 0, a send returns once the receiving component has
+ * received the object, as it would locally. With a larger window, a send only waits once that many objects are in
+ * flight unreceived, and the channel counts as buffered, so the component batches its sends and small objects share
+ * datagrams. A send which the other node never acknowledges fails with SendStatusUnknownException logged, and the
+ * object is lost. The channel can no longer be connected to channels in this process.
+ *
+ * @param[in] channel Channel created with channel_createReference, not yet connected.
+ * @param[in] local   Address to bind: where an IN channel receives, or where an OUT channel's acknowledgements arrive.
+ * @param[in] peer    For an OUT channel, the address of the receiving channel; NULL for an IN channel.
+ * @param[in] window  For an OUT channel, the number of objects it may have in flight unreceived.
+ *
+ * @return false if the socket couldn't be set up, in which case the channel is unchanged.
+ */
+bool NetChannel_attach(Channel_PNTR channel, char* local, char* peer, unsigned int window);
+
+#endif //CVM_NETCHANNEL_H
@@ -37,7 +37,7 @@ struct Procedure {
 static void Procedure_decRef(Procedure_PNTR pntr);
 
 Procedure_PNTR Procedure_construct(char* name) {
-    Procedure_PNTR newProcedure = GC_alloc(sizeof(Procedure_s), true);
+    Procedure_PNTR newProcedure = GC_allocType(sizeof(Procedure_s), true, "Procedure");
     newProcedure->name = name;
     newProcedure->parameterNames = IteratedList_constructList();
     newProcedure->decRef = Procedure_decRef;
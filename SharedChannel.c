@@ -0,0 +1,123 @@
+/*
+ * Shared channels.
+ *
+ * A channel transport which exchanges a component channel's objects with CVM processes on the same host, through a
+ * ring in a shared memory segment.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "SharedChannel.h"
+#include "Channels/shm_ring.h"
+#include "GC/GC_mem.h"
+#include "Logger/Logger.h"
+#include "TypedObject.h"
+
+#define SHAREDCHANNEL_NAME "SharedChannel"
+#define SHAREDCHANNEL_STACK_BUFFER 256  //!< Most bytes flattened without allocating a buffer on the heap.
+
+typedef struct SharedChannel {
+    struct channel_transport transport;
+    shm_ring_t* ring;
+    char* segment;
+    TypedObject_Recycler_s recycler;    //!< Numbers received, reused once the receiver has finished with them.
+} SharedChannel_s, *SharedChannel_PNTR;
+
+static int SharedChannel_send(struct channel_transport* transport, void* buffer) {
+    SharedChannel_PNTR this = (SharedChannel_PNTR) transport;
+    //The channel carries references, and the sender has given us theirs.
+    TypedObject_PNTR object = *(TypedObject_PNTR*) buffer;
+
+    char stackBuffer[SHAREDCHANNEL_STACK_BUFFER];
+    char* flattened = stackBuffer;
+    size_t length = TypedObject_encode(object, stackBuffer, sizeof(stackBuffer));
+    if(length > sizeof(stackBuffer)) {
+        flattened = GC_alloc(length, false);
+        TypedObject_encode(object, flattened, length);
+    }
+
+    int result = 0;
+    if(length == 0) {
+        log_logMessage(ERROR, SHAREDCHANNEL_NAME, "Objects of type %d can't be sent through %s",
+                       TypedObject_getTypeByteCode(object), this->segment);
+        result = -1;
+    } else if(!shm_ring_write(this->ring, flattened, length)) {
+        log_logMessage(ERROR, SHAREDCHANNEL_NAME, "A %zu byte message is too large for %s, which takes up to %zu",
+                       length, this->segment, shm_ring_max_record(this->ring));
+        result = -1;
+    }
+
+    if(flattened != stackBuffer) {
+        GC_decRef(flattened);
+    }
+    GC_decRef(object);
+    return result;
+}
+
+static int SharedChannel_receive(struct channel_transport* transport, void* buffer) {
+    SharedChannel_PNTR this = (SharedChannel_PNTR) transport;
+
+    TypedObject_PNTR object = NULL;
+    while(object == NULL) {
+        size_t length;
+        char* flattened = shm_ring_read(this->ring, &length);
+        object = TypedObject_decodeRecycled(&(this->recycler), flattened, length, false);
+        if(object == NULL) {
+            log_logMessage(ERROR, SHAREDCHANNEL_NAME, "Discarding a malformed %zu byte message from %s", length,
+                           this->segment);
+        }
+        GC_decRef(flattened);
+    }
+
+    //The receiver owns the rebuilt object's only reference, besides the recycler's.
+    *(TypedObject_PNTR*) buffer = object;
+    return 0;
+}
+
+static void SharedChannel_close(struct channel_transport* transport) {
+    SharedChannel_PNTR this = (SharedChannel_PNTR) transport;
+    shm_ring_close(this->ring);
+    TypedObject_clearRecycler(&(this->recycler));
+    GC_decRef(this->segment);
+}
+
+bool SharedChannel_attach(Channel_PNTR channel, char* segment, size_t size) {
+    shm_ring_t* ring = shm_ring_open(segment, size > 0 ? size : SHM_RING_DEFAULT_SIZE);
+    if(ring == NULL) {
+        return false;
+    }
+
+    SharedChannel_PNTR this = GC_alloc(sizeof(SharedChannel_s), false);
+    this->transport.send = SharedChannel_send;
+    this->transport.receive = SharedChannel_receive;
+    this->transport.close = SharedChannel_close;
+    this->ring = ring;
+    this->segment = segment;
+    GC_incRef(segment);
+
+    if(!channel_setTransport(channel, &(this->transport))) {
+        SharedChannel_close(&(this->transport));
+        GC_decRef(this);
+        return false;
+    }
+    return true;
+}
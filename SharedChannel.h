@@ -0,0 +1,55 @@
+/*
+ * Shared channels.
+ *
+ * A channel transport which exchanges a component channel's objects with CVM processes on the same host, through a
+ * ring in a shared memory segment.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_SHAREDCHANNEL_H
+#define CVM_SHAREDCHANNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "Channels/channel.h"
+
+/**
+ * Connect a component channel to a shared memory segment, creating the segment if no other process has yet.
+ *
+ * From then on, objects sent on the channel are flattened into the segment's ring, and receives rebuild them from it,
+ * so the channel talks to whichever channels in other processes share the segment. The channel can no longer be
+ * connected to channels in this process. Sends wait only for space in the ring, not for a receiver. Objects which
+ * can't leave the process (components) are dropped with an error.
+ *
+ * The segment outlives the processes using it, so that a process which restarts can pick up where it left off; remove
+ * it from /dev/shm to start afresh.
+ *
+ * @param[in] channel Channel created with channel_createReference, not yet connected.
+ * @param[in] segment shm_open name of the segment.
+ * @param[in] size    Bytes of messages to make room for if the segment is created, or 0 for the default.
+ *
+ * @return false if the segment couldn't be opened, in which case the channel is unchanged.
+ */
+bool SharedChannel_attach(Channel_PNTR channel, char* segment, size_t size);
+
+#endif //CVM_SHAREDCHANNEL_H
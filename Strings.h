@@ -36,6 +36,8 @@ static const char PATH_SEPARATOR = '\\';
 
 #define PROGRAM_NAME "Insense C Virtual Machine"
 #define PROGRAM_VERSION "0.9.0"
-#define PROGRAM_USAGE "Usage: %s <program directory> [-l (DEBUG|INFO|WARNING|ERROR|FATAL)]\n"
+#define CHANNEL_CONFIG_FILE "channels.conf"
+#define PROGRAM_USAGE "Usage: %s <program directory> [-l (DEBUG|INFO|WARNING|ERROR|FATAL)] [-s] [-t] [-p <profile file>] [-m <heap bytes>]\n"
+#define STATIC_HEAP_TOO_LARGE "The static heap can be given up to %lu bytes\n"
 
 #endif //CVM_STRINGS_H
@@ -0,0 +1,1268 @@
+/*
+ * 
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "../Channels/channel.h"                   // For testing
+#include "../Channels/shm_ring.h"                  // For testing
+#include "../Channels/net_link.h"                  // For testing
+#include "../Channels/channel_stats.h"             // For testing
+#include "../GC/GC_mem.h"                          // For memory cleanup
+#include "ANSI-Colours.h"                          // For test results
+#include "../Logger/Logger.h"                      // Init log for channel/GC's logging
+
+#define MESSAGES 10000
+
+bool testOneToOneFastPath();
+bool testFanInSlowPath();
+bool testFanInFairness();
+bool testRebindDuringSend();
+bool testFastPathDisabled();
+bool testBufferedSendDoesNotWait();
+bool testBufferedBackpressure();
+bool testBatchedTransfer();
+bool testSelectDefault();
+bool testSelectWaitsForAny();
+bool testSelectFairness();
+bool testMulticastDelivers();
+bool testMulticastUnbindDrops();
+bool testReferenceChannel();
+bool testConnectionSet();
+bool testSharedMemoryRing();
+bool testNetLink();
+bool testChannelStats();
+bool testTryAndTimedReceive();
+bool testRewiringChurn();
+bool testBoundChannelsCollected();
+
+int main(int argc, char* argv[]) {
+
+    log_init();
+    GC_init();
+
+    if(argc==2) {
+        log_setLogLevel(argv[1]);
+    }
+
+    int passed = 0;
+    int failed = 0;
+
+    if(testOneToOneFastPath()) passed++;
+    else failed++;
+
+    if(testFanInSlowPath()) passed++;
+    else failed++;
+
+    if(testFanInFairness()) passed++;
+    else failed++;
+
+    if(testRebindDuringSend()) passed++;
+    else failed++;
+
+    if(testFastPathDisabled()) passed++;
+    else failed++;
+
+    if(testBufferedSendDoesNotWait()) passed++;
+    else failed++;
+
+    if(testBufferedBackpressure()) passed++;
+    else failed++;
+
+    if(testBatchedTransfer()) passed++;
+    else failed++;
+
+    if(testSelectDefault()) passed++;
+    else failed++;
+
+    if(testSelectWaitsForAny()) passed++;
+    else failed++;
+
+    if(testSelectFairness()) passed++;
+    else failed++;
+
+    if(testMulticastDelivers()) passed++;
+    else failed++;
+
+    if(testMulticastUnbindDrops()) passed++;
+    else failed++;
+
+    if(testReferenceChannel()) passed++;
+    else failed++;
+
+    if(testConnectionSet()) passed++;
+    else failed++;
+
+    if(testSharedMemoryRing()) passed++;
+    else failed++;
+
+    if(testNetLink()) passed++;
+    else failed++;
+
+    if(testChannelStats()) passed++;
+    else failed++;
+
+    if(testTryAndTimedReceive()) passed++;
+    else failed++;
+
+    if(testRewiringChurn()) passed++;
+    else failed++;
+
+    if(testBoundChannelsCollected()) passed++;
+    else failed++;
+
+    printf("\n---\n\n"ANSI_COLOR_GREEN "%d passed" ANSI_COLOR_RESET "/" ANSI_COLOR_RED "%d failed" ANSI_COLOR_RESET "\n", passed, failed);
+
+    return failed;
+}
+
+typedef struct Sender {
+    Channel_PNTR channel;
+    int first;
+    int count;
+} Sender_s;
+
+static void* sendSequence(void* arg) {
+    Sender_s* sender = arg;
+    for(int i = sender->first; i < sender->first + sender->count; i++) {
+        int value = i;
+        channel_send(sender->channel, &value, NULL);
+    }
+    return NULL;
+}
+
+bool testOneToOneFastPath() {
+    bool result = true;
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out, in);
+    result &= atomic_load(&(out->spsc_peer)) == in;
+
+    Sender_s sender = { out, 0, MESSAGES };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sendSequence, &sender);
+    for(int i = 0; i < MESSAGES; i++) {
+        int value = -1;
+        channel_receive(in, &value, false);
+        result &= value == i;
+    }
+    pthread_join(thread, NULL);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL ONE-TO-ONE FAST PATH" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL ONE-TO-ONE FAST PATH" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(in);
+    return result;
+}
+
+bool testFanInSlowPath() {
+    bool result = true;
+
+    Channel_PNTR out1 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR out2 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out1, in);
+    channel_bind(out2, in);
+    result &= atomic_load(&(out1->spsc_peer)) == NULL && atomic_load(&(out2->spsc_peer)) == NULL;
+
+    Sender_s sender1 = { out1, 0, MESSAGES };
+    Sender_s sender2 = { out2, MESSAGES, MESSAGES };
+    pthread_t thread1, thread2;
+    pthread_create(&thread1, NULL, sendSequence, &sender1);
+    pthread_create(&thread2, NULL, sendSequence, &sender2);
+    long long sum = 0;
+    for(int i = 0; i < 2 * MESSAGES; i++) {
+        int value = -1;
+        channel_receive(in, &value, false);
+        sum += value;
+    }
+    pthread_join(thread1, NULL);
+    pthread_join(thread2, NULL);
+    result &= sum == (long long)(2 * MESSAGES - 1) * (2 * MESSAGES) / 2;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL FAN-IN SLOW PATH" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL FAN-IN SLOW PATH" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out1);
+    GC_decRef(out2);
+    GC_decRef(in);
+    return result;
+}
+
+#define FAN_IN_SENDERS 8
+#define FAN_IN_ROUNDS 3
+
+bool testFanInFairness() {
+    bool result = true;
+
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    Channel_PNTR outs[FAN_IN_SENDERS];
+    Sender_s senders[FAN_IN_SENDERS];
+    pthread_t threads[FAN_IN_SENDERS];
+    for(int i = 0; i < FAN_IN_SENDERS; i++) {
+        outs[i] = channel_create(CHAN_OUT, sizeof(int));
+        channel_bind(outs[i], in);
+        senders[i] = (Sender_s){ outs[i], i * FAN_IN_ROUNDS, FAN_IN_ROUNDS };
+        pthread_create(&threads[i], NULL, sendSequence, &senders[i]);
+    }
+
+    // once every sender is waiting, each round of receives must take one message from each of them
+    for(int round = 0; round < FAN_IN_ROUNDS; round++) {
+        usleep(10000);
+        bool seen[FAN_IN_SENDERS] = { false };
+        for(int i = 0; i < FAN_IN_SENDERS; i++) {
+            int value = -1;
+            channel_receive(in, &value, false);
+            int sender = value / FAN_IN_ROUNDS;
+            result &= !seen[sender] && value % FAN_IN_ROUNDS == round;
+            seen[sender] = true;
+        }
+    }
+    for(int i = 0; i < FAN_IN_SENDERS; i++) {
+        pthread_join(threads[i], NULL);
+        GC_decRef(outs[i]);
+    }
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL FAN-IN FAIRNESS" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL FAN-IN FAIRNESS" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(in);
+    return result;
+}
+
+bool testRebindDuringSend() {
+    bool result = true;
+
+    Channel_PNTR out1 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR out2 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out1, in);
+
+    // Sender 1 blocks in the fast path with nobody receiving, then the binding stops being one-to-one
+    Sender_s sender1 = { out1, 1, 1 };
+    Sender_s sender2 = { out2, 2, 1 };
+    pthread_t thread1, thread2;
+    pthread_create(&thread1, NULL, sendSequence, &sender1);
+    usleep(10000);
+    channel_bind(out2, in);
+    result &= atomic_load(&(out1->spsc_peer)) == NULL || atomic_load(&(out1->spsc_peer)) == in;
+    pthread_create(&thread2, NULL, sendSequence, &sender2);
+
+    int total = 0;
+    for(int i = 0; i < 2; i++) {
+        int value = -1;
+        channel_receive(in, &value, false);
+        total += value;
+    }
+    pthread_join(thread1, NULL);
+    pthread_join(thread2, NULL);
+    result &= total == 3;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL REBIND DURING SEND" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL REBIND DURING SEND" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out1);
+    GC_decRef(out2);
+    GC_decRef(in);
+    return result;
+}
+
+bool testFastPathDisabled() {
+    bool result = true;
+
+    channel_setSPSCEnabled(false);
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out, in);
+    result &= atomic_load(&(out->spsc_peer)) == NULL;
+
+    Sender_s sender = { out, 0, MESSAGES };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sendSequence, &sender);
+    for(int i = 0; i < MESSAGES; i++) {
+        int value = -1;
+        channel_receive(in, &value, false);
+        result &= value == i;
+    }
+    pthread_join(thread, NULL);
+    channel_setSPSCEnabled(true);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL FAST PATH DISABLED" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL FAST PATH DISABLED" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(in);
+    return result;
+}
+
+bool testBufferedSendDoesNotWait() {
+    bool result = true;
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    result &= channel_setCapacity(in, 4);
+    channel_bind(out, in);
+
+    // no receiver yet, so these would block forever on an unbuffered channel
+    for(int i = 0; i < 4; i++) {
+        channel_send(out, &i, NULL);
+    }
+
+    struct channel_buffer_stats stats;
+    channel_getBufferStats(in, &stats);
+    result &= stats.capacity == 4 && stats.occupancy == 4 && stats.high_water == 4 && stats.buffered_sends == 4;
+
+    for(int i = 0; i < 4; i++) {
+        int value = -1;
+        channel_receive(in, &value, false);
+        result &= value == i;
+    }
+    channel_getBufferStats(in, &stats);
+    result &= stats.occupancy == 0 && stats.full_sends == 0;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - BUFFERED CHANNEL SEND DOES NOT WAIT" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - BUFFERED CHANNEL SEND DOES NOT WAIT" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(in);
+    return result;
+}
+
+bool testBufferedBackpressure() {
+    bool result = true;
+
+    Channel_PNTR out1 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR out2 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    result &= channel_setCapacity(in, 2);
+    result &= !channel_setCapacity(out1, 2);
+    channel_bind(out1, in);
+    channel_bind(out2, in);
+
+    Sender_s senders[2] = { { out1, 0, MESSAGES }, { out2, MESSAGES, MESSAGES } };
+    pthread_t threads[2];
+    for(int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], NULL, sendSequence, &senders[i]);
+    }
+    usleep(10000); // let the senders fill the buffer
+
+    // each sender's messages must still arrive in order
+    int next[2] = { 0, MESSAGES };
+    for(int i = 0; i < 2 * MESSAGES; i++) {
+        int value = -1;
+        channel_receive(in, &value, false);
+        int sender = value >= MESSAGES;
+        result &= value == next[sender];
+        next[sender]++;
+    }
+    for(int i = 0; i < 2; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    struct channel_buffer_stats stats;
+    channel_getBufferStats(in, &stats);
+    result &= stats.high_water == 2 && stats.occupancy == 0 && stats.full_sends > 0;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - BUFFERED CHANNEL BACKPRESSURE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - BUFFERED CHANNEL BACKPRESSURE" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out1);
+    GC_decRef(out2);
+    GC_decRef(in);
+    return result;
+}
+
+static void* sendBatches(void* arg) {
+    Sender_s* sender = arg;
+    int values[16];
+    for(int i = 0; i < sender->count; i += 16) {
+        int n = sender->count - i < 16 ? sender->count - i : 16;
+        for(int j = 0; j < n; j++) {
+            values[j] = sender->first + i + j;
+        }
+        channel_send_n(sender->channel, values, n, NULL);
+    }
+    return NULL;
+}
+
+bool testBatchedTransfer() {
+    bool result = true;
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    result &= channel_setCapacity(in, 8);
+    channel_bind(out, in);
+    result &= channel_isBuffered(in) && channel_isBuffered(out);
+
+    Sender_s sender = { out, 0, MESSAGES };
+    pthread_t thread;
+    pthread_create(&thread, NULL, sendBatches, &sender);
+    usleep(10000); // let the sender fill the buffer
+
+    int values[32];
+    int next = 0;
+    unsigned int largest = 0;
+    while(next < MESSAGES) {
+        unsigned int received = channel_receive_n(in, values, 32);
+        largest = received > largest ? received : largest;
+        // the batch still holds its space in the buffer, bar the first item, which was received as usual
+        usleep(100);
+        struct channel_buffer_stats held;
+        channel_getBufferStats(in, &held);
+        result &= held.occupancy + received <= 8 + 1;
+        for(unsigned int i = 0; i < received; i++) {
+            result &= values[i] == next++;
+        }
+    }
+    pthread_join(thread, NULL);
+    result &= next == MESSAGES && largest > 1;
+
+    struct channel_buffer_stats stats;
+    channel_getBufferStats(in, &stats);
+    result &= stats.high_water == 8 && stats.occupancy == 0;
+
+    // unbuffered channels still work, one item per rendezvous
+    Channel_PNTR syncOut = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR syncIn = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(syncOut, syncIn);
+    result &= !channel_isBuffered(syncIn) && !channel_isBuffered(syncOut);
+    Sender_s syncSender = { syncOut, 0, 20 };
+    pthread_create(&thread, NULL, sendBatches, &syncSender);
+    for(next = 0; next < 20; next++) {
+        result &= channel_receive_n(syncIn, values, 32) == 1 && values[0] == next;
+    }
+    pthread_join(thread, NULL);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - BATCHED CHANNEL TRANSFER" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - BATCHED CHANNEL TRANSFER" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(in);
+    GC_decRef(syncOut);
+    GC_decRef(syncIn);
+    return result;
+}
+
+bool testSelectDefault() {
+    bool result = true;
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    result &= channel_setCapacity(in, 1);
+    channel_bind(out, in);
+
+    int value = -1;
+    Channel_PNTR chans[] = { in };
+    struct select_struct select = { 1, chans, &value, true, 0 };
+    result &= channel_select(&select) == -1 && value == -1;
+
+    int sent = 42;
+    channel_send(out, &sent, NULL);
+    result &= channel_select(&select) == 0 && value == 42;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL SELECT DEFAULT" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL SELECT DEFAULT" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(in);
+    return result;
+}
+
+static void* delayedSendSequence(void* arg) {
+    usleep(10000); // make sure the select is asleep first
+    return sendSequence(arg);
+}
+
+bool testSelectWaitsForAny() {
+    bool result = true;
+
+    // one slow path fan-in, one fast path binding
+    Channel_PNTR out1 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR out2 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in1 = channel_create(CHAN_IN, sizeof(int));
+    Channel_PNTR out3 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in2 = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out1, in1);
+    channel_bind(out2, in1);
+    channel_bind(out3, in2);
+    result &= atomic_load(&(out3->spsc_peer)) == in2;
+
+    Sender_s senders[3] = { { out1, 0, MESSAGES }, { out2, MESSAGES, MESSAGES }, { out3, 2 * MESSAGES, MESSAGES } };
+    pthread_t threads[3];
+    for(int i = 0; i < 3; i++) {
+        pthread_create(&threads[i], NULL, delayedSendSequence, &senders[i]);
+    }
+
+    int value;
+    Channel_PNTR chans[] = { in1, in2 };
+    struct select_struct select = { 2, chans, &value, false, 0 };
+    int next[3] = { 0, MESSAGES, 2 * MESSAGES };
+    for(int i = 0; i < 3 * MESSAGES; i++) {
+        int chosen = channel_select(&select);
+        int sender = value / MESSAGES;
+        result &= chosen == (sender == 2 ? 1 : 0) && value == next[sender];
+        next[sender]++;
+    }
+    for(int i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL SELECT WAITS FOR ANY" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL SELECT WAITS FOR ANY" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out1);
+    GC_decRef(out2);
+    GC_decRef(in1);
+    GC_decRef(out3);
+    GC_decRef(in2);
+    return result;
+}
+
+bool testSelectFairness() {
+    bool result = true;
+
+    // with data always waiting on every channel, each should be chosen in turn
+    Channel_PNTR outs[3], ins[3];
+    for(int i = 0; i < 3; i++) {
+        outs[i] = channel_create(CHAN_OUT, sizeof(int));
+        ins[i] = channel_create(CHAN_IN, sizeof(int));
+        result &= channel_setCapacity(ins[i], 4);
+        channel_bind(outs[i], ins[i]);
+        for(int j = 0; j < 4; j++) {
+            channel_send(outs[i], &i, NULL);
+        }
+    }
+
+    int value;
+    struct select_struct select = { 3, ins, &value, false, 0 };
+    int chosen[3] = { 0, 0, 0 };
+    for(int i = 0; i < 9; i++) {
+        int index = channel_select(&select);
+        result &= index == i % 3 && value == index;
+        chosen[index]++;
+    }
+    result &= chosen[0] == 3 && chosen[1] == 3 && chosen[2] == 3;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL SELECT FAIRNESS" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL SELECT FAIRNESS" ANSI_COLOR_RESET "\n");
+    }
+
+    for(int i = 0; i < 3; i++) {
+        GC_decRef(outs[i]);
+        GC_decRef(ins[i]);
+    }
+    return result;
+}
+
+typedef struct Receiver {
+    Channel_PNTR channel;
+    int count;
+    bool inOrder;
+} Receiver_s;
+
+static void* receiveSequence(void* arg) {
+    Receiver_s* receiver = arg;
+    receiver->inOrder = true;
+    for(int i = 0; i < receiver->count; i++) {
+        int value = -1;
+        channel_receive(receiver->channel, &value, false);
+        receiver->inOrder &= value == i;
+    }
+    return NULL;
+}
+
+bool testMulticastDelivers() {
+    bool result = true;
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR ins[3];
+    Receiver_s receivers[3];
+    pthread_t threads[3];
+    for(int i = 0; i < 3; i++) {
+        ins[i] = channel_create(CHAN_IN, sizeof(int));
+        channel_bind(out, ins[i]);
+        receivers[i] = (Receiver_s) { ins[i], MESSAGES, false };
+        pthread_create(&threads[i], NULL, receiveSequence, &receivers[i]);
+    }
+
+    for(int i = 0; i < MESSAGES; i++) {
+        result &= channel_multicast_send(out, &i) == 3;
+    }
+    for(int i = 0; i < 3; i++) {
+        pthread_join(threads[i], NULL);
+        result &= receivers[i].inOrder;
+
+        struct channel_multicast_stats stats;
+        channel_getMulticastStats(ins[i], &stats);
+        result &= stats.delivered == MESSAGES && stats.dropped == 0 && stats.max_latency > 0;
+    }
+
+    // a multicast over a one-to-one binding leaves the fast path in place
+    Channel_PNTR loneOut = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR loneIn = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(loneOut, loneIn);
+    Receiver_s lone = { loneIn, MESSAGES, false };
+    pthread_create(&threads[0], NULL, receiveSequence, &lone);
+    for(int i = 0; i < MESSAGES; i++) {
+        result &= channel_multicast_send(loneOut, &i) == 1;
+    }
+    pthread_join(threads[0], NULL);
+    result &= lone.inOrder && atomic_load(&(loneOut->spsc_peer)) == loneIn;
+    struct channel_multicast_stats loneStats;
+    channel_getMulticastStats(loneIn, &loneStats);
+    result &= loneStats.delivered == MESSAGES;
+    GC_decRef(loneOut);
+    GC_decRef(loneIn);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL MULTICAST DELIVERS" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL MULTICAST DELIVERS" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    for(int i = 0; i < 3; i++) {
+        GC_decRef(ins[i]);
+    }
+    return result;
+}
+
+static void* multicastOne(void* arg) {
+    int value = 7;
+    channel_multicast_send(arg, &value);
+    return NULL;
+}
+
+bool testMulticastUnbindDrops() {
+    bool result = true;
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR listening = channel_create(CHAN_IN, sizeof(int));
+    Channel_PNTR idle = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out, listening);
+    channel_bind(out, idle);
+
+    pthread_t thread;
+    pthread_create(&thread, NULL, multicastOne, out);
+    int value = -1;
+    channel_receive(listening, &value, false);
+    result &= value == 7;
+
+    // the sender is still waiting for the idle receiver, until it goes away
+    usleep(10000);
+    channel_unbind(idle);
+    pthread_join(thread, NULL);
+
+    struct channel_multicast_stats stats;
+    channel_getMulticastStats(idle, &stats);
+    result &= stats.delivered == 0 && stats.dropped == 1;
+    channel_getMulticastStats(listening, &stats);
+    result &= stats.delivered == 1 && stats.dropped == 0;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL MULTICAST UNBIND DROPS" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL MULTICAST UNBIND DROPS" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(listening);
+    GC_decRef(idle);
+    return result;
+}
+
+static void* receiveReference(void* arg) {
+    char* received = NULL;
+    channel_receive(arg, &received, false);
+    return received;
+}
+
+bool testReferenceChannel() {
+    bool result = true;
+
+    Channel_PNTR out = channel_createReference(CHAN_OUT);
+    Channel_PNTR ins[2] = { channel_createReference(CHAN_IN), channel_createReference(CHAN_IN) };
+    channel_bind(out, ins[0]);
+
+    // a send moves the sender's reference to the receiver, without copying the object
+    char* string = GC_alloc(1024, false);
+    strcpy(string, "moved, not copied");
+    pthread_t threads[2];
+    pthread_create(&threads[0], NULL, receiveReference, ins[0]);
+    channel_send(out, &string, NULL);
+    char* received;
+    pthread_join(threads[0], (void**)&received);
+    result &= received == string && GC_getRef(received) == 1;
+
+    // a multicast gives every receiver its own reference, and the sender gives up its one
+    channel_bind(out, ins[1]);
+    GC_incRef(string);
+    for(int i = 0; i < 2; i++) {
+        pthread_create(&threads[i], NULL, receiveReference, ins[i]);
+    }
+    result &= channel_multicast_send(out, &string) == 2;
+    for(int i = 0; i < 2; i++) {
+        pthread_join(threads[i], (void**)&received);
+        result &= received == string;
+    }
+    result &= GC_getRef(string) == 3;
+    GC_decRef(string);
+    GC_decRef(string);
+    GC_decRef(string);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL REFERENCE MOVE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL REFERENCE MOVE" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(ins[0]);
+    GC_decRef(ins[1]);
+    return result;
+}
+
+bool testConnectionSet() {
+    bool result = true;
+
+    static int members[1000];
+    conn_set_t set;
+    conn_set_init(&set);
+    for(int i = 0; i < 1000; i++) {
+        result &= conn_set_add(&set, &members[i], &members[999 - i]);
+    }
+    result &= !conn_set_add(&set, &members[500], NULL) && conn_set_size(&set) == 1000;
+
+    // remove every other member, then check exactly the rest are still there
+    for(int i = 0; i < 1000; i += 2) {
+        result &= conn_set_remove(&set, &members[i]);
+    }
+    result &= !conn_set_remove(&set, &members[0]) && conn_set_size(&set) == 500;
+    for(int i = 0; i < 1000; i++) {
+        result &= conn_set_contains(&set, &members[i]) == (i % 2 == 1);
+        result &= conn_set_lookup(&set, &members[i]) == (i % 2 == 1 ? &members[999 - i] : NULL);
+    }
+    for(unsigned int i = 0; i < conn_set_size(&set); i++) {
+        result &= ((int*)conn_set_get(&set, i) - members) % 2 == 1;
+    }
+
+    // round-robin visits every member once per lap
+    int visits[1000] = { 0 };
+    for(unsigned int i = 0; i < 2 * conn_set_size(&set); i++) {
+        visits[(int*)conn_set_next(&set) - members]++;
+    }
+    for(int i = 0; i < 1000; i++) {
+        result &= visits[i] == (i % 2 == 1 ? 2 : 0);
+    }
+
+    for(int i = 1; i < 1000; i += 2) {
+        result &= conn_set_remove(&set, &members[i]);
+    }
+    result &= conn_set_size(&set) == 0 && conn_set_next(&set) == NULL && !conn_set_contains(&set, &members[1]);
+    conn_set_destroy(&set);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL CONNECTION SET" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL CONNECTION SET" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+#define CHURN_THREADS 4
+#define CHURN_ROUNDS 2000
+
+typedef struct Rewirer {
+    Channel_PNTR out;
+    Channel_PNTR* ins;
+} Rewirer_s;
+
+#define RING_RECORDS 5000
+
+// Record i is its own number followed by i % 300 copies of its low byte, so records of all sizes wrap round the ring.
+static void fillRecord(char* record, int i) {
+    memcpy(record, &i, sizeof(i));
+    memset(record + sizeof(i), (char)i, (size_t)(i % 300));
+}
+
+bool testSharedMemoryRing() {
+    bool result = true;
+
+    char name[64];
+    snprintf(name, sizeof(name), "/insense-test-%d", (int)getpid());
+    shm_unlink(name);
+
+    // a smaller ring than the records written, so the writer has to wait for the reader in the other process
+    fflush(stdout);
+    pid_t writer = fork();
+    if(writer == 0) {
+        shm_ring_t* ring = shm_ring_open(name, 4096);
+        char record[sizeof(int) + 300];
+        for(int i = 0; ring != NULL && i < RING_RECORDS; i++) {
+            fillRecord(record, i);
+            shm_ring_write(ring, record, sizeof(int) + (size_t)(i % 300));
+        }
+        _exit(ring == NULL);
+    }
+
+    shm_ring_t* ring = shm_ring_open(name, 4096);
+    result &= ring != NULL;
+    char expected[sizeof(int) + 300];
+    for(int i = 0; result && i < RING_RECORDS; i++) {
+        size_t length;
+        char* record = shm_ring_read(ring, &length);
+        fillRecord(expected, i);
+        result &= length == sizeof(int) + (size_t)(i % 300) && memcmp(record, expected, length) == 0;
+        GC_decRef(record);
+    }
+    int status;
+    waitpid(writer, &status, 0);
+    result &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+
+    // records larger than half the ring are refused rather than waited for forever
+    char large[4096] = { 0 };
+    result &= ring != NULL && !shm_ring_write(ring, large, sizeof(large));
+
+    if(ring != NULL) {
+        shm_ring_close(ring);
+    }
+    shm_unlink(name);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - SHARED MEMORY RING" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - SHARED MEMORY RING" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+typedef struct NetSender {
+    net_link_t* link;
+    unsigned int batch;
+} NetSender_s;
+
+// Send the numbers 0 to MESSAGES-1, batch at a time.
+static void* sendNumbers(void* arg) {
+    NetSender_s* sender = arg;
+    int numbers[64];
+    void* messages[64];
+    size_t lengths[64];
+    for(int i = 0; i < MESSAGES; i += (int)sender->batch) {
+        unsigned int n = 0;
+        for(; n < sender->batch && i + (int)n < MESSAGES; n++) {
+            numbers[n] = i + (int)n;
+            messages[n] = &numbers[n];
+            lengths[n] = sizeof(int);
+        }
+        net_link_send(sender->link, messages, lengths, n);
+    }
+    return NULL;
+}
+
+bool testNetLink() {
+    bool result = true;
+
+    char in_address[64], out_address[64];
+    snprintf(in_address, sizeof(in_address), "unix:/tmp/insense-test-%d-in", (int)getpid());
+    snprintf(out_address, sizeof(out_address), "unix:/tmp/insense-test-%d-out", (int)getpid());
+    net_link_t* in = net_link_open(in_address, NULL, 0);
+    result &= in != NULL && net_link_open("tcp:127.0.0.1:1", NULL, 0) == NULL;
+
+    // synchronous, then with a window and batched sends, which should share datagrams
+    unsigned int windows[2] = { 0, 16 };
+    unsigned int batches[2] = { 1, 64 };
+    unsigned long datagrams = 0;
+    for(int round = 0; in != NULL && round < 2; round++) {
+        NetSender_s sender = { net_link_open(out_address, in_address, windows[round]), batches[round] };
+        result &= sender.link != NULL;
+        if(sender.link == NULL) {
+            break;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, sendNumbers, &sender);
+        for(int i = 0; i < MESSAGES; i++) {
+            size_t length;
+            int* number = net_link_receive(in, &length);
+            result &= length == sizeof(int) && *number == i;
+            GC_decRef(number);
+        }
+        pthread_join(thread, NULL);
+
+        struct net_link_stats stats;
+        net_link_getStats(sender.link, &stats);
+        result &= stats.messages == MESSAGES && stats.unknown == 0;
+        if(round == 0) {
+            result &= stats.datagrams == MESSAGES;
+        } else {
+            result &= stats.datagrams <= MESSAGES / 8;
+        }
+        datagrams += stats.datagrams;
+        net_link_close(sender.link);
+    }
+
+    if(in != NULL) {
+        // a new sender on the same address starts its own sequence, and every datagram was accepted once
+        struct net_link_stats stats;
+        net_link_getStats(in, &stats);
+        result &= stats.messages == 2 * MESSAGES && stats.datagrams == datagrams;
+        net_link_close(in);
+    }
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - NETWORK LINK" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - NETWORK LINK" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+static void* rewire(void* arg) {
+    Rewirer_s* rewirer = arg;
+    for(int i = 0; i < CHURN_ROUNDS; i++) {
+        channel_bind(rewirer->out, rewirer->ins[i % 2]);
+        channel_bind(rewirer->out, rewirer->ins[2 + i % 2]);
+        channel_unbind(rewirer->out);
+    }
+    return NULL;
+}
+
+static size_t measureThree(void* item) {
+    (void)item;
+    return 3;
+}
+
+static bool checkHistogram(struct channel_stats_totals* totals) {
+    uint64_t operations = 0;
+    for(int i = 0; i < CHANNEL_STATS_BUCKETS; i++) {
+        operations += totals->histogram[i];
+    }
+    uint64_t p50 = channel_stats_percentile(totals, 0.5);
+    uint64_t p99 = channel_stats_percentile(totals, 0.99);
+    return operations == MESSAGES && p50 <= p99 && p99 <= totals->max_wait && totals->max_wait <= totals->wait;
+}
+
+bool testChannelStats() {
+    bool result = true;
+
+    uint64_t times[] = { 0, 7, 8, 9, 15, 16, 17, 1000, 123456789, 1ull << 35, 1ull << 40 };
+    for(unsigned int i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+        unsigned int bucket = channel_stats_bucket(times[i]);
+        result &= bucket < CHANNEL_STATS_BUCKETS && times[i] < channel_stats_bucketLimit(bucket);
+        result &= bucket == 0 || channel_stats_bucketLimit(bucket - 1) <= times[i];
+    }
+
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_setLabel(out, "StatsTest", "output", NULL);
+    channel_setLabel(in, "StatsTest", "input", measureThree);
+    result &= out->stats_id != 0 && in->stats_id != 0 && out->stats_id != in->stats_id;
+    result &= channel_stats_register("StatsTest", "output") == out->stats_id;
+    channel_bind(out, in);
+
+    // the receiver's thread exits before the figures are read, so they come from its retired shard
+    Receiver_s receiver = { in, MESSAGES, false };
+    pthread_t thread;
+    pthread_create(&thread, NULL, receiveSequence, &receiver);
+    for(int i = 0; i < MESSAGES; i++) {
+        channel_send(out, &i, NULL);
+    }
+    pthread_join(thread, NULL);
+    result &= receiver.inOrder;
+
+    struct channel_stats stats;
+    result &= channel_stats_get(out->stats_id, &stats);
+    result &= strcmp(stats.component, "StatsTest") == 0 && strcmp(stats.channel, "output") == 0;
+    result &= stats.sides[CHANNEL_STATS_SEND].messages == MESSAGES;
+    result &= stats.sides[CHANNEL_STATS_SEND].bytes == MESSAGES * sizeof(int);
+    result &= stats.sides[CHANNEL_STATS_RECEIVE].messages == 0;
+    result &= checkHistogram(&(stats.sides[CHANNEL_STATS_SEND]));
+
+    result &= channel_stats_get(in->stats_id, &stats);
+    result &= stats.sides[CHANNEL_STATS_RECEIVE].messages == MESSAGES;
+    result &= stats.sides[CHANNEL_STATS_RECEIVE].bytes == MESSAGES * 3;
+    result &= checkHistogram(&(stats.sides[CHANNEL_STATS_RECEIVE]));
+    result &= !channel_stats_get(0, &stats);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL STATISTICS" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL STATISTICS" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    GC_decRef(in);
+    return result;
+}
+
+static void* receiveOne(void* arg) {
+    Receiver_s* receiver = arg;
+    int value = -1;
+    channel_receive(receiver->channel, &value, false);
+    receiver->inOrder = value == receiver->count;
+    return NULL;
+}
+
+static void* receiveOneUntil(void* arg) {
+    Receiver_s* receiver = arg;
+    struct timespec deadline;
+    channel_deadlineAfter(&deadline, 5000);
+    int value = -1;
+    receiver->inOrder = channel_receive_until(receiver->channel, &value, &deadline) && value == receiver->count;
+    return NULL;
+}
+
+// Try to send value until a receiver takes it, giving up after a second.
+static bool trySendPatiently(Channel_PNTR out, int value) {
+    for(int i = 0; i < 1000; i++) {
+        if(channel_try_send(out, &value)) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+static bool tryReceivePatiently(Channel_PNTR in, int* value) {
+    for(int i = 0; i < 1000; i++) {
+        if(channel_try_receive(in, value)) {
+            return true;
+        }
+        usleep(1000);
+    }
+    return false;
+}
+
+static long msSince(struct timespec* start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+bool testTryAndTimedReceive() {
+    bool result = true;
+
+    Channel_PNTR unbound = channel_create(CHAN_OUT, sizeof(int));
+    int value = 1;
+    result &= !channel_try_send(unbound, &value);
+
+    // one-to-one fast path, then fan-in slow path
+    Channel_PNTR out1 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR out2 = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(out1, in);
+    for(int round = 0; round < 2; round++) {
+        value = -1;
+        result &= !channel_try_receive(in, &value) && value == -1;
+        result &= !channel_try_send(out1, &value);	// nobody receiving
+
+        Receiver_s receiver = { in, 10 + round, false };
+        pthread_t thread;
+        pthread_create(&thread, NULL, receiveOne, &receiver);
+        result &= trySendPatiently(out1, 10 + round);
+        pthread_join(thread, NULL);
+        result &= receiver.inOrder;
+
+        Sender_s sender = { out1, 20 + round, 1 };
+        pthread_create(&thread, NULL, sendSequence, &sender);
+        result &= tryReceivePatiently(in, &value) && value == 20 + round;
+        pthread_join(thread, NULL);
+
+        channel_bind(out2, in);
+    }
+
+    // a receive that times out, and one that doesn't
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct timespec deadline;
+    channel_deadlineAfter(&deadline, 20);
+    result &= !channel_receive_until(in, &value, &deadline);
+    long waited = msSince(&start);
+    result &= waited >= 20 && waited < 1000;
+
+    Sender_s sender = { out2, 30, 1 };
+    pthread_t thread;
+    pthread_create(&thread, NULL, delayedSendSequence, &sender);
+    channel_deadlineAfter(&deadline, 5000);
+    result &= channel_receive_until(in, &value, &deadline) && value == 30;
+    pthread_join(thread, NULL);
+
+    // a try send meets a timed receive, fanned in and one-to-one
+    Channel_PNTR loneOut = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR loneIn = channel_create(CHAN_IN, sizeof(int));
+    channel_bind(loneOut, loneIn);
+    Channel_PNTR outs[] = { out2, loneOut };
+    Channel_PNTR ins[] = { in, loneIn };
+    for(int i = 0; i < 2; i++) {
+        Receiver_s receiver = { ins[i], 40 + i, false };
+        pthread_create(&thread, NULL, receiveOneUntil, &receiver);
+        result &= trySendPatiently(outs[i], 40 + i);
+        pthread_join(thread, NULL);
+        result &= receiver.inOrder;
+    }
+    GC_decRef(loneOut);
+    GC_decRef(loneIn);
+
+    // buffered: try sends succeed until the buffer is full
+    Channel_PNTR bufferedOut = channel_create(CHAN_OUT, sizeof(int));
+    Channel_PNTR bufferedIn = channel_create(CHAN_IN, sizeof(int));
+    result &= channel_setCapacity(bufferedIn, 2);
+    channel_bind(bufferedOut, bufferedIn);
+    for(int i = 0; i < 3; i++) {
+        result &= channel_try_send(bufferedOut, &i) == (i < 2);
+    }
+    for(int i = 0; i < 3; i++) {
+        value = -1;
+        result &= channel_try_receive(bufferedIn, &value) == (i < 2) && value == (i < 2 ? i : -1);
+    }
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL TRY AND TIMED RECEIVE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL TRY AND TIMED RECEIVE" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(unbound);
+    GC_decRef(out1);
+    GC_decRef(out2);
+    GC_decRef(in);
+    GC_decRef(bufferedOut);
+    GC_decRef(bufferedIn);
+    return result;
+}
+
+bool testRewiringChurn() {
+    bool result = true;
+
+    log_setLogLevel("WARNING");	// every bind and unbind is logged at INFO; this is the last test, so it stays quiet
+
+    // traffic keeps flowing on ins[0] while other senders are bound to and unbound from it
+    Channel_PNTR ins[4];
+    for(int i = 0; i < 4; i++) {
+        ins[i] = channel_create(CHAN_IN, sizeof(int));
+    }
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    channel_bind(out, ins[0]);
+
+    Rewirer_s rewirers[CHURN_THREADS];
+    pthread_t threads[CHURN_THREADS];
+    for(int i = 0; i < CHURN_THREADS; i++) {
+        rewirers[i].out = channel_create(CHAN_OUT, sizeof(int));
+        rewirers[i].ins = ins;
+        pthread_create(&threads[i], NULL, rewire, &rewirers[i]);
+    }
+    Sender_s sender = { out, 0, MESSAGES };
+    pthread_t senderThread;
+    pthread_create(&senderThread, NULL, sendSequence, &sender);
+
+    for(int i = 0; i < MESSAGES; i++) {
+        int value = -1;
+        channel_receive(ins[0], &value, false);
+        result &= value == i;
+    }
+    pthread_join(senderThread, NULL);
+    for(int i = 0; i < CHURN_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+        result &= conn_set_size(&(rewirers[i].out->connections)) == 0;
+        GC_decRef(rewirers[i].out);
+    }
+    result &= conn_set_size(&(ins[0]->connections)) == 1;
+    for(int i = 1; i < 4; i++) {
+        result &= conn_set_size(&(ins[i]->connections)) == 0;
+    }
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL REWIRING CHURN" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL REWIRING CHURN" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(out);
+    for(int i = 0; i < 4; i++) {
+        GC_decRef(ins[i]);
+    }
+    return result;
+}
+
+bool testBoundChannelsCollected() {
+    bool result = true;
+
+    // bound channels hold references to each other, so dropping ours leaves them to the cycle collector
+    struct GC_stats before, after;
+    GC_cycles_collect();
+    GC_getStats(&before);
+    Channel_PNTR in = channel_create(CHAN_IN, sizeof(int));
+    Channel_PNTR out = channel_create(CHAN_OUT, sizeof(int));
+    channel_bind(in, out);
+    GC_decRef(in);
+    GC_decRef(out);
+    GC_getStats(&after);
+    result &= after.frees == before.frees;
+    GC_cycles_collect();
+    GC_getStats(&after);
+    result &= after.cycleObjects - before.cycleObjects == 2;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - CHANNEL BOUND CHANNELS COLLECTED" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - CHANNEL BOUND CHANNELS COLLECTED" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
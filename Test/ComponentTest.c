@@ -0,0 +1,118 @@
+/*
+ * 
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../Main.h"                               // For the program directory, which Main.c would set
+#include "../InsenseRuntimeCVM/StandardFunctions.h"
+#include "../GC/GC_mem.h"                          // For memory cleanup
+#include "ANSI-Colours.h"                          // For test results
+#include "../Logger/Logger.h"                      // Init log for component/GC's logging
+
+#define PROGRAM_TIMEOUT 10  // seconds a program may run for before it is taken to be stuck
+
+char* directory;
+
+bool testFilterBatches();
+
+int main(int argc, char* argv[]) {
+
+    log_init();
+    GC_init();
+    StandardFunction_init();
+
+    if(argc==2) {
+        log_setLogLevel(argv[1]);
+    }
+
+    int passed = 0;
+    int failed = 0;
+
+    if(testFilterBatches()) passed++;
+    else failed++;
+
+    printf("\n---\n\n"ANSI_COLOR_GREEN "%d passed" ANSI_COLOR_RESET "/" ANSI_COLOR_RED "%d failed" ANSI_COLOR_RESET "\n", passed, failed);
+
+    return failed;
+}
+
+char* getFilePath(char* fileName) {
+    char* path = GC_alloc(strlen(directory) + strlen(fileName) + 1, false);
+    strcat(strcpy(path, directory), fileName);
+    return path;
+}
+
+// Run the program in a directory, as Main.c does, with what it prints written to output. False if it didn't finish.
+static bool runProgram(char* programDirectory, char* output, size_t size) {
+    directory = programDirectory;
+    char* configFile = getFilePath("channels.conf");
+    bool configLoaded = ChannelConfig_load(configFile);
+    GC_decRef(configFile);
+    if(!configLoaded) {
+        return false;
+    }
+
+    FILE* captured = tmpfile();
+    int savedStdout = dup(STDOUT_FILENO);
+    fflush(stdout);
+    dup2(fileno(captured), STDOUT_FILENO);
+
+    char* mainFile = getFilePath("Main.isc");
+    mainComponent = component_newComponent("Main", mainFile, NULL);
+    pthread_t mainThread;
+    pthread_create(&mainThread, NULL, component_run, mainComponent);
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += PROGRAM_TIMEOUT;
+    bool finished = pthread_timedjoin_np(mainThread, NULL, &deadline) == 0;
+    GC_decRef(mainFile);
+
+    fflush(stdout);
+    dup2(savedStdout, STDOUT_FILENO);
+    close(savedStdout);
+    rewind(captured);
+    size_t length = fread(output, 1, size - 1, captured);
+    output[length] = '\0';
+    fclose(captured);
+    return finished;
+}
+
+bool testFilterBatches() {
+    // Source -> Filter -> Relay -> Sink, every IN channel buffered: each filter receives in batches while it stages
+    // sends, with its IN channel declared before its OUT channel (Filter) and after it (Relay)
+    char output[4096];
+    bool result = runProgram(TEST_PROGRAMS "DEMO8/", output, sizeof(output));
+    result &= strstr(output, "Sum 19900") != NULL;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - COMPONENT FILTER BATCHES" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - COMPONENT FILTER BATCHES" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
@@ -0,0 +1,493 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../GC/GC_mem.h"            // For testing
+#include "../GC/GC_slab.h"           // For testing
+#include "../GC/GC_arena.h"          // For testing
+#include "../GC/GC_cycles.h"         // For testing
+#include "../GC/GC_profile.h"        // For testing
+#include "../GC/GC_static.h"         // For testing
+#include "ANSI-Colours.h"            // For test results
+#include "../Logger/Logger.h"        // Init log for GC's logging
+
+bool testSlabReuse();
+bool testSlabZeroed();
+bool testLargeAllocation();
+bool testAllocationStats();
+bool testArenaRelease();
+bool testArenaEscape();
+bool testCycleCollection();
+bool testCycleTrigger();
+bool testImmortal();
+bool testHeapProfile();
+bool testStaticHeap();
+
+// A node of a linked structure, for building cycles.
+typedef struct TestNode TestNode_s, *TestNode_PNTR;
+struct TestNode {
+    void (*decRef)(TestNode_PNTR pntr);
+    TestNode_PNTR next;
+};
+
+static void TestNode_decRef(TestNode_PNTR this) {
+    if(this->next != NULL) {
+        GC_decRef(this->next);
+    }
+}
+
+static void TestNode_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    visit(((TestNode_PNTR) pntr)->next, context);
+}
+
+static TestNode_PNTR TestNode_construct(TestNode_PNTR next) {
+    TestNode_PNTR this = GC_alloc(sizeof(TestNode_s), true);
+    this->decRef = TestNode_decRef;
+    GC_registerChildren((decRefFunc_t) TestNode_decRef, TestNode_children);
+    if(next != NULL) {
+        GC_assign(&(this->next), next);
+    }
+    return this;
+}
+
+// Build a ring of nodes, dropping every reference to it but the one returned.
+static TestNode_PNTR TestNode_ring(unsigned int length) {
+    TestNode_PNTR first = TestNode_construct(NULL);
+    TestNode_PNTR last = first;
+    GC_incRef(last);
+    for(unsigned int i = 1; i < length; i++) {
+        TestNode_PNTR node = TestNode_construct(last);
+        GC_decRef(last);
+        last = node;
+    }
+    GC_assign(&(first->next), last);
+    GC_decRef(last);
+    return first;
+}
+
+int main(int argc, char* argv[]) {
+
+    log_init();
+    GC_init();
+
+    if(argc==2) {
+        log_setLogLevel(argv[1]);
+    }
+
+    int passed = 0;
+    int failed = 0;
+
+    if(testSlabReuse()) passed++;
+    else failed++;
+
+    if(testSlabZeroed()) passed++;
+    else failed++;
+
+    if(testLargeAllocation()) passed++;
+    else failed++;
+
+    if(testAllocationStats()) passed++;
+    else failed++;
+
+    if(testArenaRelease()) passed++;
+    else failed++;
+
+    if(testArenaEscape()) passed++;
+    else failed++;
+
+    if(testCycleCollection()) passed++;
+    else failed++;
+
+    if(testCycleTrigger()) passed++;
+    else failed++;
+
+    if(testImmortal()) passed++;
+    else failed++;
+
+    if(testHeapProfile()) passed++;
+    else failed++;
+
+    if(testStaticHeap()) passed++;
+    else failed++;
+
+    printf("\n---\n\n"ANSI_COLOR_GREEN "%d passed" ANSI_COLOR_RESET "/" ANSI_COLOR_RED "%d failed" ANSI_COLOR_RESET "\n", passed, failed);
+
+    return failed;
+}
+
+bool testSlabReuse() {
+    bool result = true;
+
+    // a freed block is the next one handed out for its size class
+    int* first = GC_alloc(sizeof(int), false);
+    GC_decRef(first);
+    int* second = GC_alloc(sizeof(int), false);
+    result &= second == first;
+
+    // objects of the same class are carved out of a slab one after another, suitably aligned
+    char* a = GC_alloc(40, false);
+    char* b = GC_alloc(40, false);
+    result &= b - a > 40 && b - a < 80 && (uintptr_t) a % 8 == 0 && (uintptr_t) b % 8 == 0;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC SLAB REUSE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC SLAB REUSE" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(second);
+    GC_decRef(a);
+    GC_decRef(b);
+    return result;
+}
+
+bool testSlabZeroed() {
+    bool result = true;
+
+    unsigned char* dirty = GC_alloc(64, false);
+    for(int i = 0; i < 64; i++) {
+        dirty[i] = 0xff;
+    }
+    GC_decRef(dirty);
+    unsigned char* reused = GC_alloc(64, false);
+    result &= reused == dirty;
+    for(int i = 0; i < 64; i++) {
+        result &= reused[i] == 0;
+    }
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC SLAB ZEROED" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC SLAB ZEROED" ANSI_COLOR_RESET "\n");
+    }
+
+    GC_decRef(reused);
+    return result;
+}
+
+bool testLargeAllocation() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    char* large = GC_alloc(GC_SLAB_MAX, false);   // too large with its header for any slab
+    GC_getStats(&after);
+    result &= large != NULL && after.mallocs == before.mallocs + 1;
+    for(int i = 0; i < GC_SLAB_MAX; i++) {
+        result &= large[i] == 0;
+    }
+    GC_decRef(large);
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC LARGE ALLOCATION" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC LARGE ALLOCATION" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testAllocationStats() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    void* objects[100];
+    for(int i = 0; i < 100; i++) {
+        objects[i] = GC_alloc(16, false);
+    }
+    for(int i = 0; i < 100; i++) {
+        GC_decRef(objects[i]);
+    }
+    GC_getStats(&after);
+    result &= after.allocations - before.allocations == 100;
+    result &= after.frees - before.frees == 100;
+    result &= after.bytes - before.bytes == 1600;
+    result &= after.blockBytes - before.blockBytes == 2400;     // each in a 24 byte block, with its one word header
+    result &= after.mallocs - before.mallocs <= 1;   // at most a new slab
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC ALLOCATION STATS" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC ALLOCATION STATS" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testArenaRelease() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    GC_arena_PNTR arena = GC_arena_create();
+    GC_arena_enter(arena);
+    void* objects[100];
+    for(int i = 0; i < 100; i++) {
+        objects[i] = GC_alloc(i % 2 == 0 ? 16 : 100, false);
+    }
+    // blocks of every size come out of the same slab
+    result &= (uintptr_t) objects[0] / GC_ARENA_SLAB_SIZE == (uintptr_t) objects[1] / GC_ARENA_SLAB_SIZE;
+
+    // a block freed by another thread (here, from outside the arena) is taken back by the owner
+    GC_arena_enter(NULL);
+    GC_decRef(objects[0]);
+    GC_arena_enter(arena);
+    void* reused = GC_alloc(16, false);
+    result &= reused == objects[0];
+    objects[0] = reused;
+
+    for(int i = 0; i < 100; i++) {
+        GC_decRef(objects[i]);
+    }
+    GC_arena_enter(NULL);
+    GC_arena_release(arena);
+    GC_getStats(&after);
+    result &= after.arenaSlabs - before.arenaSlabs == 1;
+    result &= after.promoted == before.promoted;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC ARENA RELEASE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC ARENA RELEASE" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testArenaEscape() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    GC_arena_PNTR arena = GC_arena_create();
+    GC_arena_enter(arena);
+    int* escaped = GC_alloc(sizeof(int), false);
+    *escaped = 42;
+    int* temporary = GC_alloc(sizeof(int), false);
+    GC_decRef(temporary);
+    GC_arena_enter(NULL);
+    GC_arena_release(arena);
+    GC_getStats(&after);
+
+    // the slab holding the escaped object outlives the arena, and the object with it
+    result &= after.promoted - before.promoted == 1;
+    result &= after.shared - before.shared == 1;
+    result &= *escaped == 42;
+    GC_decRef(escaped);
+
+    // the slab is kept, and its blocks go to the next arena short of space rather than a new slab
+    GC_arena_PNTR next = GC_arena_create();
+    GC_arena_enter(next);
+    void* reused = GC_alloc(sizeof(int), false);
+    result &= reused == escaped || reused == temporary;
+    GC_decRef(reused);
+    GC_arena_enter(NULL);
+    GC_arena_release(next);
+    struct GC_stats last;
+    GC_getStats(&last);
+    result &= last.arenaSlabs == after.arenaSlabs;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC ARENA ESCAPE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC ARENA ESCAPE" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testCycleCollection() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_getStats(&before);
+    TestNode_PNTR garbage = TestNode_ring(3);
+    GC_decRef(garbage);
+    TestNode_PNTR live = TestNode_ring(2);
+    GC_cycles_collect();
+    GC_getStats(&after);
+
+    // the unreferenced ring is freed whole; the referenced one is left alone
+    result &= after.cycleObjects - before.cycleObjects == 3;
+    result &= after.frees - before.frees == 3;
+    result &= after.cycleBytes - before.cycleBytes >= 3 * sizeof(TestNode_s);
+    result &= GC_getRef(live) == 2 && live->next->next == live;
+
+    // until it isn't
+    GC_decRef(live);
+    GC_cycles_collect();
+    GC_getStats(&after);
+    result &= after.cycleObjects - before.cycleObjects == 5;
+
+    // a cycle that escaped an arena since released may be reached by any thread, so is never scanned
+    GC_arena_PNTR arena = GC_arena_create();
+    GC_arena_enter(arena);
+    GC_decRef(TestNode_ring(2));
+    GC_arena_enter(NULL);
+    GC_arena_release(arena);
+    GC_cycles_collect();
+    GC_getStats(&after);
+    result &= after.cycleObjects - before.cycleObjects == 5;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC CYCLE COLLECTION" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC CYCLE COLLECTION" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testCycleTrigger() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_cycles_collect();
+    GC_getStats(&before);
+    GC_decRef(TestNode_ring(4));
+
+    // polling does nothing until enough has been allocated since the last collection
+    GC_cycles_poll();
+    GC_getStats(&after);
+    result &= after.cycleObjects == before.cycleObjects;
+    for(size_t allocated = 0; allocated < GC_CYCLES_TRIGGER; allocated += 256) {
+        GC_decRef(GC_alloc(256, false));
+    }
+    GC_cycles_poll();
+    GC_getStats(&after);
+    result &= after.cycleObjects - before.cycleObjects == 4;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC CYCLE TRIGGER" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC CYCLE TRIGGER" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testImmortal() {
+    bool result = true;
+
+    struct GC_stats before, after;
+    GC_cycles_collect();
+    GC_getStats(&before);
+    int* value = GC_alloc(sizeof(int), false);
+    *value = 42;
+    GC_makeImmortal(value);
+
+    // references to it come and go without being counted, and it is never freed
+    GC_incRef(value);
+    for(int i = 0; i < 3; i++) {
+        GC_decRef(value);
+    }
+    result &= GC_getRef(value) == UINT_MAX && *value == 42;
+
+    // nor is a ring it is part of, as it keeps the rest
+    TestNode_PNTR ring = TestNode_ring(2);
+    GC_makeImmortal(ring);
+    GC_decRef(ring);
+    GC_cycles_collect();
+    GC_getStats(&after);
+    result &= after.frees == before.frees && after.cycleObjects == before.cycleObjects;
+    result &= after.immortal - before.immortal == 2 && GC_getRef(ring->next) == 1;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC IMMORTAL" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC IMMORTAL" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testHeapProfile() {
+    bool result = true;
+
+    GC_profile_enable();
+    GC_profile_enterComponent("Profiled");
+    void* kept = GC_allocType(sizeof(int), false, "probe");
+    for(int i = 0; i < 3; i++) {
+        GC_decRef(GC_allocType(100, false, "probe"));    // a different site, each in a 128 byte block
+    }
+    GC_profile_enterComponent(NULL);
+
+    // each site is a line of its own, under the component that allocated it
+    FILE* collapsed = tmpfile();
+    GC_profile_dumpCollapsed(collapsed);
+    rewind(collapsed);
+    char line[256];
+    unsigned int probes = 0;
+    while(fgets(line, sizeof(line), collapsed) != NULL) {
+        if(strncmp(line, "Profiled;probe;GCTest.c:", 24) == 0) {
+            unsigned long bytes = strtoul(strrchr(line, ' ') + 1, NULL, 10);
+            result &= bytes == 16 || bytes == 3 * 128;
+            probes++;
+        }
+    }
+    fclose(collapsed);
+    result &= probes == 2;
+
+    // and the component's live bytes go down as its objects are freed, while its peak stays
+    FILE* report = tmpfile();
+    GC_decRef(kept);
+    GC_profile_dump(report);
+    rewind(report);
+    bool found = false;
+    while(fgets(line, sizeof(line), report) != NULL) {
+        unsigned long allocations, bytes, live, peak;
+        double rate;
+        if(sscanf(line, "Profiled %lu %lf %lu %lu %lu", &allocations, &rate, &bytes, &live, &peak) == 5) {
+            result &= allocations == 4 && bytes == 16 + 3 * 128 && live == 0 && peak == 16 + 128;
+            found = true;
+        }
+    }
+    fclose(report);
+    result &= found;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC HEAP PROFILE" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC HEAP PROFILE" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
+
+bool testStaticHeap() {
+    bool result = true;
+
+    //In a process of its own, as every object allocated once the static heap is enabled comes from it.
+    fflush(stdout);
+    pid_t child = fork();
+    if(child == 0) {
+        freopen("/dev/null", "w", stdout);
+        bool ok = GC_static_enable(4096);
+
+        // freed blocks are reused before the heap grows, for small objects and large
+        int* small = GC_alloc(sizeof(int), false);
+        ok &= GC_static_contains(small);
+        GC_decRef(small);
+        ok &= GC_alloc(sizeof(int), false) == small;
+        char* large = GC_alloc(600, false);
+        GC_decRef(large);
+        ok &= GC_alloc(590, false) == large;                 // the smallest freed block that fits
+
+        struct GC_stats stats;
+        GC_getStats(&stats);
+        ok &= stats.staticBudget == 4096 && stats.staticHighWater == 16 + 616 && stats.staticInUse == 16 + 608;
+        if(!ok) {
+            exit(EXIT_FAILURE);
+        }
+
+        // and once the budget is spent, the VM exits
+        for(;;) {
+            GC_alloc(64, false);
+        }
+    }
+    int status;
+    result &= child > 0 && waitpid(child, &status, 0) == child;
+    result &= WIFEXITED(status) && WEXITSTATUS(status) == (unsigned char) EXITCODE_OUT_OF_MEMORY;
+
+    if(result) {
+        printf(ANSI_COLOR_GREEN "Test passed - GC STATIC HEAP" ANSI_COLOR_RESET "\n");
+    } else {
+        printf(ANSI_COLOR_RED "Test failed - GC STATIC HEAP" ANSI_COLOR_RESET "\n");
+    }
+    return result;
+}
@@ -0,0 +1,150 @@
+/*
+ * End-to-end message tracing.
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include "Trace.h"
+#include "Channels/channel_stats.h"
+#include "GC/GC_mem.h"
+
+typedef struct TracePath {
+    unsigned int parent;                    //!< Path this one extends, or 0.
+    char* component;                        //!< Component added to the end of parent.
+    char* label;                            //!< The whole path, components separated by '>'.
+    struct channel_stats_totals latency;    //!< End-to-end latencies of messages whose pipeline ended here.
+} TracePath_s, *TracePath_PNTR;
+
+static bool Trace_enabled = false;
+static pthread_mutex_t Trace_lock = PTHREAD_MUTEX_INITIALIZER;     //!< Guards the paths and their latencies.
+static TracePath_PNTR Trace_paths[TRACE_MAX_PATHS];                 //!< Indexed by path id - 1.
+static unsigned int Trace_pathCount = 0;
+
+void Trace_enable() {
+    Trace_enabled = true;
+}
+
+bool Trace_isEnabled() {
+    return Trace_enabled;
+}
+
+uint64_t Trace_now() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+unsigned int Trace_extendPath(unsigned int path, char* component) {
+    pthread_mutex_lock(&Trace_lock);
+    unsigned int id;
+    for(id = 0; id < Trace_pathCount; id++) {
+        if(Trace_paths[id]->parent == path && strcmp(Trace_paths[id]->component, component) == 0) {
+            pthread_mutex_unlock(&Trace_lock);
+            return id + 1;
+        }
+    }
+    if(Trace_pathCount == TRACE_MAX_PATHS) {
+        pthread_mutex_unlock(&Trace_lock);
+        return 0;
+    }
+
+    TracePath_PNTR new = GC_alloc(sizeof(TracePath_s), false);
+    new->parent = path;
+    new->component = GC_alloc(strlen(component) + 1, false);
+    strcpy(new->component, component);
+    char* prefix = path == 0 ? "" : Trace_paths[path - 1]->label;
+    new->label = GC_alloc(strlen(prefix) + strlen(component) + 2, false);
+    strcpy(new->label, prefix);
+    if(path != 0) {
+        strcat(new->label, ">");
+    }
+    strcat(new->label, component);
+    Trace_paths[Trace_pathCount++] = new;
+    pthread_mutex_unlock(&Trace_lock);
+    return Trace_pathCount;
+}
+
+static void Trace_decRef(Trace_PNTR this) {
+    if(this->message != NULL) {
+        GC_decRef(this->message);
+    }
+}
+
+static void Trace_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    visit(((Trace_PNTR) pntr)->message, context);
+}
+
+Trace_PNTR Trace_wrap(TypedObject_PNTR message, uint64_t origin, unsigned int path) {
+    Trace_PNTR this = GC_allocType(sizeof(Trace_s), true, "Trace");
+    this->decRef = Trace_decRef;
+    GC_registerChildren((decRefFunc_t) Trace_decRef, Trace_children);
+    this->message = message;
+    this->origin = origin;
+    this->path = path;
+    return this;
+}
+
+TypedObject_PNTR Trace_unwrap(Trace_PNTR this, uint64_t* origin, unsigned int* path) {
+    TypedObject_PNTR message = this->message;
+    *origin = this->origin;
+    *path = this->path;
+    this->message = NULL;   //The reference is ours now, not the trace's.
+    GC_decRef(this);
+    return message;
+}
+
+void Trace_record(unsigned int path, uint64_t latency) {
+    if(path == 0) {
+        return;
+    }
+    pthread_mutex_lock(&Trace_lock);
+    struct channel_stats_totals* totals = &(Trace_paths[path - 1]->latency);
+    totals->messages++;
+    totals->wait += latency;
+    if(latency > totals->max_wait) {
+        totals->max_wait = latency;
+    }
+    totals->histogram[channel_stats_bucket(latency)]++;
+    pthread_mutex_unlock(&Trace_lock);
+}
+
+void Trace_dump(FILE* out) {
+    pthread_mutex_lock(&Trace_lock);
+    fprintf(out, "End-to-end latency (times in microseconds):\n");
+    fprintf(out, "%-40s %12s %9s %9s %9s %9s %9s\n", "path", "messages", "mean", "p50", "p90", "p99", "max");
+    for(unsigned int id = 0; id < Trace_pathCount; id++) {
+        struct channel_stats_totals* totals = &(Trace_paths[id]->latency);
+        if(totals->messages == 0) {
+            continue;
+        }
+        fprintf(out, "%-40s %12llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", Trace_paths[id]->label,
+                (unsigned long long)totals->messages, totals->wait / 1e3 / (double)totals->messages,
+                channel_stats_percentile(totals, 0.5) / 1e3, channel_stats_percentile(totals, 0.9) / 1e3,
+                channel_stats_percentile(totals, 0.99) / 1e3, totals->max_wait / 1e3);
+    }
+    pthread_mutex_unlock(&Trace_lock);
+    fflush(out);
+}
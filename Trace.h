@@ -0,0 +1,107 @@
+/*
+ * End-to-end message tracing.
+ *
+ * When tracing is on, each object a component sends travels in a trace stamped with the time its pipeline started and
+ * the components it has passed through. A behaviour iteration which receives traced objects passes the oldest stamp
+ * on to whatever it sends; one which receives traced objects and sends nothing is the end of their pipeline, and
+ * records how long they took to get there under their path (e.g. Sensor>Filter>Aggregator>Sink).
+ *
+ * Copyright (c) 2016, Angus Ireland
+ * School of Computer Science, St. Andrews University
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef CVM_TRACE_H
+#define CVM_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "TypedObject.h"
+
+#define TRACE_MAX_PATHS 256     //!< Most distinct paths recorded; messages on further paths go unrecorded.
+
+typedef struct Trace Trace_s, *Trace_PNTR;
+struct Trace {
+    void (*decRef)(Trace_PNTR pntr);
+    TypedObject_PNTR message;   //!< The object being sent. The trace holds the sender's reference to it.
+    uint64_t origin;            //!< When the message's pipeline started, in ns on the monotonic clock.
+    unsigned int path;          //!< Components the message has come through, see Trace_extendPath.
+};
+
+/**
+ * Turn tracing on. Must be done before any component starts.
+ */
+void Trace_enable();
+bool Trace_isEnabled();
+
+/**
+ * @return The current time on the monotonic clock, in ns.
+ */
+uint64_t Trace_now();
+
+/**
+ * Find the path made by adding a component to the end of another.
+ *
+ * @param[in] path      Path so far, or 0 for a message starting out.
+ * @param[in] component Name of the component the message is leaving.
+ *
+ * @return The id of the longer path, or 0 if there are already TRACE_MAX_PATHS.
+ */
+unsigned int Trace_extendPath(unsigned int path, char* component);
+
+/**
+ * Wrap an object for sending.
+ *
+ * @param[in] message The object. Its reference passes to the trace.
+ * @param[in] origin  When its pipeline started.
+ * @param[in] path    Components it has come through, including the sender.
+ *
+ * @return The new trace. This object will require Garbage Collection.
+ */
+Trace_PNTR Trace_wrap(TypedObject_PNTR message, uint64_t origin, unsigned int path);
+
+/**
+ * Take an object out of a received trace, releasing the trace.
+ *
+ * @param[in]  this   The trace, whose reference passes to this function.
+ * @param[out] origin When the object's pipeline started.
+ * @param[out] path   Components it has come through.
+ *
+ * @return The object, with the reference the trace held.
+ */
+TypedObject_PNTR Trace_unwrap(Trace_PNTR this, uint64_t* origin, unsigned int* path);
+
+/**
+ * Record that a message on a path has reached the end of its pipeline.
+ *
+ * @param[in] path    Every component it went through, including the last.
+ * @param[in] latency Time since its origin, in ns.
+ */
+void Trace_record(unsigned int path, uint64_t latency);
+
+/**
+ * Write a table of end-to-end latency percentiles for every path which has recorded any.
+ *
+ * @param[in] out Where to write it.
+ */
+void Trace_dump(FILE* out);
+
+#endif //CVM_TRACE_H
@@ -23,12 +23,18 @@
  * THE SOFTWARE.
  */
 
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
+#include <string.h>
 #include "TypedObject.h"
 #include "BytecodeTable.h"
 #include "Collections/ListMap.h"
 
 static void TypedObject_decRef(TypedObject_PNTR pntr);
+static void TypedObject_children(void* pntr, GC_visitFunc_t visit, void* context);
+static bool TypedObject_isScalar(unsigned int type);
 
 struct TypedObject {
     void (*decRef)(TypedObject_PNTR pntr);
@@ -37,13 +43,136 @@ struct TypedObject {
 };
 
 TypedObject_PNTR TypedObject_construct(unsigned int type, void* object) {
-    TypedObject_PNTR newObject = GC_alloc(sizeof(TypedObject_s), true);
+    TypedObject_PNTR newObject = GC_allocType(sizeof(TypedObject_s), true, "TypedObject");
     newObject->type = type;
     GC_assign(&(newObject->object), object);
     newObject->decRef = TypedObject_decRef;
+    GC_registerChildren((decRefFunc_t) TypedObject_decRef, TypedObject_children);
     return newObject;
 }
 
+/*
+ * Most numbers and bools a program makes are small, and the same few over and over, so rather than allocate an object
+ * for each, bools and numbers between TYPEDOBJECT_SHARED_MIN and TYPEDOBJECT_SHARED_MAX share one per value, made the
+ * first time it is wanted and never freed. They are immortal, so components passing them around don't contend for
+ * their reference counts, and are allocated in an arena of their own, so as not to keep a slab of whichever component
+ * first wanted one after it stops.
+ */
+#define TYPEDOBJECT_SHARED_RANGE (TYPEDOBJECT_SHARED_MAX - TYPEDOBJECT_SHARED_MIN + 1)
+
+static _Atomic(TypedObject_PNTR) TypedObject_shared[2 + 3 * TYPEDOBJECT_SHARED_RANGE];
+static pthread_mutex_t TypedObject_sharedLock = PTHREAD_MUTEX_INITIALIZER;
+static GC_arena_PNTR TypedObject_sharedArena = NULL;   // only entered with the lock held
+
+// What the heap profiler counts a number, bool or string's value as.
+static const char* TypedObject_typeName(unsigned int type) {
+    switch(type) {
+        case BYTECODE_TYPE_INTEGER:
+            return "integer";
+        case BYTECODE_TYPE_UNSIGNED_INTEGER:
+            return "unsigned";
+        case BYTECODE_TYPE_REAL:
+            return "real";
+        case BYTECODE_TYPE_BOOL:
+            return "bool";
+        case BYTECODE_TYPE_BYTE:
+            return "byte";
+        default:
+            return "string";
+    }
+}
+
+// Slot in TypedObject_shared of the object for a value, or -1 if it has none.
+static int TypedObject_sharedSlot(unsigned int type, const void* value) {
+    long number;
+    int first;
+    switch(type) {
+        case BYTECODE_TYPE_BOOL:
+            return *(const bool*)value ? 1 : 0;
+        case BYTECODE_TYPE_INTEGER:
+            number = *(const int*)value;
+            first = 2;
+            break;
+        case BYTECODE_TYPE_UNSIGNED_INTEGER:
+            number = *(const unsigned int*)value;
+            first = 2 + TYPEDOBJECT_SHARED_RANGE;
+            break;
+        case BYTECODE_TYPE_BYTE:
+            number = *(const char*)value;
+            first = 2 + 2 * TYPEDOBJECT_SHARED_RANGE;
+            break;
+        default:
+            return -1;
+    }
+    if(number < TYPEDOBJECT_SHARED_MIN || number > TYPEDOBJECT_SHARED_MAX) {
+        return -1;
+    }
+    return first + (int)(number - TYPEDOBJECT_SHARED_MIN);
+}
+
+// Make an immortal object. Called with TypedObject_sharedLock held.
+static TypedObject_PNTR TypedObject_immortal(unsigned int type, const void* value, size_t size) {
+    if(TypedObject_sharedArena == NULL) {
+        TypedObject_sharedArena = GC_arena_create();
+    }
+    GC_arena_PNTR previous = GC_arena_enter(TypedObject_sharedArena);
+    void* object = GC_allocType(size, false, TypedObject_typeName(type));
+    memcpy(object, value, size);
+    TypedObject_PNTR immortal = TypedObject_construct(type, object);
+    GC_arena_enter(previous);
+    GC_decRef(object);
+    GC_makeImmortal(object);
+    GC_makeImmortal(immortal);
+    return immortal;
+}
+
+TypedObject_PNTR TypedObject_constructImmortal(unsigned int type, const void* value, size_t size) {
+    pthread_mutex_lock(&TypedObject_sharedLock);
+    TypedObject_PNTR immortal = TypedObject_immortal(type, value, size);
+    pthread_mutex_unlock(&TypedObject_sharedLock);
+    return immortal;
+}
+
+TypedObject_PNTR TypedObject_constructScalar(unsigned int type, const void* value) {
+    int slot = TypedObject_sharedSlot(type, value);
+    if(slot < 0) {
+        void* object = GC_allocType(TypedObject_getSize(type), false, TypedObject_typeName(type));
+        memcpy(object, value, TypedObject_getSize(type));
+        TypedObject_PNTR newObject = TypedObject_construct(type, object);
+        GC_decRef(object);
+        return newObject;
+    }
+
+    //Acquire, so the object is seen as it was made.
+    TypedObject_PNTR shared = atomic_load_explicit(&TypedObject_shared[slot], memory_order_acquire);
+    if(shared == NULL) {
+        pthread_mutex_lock(&TypedObject_sharedLock);
+        shared = atomic_load_explicit(&TypedObject_shared[slot], memory_order_relaxed);
+        if(shared == NULL) {
+            shared = TypedObject_immortal(type, value, TypedObject_getSize(type));
+            atomic_store_explicit(&TypedObject_shared[slot], shared, memory_order_release);
+        }
+        pthread_mutex_unlock(&TypedObject_sharedLock);
+    }
+    return shared;
+}
+
+/*
+ * An expression usually drops its operands as soon as it has made its result, so if nothing else holds one, the result
+ * can be written into it instead of allocating a new object only to free the operand. Shared objects, which are
+ * immortal, never count as unheld.
+ */
+TypedObject_PNTR TypedObject_reuseScalar(TypedObject_PNTR this, unsigned int type, const void* value) {
+    if(!TypedObject_isScalar((unsigned int)this->type) || TypedObject_getSize(type) > TypedObject_getSize(this->type) ||
+       GC_getRef(this) != 1 || GC_getRef(this->object) != 1) {
+        return NULL;
+    }
+    this->type = type;
+    memcpy(this->object, value, TypedObject_getSize(type));
+    GC_incRef(this);
+    return this;
+}
+
 void TypedObject_setObject(TypedObject_PNTR this, void* object) {
     this->object = object;
 }
@@ -64,6 +193,10 @@ void TypedObject_decRef(TypedObject_PNTR this) {
     GC_decRef(this->object);
 }
 
+static void TypedObject_children(void* pntr, GC_visitFunc_t visit, void* context) {
+    visit(((TypedObject_PNTR) pntr)->object, context);
+}
+
 bool TypedObject_isNumber(TypedObject_PNTR this) {
     return this->type == BYTECODE_TYPE_INTEGER ||
            this->type == BYTECODE_TYPE_REAL ||
@@ -93,4 +226,363 @@ size_t TypedObject_getSize(unsigned int type) {
         default:
             return 0; //"size of a string/array", as well as any other type, is meaningless in this context
     }
-}
\ No newline at end of file
+}
+
+/*
+ * Flattened objects are a type byte followed by the value: numbers and bools in their in-memory representation,
+ * strings as a 32 bit length and their characters, structs as a field count and each field's name (as a string) and
+ * value, and anys as the object they hold. A struct field with no value is flattened as BYTECODE_TYPE_UNKNOWN.
+ * Fields are written last to first, since declaring them while rebuilding the struct reverses their order.
+ *
+ * The compact form, for sending between nodes, has the same layout but doesn't depend on the host: lengths, counts
+ * and unsigned integers are varints (7 bits a byte, least significant first, top bit set on all but the last byte),
+ * integers are zigzag varints (so small negative numbers are short too), and reals are 8 little endian bytes.
+ */
+struct TypedObject_cursor {
+    char* data;
+    size_t size;
+    size_t used;    //!< Bytes written or read so far. When writing, may pass size, to measure how much is needed.
+    bool compact;   //!< Use the compact form.
+};
+
+static void TypedObject_write(struct TypedObject_cursor* cursor, const void* data, size_t length) {
+    if(cursor->used + length <= cursor->size) {
+        memcpy(cursor->data + cursor->used, data, length);
+    }
+    cursor->used += length;
+}
+
+static void TypedObject_writeVarint(struct TypedObject_cursor* cursor, uint64_t value) {
+    uint8_t byte;
+    while(value >= 0x80) {
+        byte = (uint8_t)(value | 0x80);
+        TypedObject_write(cursor, &byte, 1);
+        value >>= 7;
+    }
+    byte = (uint8_t)value;
+    TypedObject_write(cursor, &byte, 1);
+}
+
+static void TypedObject_writeLength(struct TypedObject_cursor* cursor, uint32_t length) {
+    if(cursor->compact) {
+        TypedObject_writeVarint(cursor, length);
+    } else {
+        TypedObject_write(cursor, &length, sizeof(length));
+    }
+}
+
+static void TypedObject_writeString(struct TypedObject_cursor* cursor, const char* string) {
+    uint32_t length = (uint32_t)strlen(string);
+    TypedObject_writeLength(cursor, length);
+    TypedObject_write(cursor, string, length);
+}
+
+static void TypedObject_writeCompactNumber(struct TypedObject_cursor* cursor, uint8_t type, void* value) {
+    switch(type) {
+        case BYTECODE_TYPE_INTEGER: {
+            int32_t integer = *(int32_t*)value;
+            TypedObject_writeVarint(cursor, ((uint32_t)integer << 1) ^ (uint32_t)(integer >> 31));
+            break;
+        }
+        case BYTECODE_TYPE_UNSIGNED_INTEGER:
+            TypedObject_writeVarint(cursor, *(uint32_t*)value);
+            break;
+        case BYTECODE_TYPE_REAL: {
+            uint64_t bits;
+            uint8_t bytes[sizeof(bits)];
+            memcpy(&bits, value, sizeof(bits));
+            for(unsigned int i = 0; i < sizeof(bits); i++) {
+                bytes[i] = (uint8_t)(bits >> (8 * i));
+            }
+            TypedObject_write(cursor, bytes, sizeof(bytes));
+            break;
+        }
+        default:
+            TypedObject_write(cursor, value, TypedObject_getSize(type));
+            break;
+    }
+}
+
+static bool TypedObject_writeObject(struct TypedObject_cursor* cursor, TypedObject_PNTR this) {
+    uint8_t type = this == NULL ? BYTECODE_TYPE_UNKNOWN : (uint8_t)this->type;
+    TypedObject_write(cursor, &type, sizeof(type));
+    switch(type) {
+        case BYTECODE_TYPE_UNKNOWN:
+            return true;
+        case BYTECODE_TYPE_INTEGER:
+        case BYTECODE_TYPE_UNSIGNED_INTEGER:
+        case BYTECODE_TYPE_REAL:
+        case BYTECODE_TYPE_BOOL:
+        case BYTECODE_TYPE_BYTE:
+            if(cursor->compact) {
+                TypedObject_writeCompactNumber(cursor, type, this->object);
+            } else {
+                TypedObject_write(cursor, this->object, TypedObject_getSize(type));
+            }
+            return true;
+        case BYTECODE_TYPE_STRING:
+            TypedObject_writeString(cursor, this->object);
+            return true;
+        case BYTECODE_TYPE_STRUCT: {
+            uint32_t fields = IteratedList_getListLength(this->object);
+            TypedObject_writeLength(cursor, fields);
+            for(uint32_t i = fields; i > 0; i--) {
+                ListMapEntry_PNTR field = IteratedList_getElementN(this->object, i - 1);
+                TypedObject_writeString(cursor, field->key);
+                if(!TypedObject_writeObject(cursor, field->value)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        case BYTECODE_TYPE_ANY:
+            return TypedObject_writeObject(cursor, this->object);
+        default:
+            return false;
+    }
+}
+
+size_t TypedObject_encode(TypedObject_PNTR this, char* buffer, size_t size) {
+    struct TypedObject_cursor cursor = { buffer, size, 0, false };
+    return TypedObject_writeObject(&cursor, this) ? cursor.used : 0;
+}
+
+size_t TypedObject_encodeCompact(TypedObject_PNTR this, char* buffer, size_t size) {
+    struct TypedObject_cursor cursor = { buffer, size, 0, true };
+    return TypedObject_writeObject(&cursor, this) ? cursor.used : 0;
+}
+
+// Pointer to the next length bytes, or NULL if there aren't that many left.
+static char* TypedObject_read(struct TypedObject_cursor* cursor, size_t length) {
+    if(length > cursor->size - cursor->used) {
+        return NULL;
+    }
+    cursor->used += length;
+    return cursor->data + cursor->used - length;
+}
+
+static bool TypedObject_readVarint(struct TypedObject_cursor* cursor, uint64_t* value) {
+    *value = 0;
+    for(unsigned int shift = 0; shift < 64; shift += 7) {
+        char* byte = TypedObject_read(cursor, 1);
+        if(byte == NULL) {
+            return false;
+        }
+        *value |= (uint64_t)(*byte & 0x7F) << shift;
+        if((*byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool TypedObject_readLength(struct TypedObject_cursor* cursor, uint32_t* length) {
+    if(cursor->compact) {
+        uint64_t value;
+        if(!TypedObject_readVarint(cursor, &value) || value > UINT32_MAX) {
+            return false;
+        }
+        *length = (uint32_t)value;
+        return true;
+    }
+    char* stored = TypedObject_read(cursor, sizeof(*length));
+    if(stored == NULL) {
+        return false;
+    }
+    memcpy(length, stored, sizeof(*length));
+    return true;
+}
+
+static char* TypedObject_readString(struct TypedObject_cursor* cursor) {
+    uint32_t length;
+    char* stored;
+    if(!TypedObject_readLength(cursor, &length) || (stored = TypedObject_read(cursor, length)) == NULL) {
+        return NULL;
+    }
+    char* string = GC_allocType(length + 1, false, "string");
+    memcpy(string, stored, length);
+    return string;
+}
+
+// Read a number or bool into value, which has room for one of the type. False if the data runs out.
+static bool TypedObject_readNumber(struct TypedObject_cursor* cursor, uint8_t type, void* value) {
+    size_t size = TypedObject_getSize(type);
+    if(cursor->compact && type != BYTECODE_TYPE_BOOL && type != BYTECODE_TYPE_BYTE) {
+        uint64_t bits = 0;
+        if(type == BYTECODE_TYPE_REAL) {
+            char* stored = TypedObject_read(cursor, sizeof(bits));
+            if(stored == NULL) {
+                return false;
+            }
+            for(unsigned int i = 0; i < sizeof(bits); i++) {
+                bits |= (uint64_t)(uint8_t)stored[i] << (8 * i);
+            }
+            memcpy(value, &bits, size);
+            return true;
+        }
+        if(!TypedObject_readVarint(cursor, &bits) || bits > UINT32_MAX) {
+            return false;
+        }
+        uint32_t word = (uint32_t)bits;
+        if(type == BYTECODE_TYPE_INTEGER) {
+            int32_t integer = (int32_t)(word >> 1) ^ -(int32_t)(word & 1);
+            memcpy(value, &integer, size);
+        } else {
+            memcpy(value, &word, size);
+        }
+        return true;
+    }
+    char* stored = TypedObject_read(cursor, size);
+    if(stored == NULL) {
+        return false;
+    }
+    memcpy(value, stored, size);
+    return true;
+}
+
+// Rebuild the next object. Sets *valid to false if the data runs out or holds an unknown type.
+static TypedObject_PNTR TypedObject_readObject(struct TypedObject_cursor* cursor, bool* valid) {
+    char* type = TypedObject_read(cursor, 1);
+    if(type == NULL) {
+        *valid = false;
+        return NULL;
+    }
+    switch((uint8_t)*type) {
+        case BYTECODE_TYPE_UNKNOWN:
+            return NULL;
+        case BYTECODE_TYPE_INTEGER:
+        case BYTECODE_TYPE_UNSIGNED_INTEGER:
+        case BYTECODE_TYPE_REAL:
+        case BYTECODE_TYPE_BOOL:
+        case BYTECODE_TYPE_BYTE: {
+            uint64_t value = 0;
+            if(!TypedObject_readNumber(cursor, (uint8_t)*type, &value)) {
+                break;
+            }
+            return TypedObject_constructScalar((uint8_t)*type, &value);
+        }
+        case BYTECODE_TYPE_STRING: {
+            char* string = TypedObject_readString(cursor);
+            if(string == NULL) {
+                break;
+            }
+            TypedObject_PNTR object = TypedObject_construct(BYTECODE_TYPE_STRING, string);
+            GC_decRef(string);
+            return object;
+        }
+        case BYTECODE_TYPE_STRUCT: {
+            uint32_t fields;
+            if(!TypedObject_readLength(cursor, &fields)) {
+                break;
+            }
+            ListMap_PNTR map = ListMap_constructor();
+            TypedObject_PNTR object = TypedObject_construct(BYTECODE_TYPE_STRUCT, map);
+            GC_decRef(map);
+            for(uint32_t i = 0; i < fields && *valid; i++) {
+                char* name = TypedObject_readString(cursor);
+                if(name == NULL) {
+                    *valid = false;
+                    break;
+                }
+                TypedObject_PNTR value = TypedObject_readObject(cursor, valid);
+                ListMap_declare(map, name);
+                if(value != NULL) {
+                    ListMap_put(map, name, value);
+                    GC_decRef(value);
+                }
+                GC_decRef(name);
+            }
+            return object;
+        }
+        case BYTECODE_TYPE_ANY: {
+            TypedObject_PNTR held = TypedObject_readObject(cursor, valid);
+            if(held == NULL) {
+                break;
+            }
+            TypedObject_PNTR object = TypedObject_construct(BYTECODE_TYPE_ANY, held);
+            GC_decRef(held);
+            return object;
+        }
+        default:
+            break;
+    }
+    *valid = false;
+    return NULL;
+}
+
+static TypedObject_PNTR TypedObject_decodeCursor(struct TypedObject_cursor* cursor) {
+    bool valid = true;
+    TypedObject_PNTR object = TypedObject_readObject(cursor, &valid);
+    if(!valid || cursor->used != cursor->size) {
+        if(object != NULL) {
+            GC_decRef(object);
+        }
+        return NULL;
+    }
+    return object;
+}
+
+TypedObject_PNTR TypedObject_decode(char* data, size_t length) {
+    struct TypedObject_cursor cursor = { data, length, 0, false };
+    return TypedObject_decodeCursor(&cursor);
+}
+
+TypedObject_PNTR TypedObject_decodeCompact(char* data, size_t length) {
+    struct TypedObject_cursor cursor = { data, length, 0, true };
+    return TypedObject_decodeCursor(&cursor);
+}
+
+/*
+ * A receiver rebuilding objects from flattened messages would otherwise allocate a wrapper and a value for every
+ * number it receives, only for most of them to be dropped again soon after. Its recycler keeps a reference to the last
+ * few it built; once the recycler's is the only reference left to one (and to its value), nothing else can reach it,
+ * so it can be overwritten and handed out again.
+ */
+static bool TypedObject_isScalar(unsigned int type) {
+    return type == BYTECODE_TYPE_INTEGER || type == BYTECODE_TYPE_UNSIGNED_INTEGER || type == BYTECODE_TYPE_REAL ||
+           type == BYTECODE_TYPE_BOOL || type == BYTECODE_TYPE_BYTE;
+}
+
+TypedObject_PNTR TypedObject_decodeRecycled(TypedObject_Recycler_PNTR recycler, char* data, size_t length, bool compact) {
+    if(length == 0 || !TypedObject_isScalar((uint8_t)data[0])) {
+        return compact ? TypedObject_decodeCompact(data, length) : TypedObject_decode(data, length);
+    }
+    unsigned int type = (uint8_t)data[0];
+
+    int free = -1;
+    for(int i = 0; i < TYPEDOBJECT_RECYCLE; i++) {
+        TypedObject_PNTR object = recycler->objects[i];
+        if(object == NULL) {
+            free = i;
+        } else if(object->type == (int)type && GC_getRef(object) == 1 && GC_getRef(object->object) == 1) {
+            struct TypedObject_cursor cursor = { data + 1, length - 1, 0, compact };
+            if(!TypedObject_readNumber(&cursor, type, object->object) || cursor.used != cursor.size) {
+                return NULL;
+            }
+            GC_incRef(object);
+            return object;
+        }
+    }
+
+    TypedObject_PNTR object = compact ? TypedObject_decodeCompact(data, length) : TypedObject_decode(data, length);
+    if(object != NULL && GC_getRef(object) != UINT_MAX) {   //Shared objects are never the recycler's alone.
+        if(free < 0) {
+            //All still in use; let the oldest go, so the recycler follows what is being received now.
+            free = (int)recycler->next;
+            recycler->next = (recycler->next + 1) % TYPEDOBJECT_RECYCLE;
+            GC_decRef(recycler->objects[free]);
+        }
+        GC_incRef(object);
+        recycler->objects[free] = object;
+    }
+    return object;
+}
+
+void TypedObject_clearRecycler(TypedObject_Recycler_PNTR recycler) {
+    for(int i = 0; i < TYPEDOBJECT_RECYCLE; i++) {
+        if(recycler->objects[i] != NULL) {
+            GC_decRef(recycler->objects[i]);
+            recycler->objects[i] = NULL;
+        }
+    }
+}
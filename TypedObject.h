@@ -30,7 +30,26 @@
 
 typedef struct TypedObject TypedObject_s, *TypedObject_PNTR;
 
+#define TYPEDOBJECT_RECYCLE 4   //!< Objects a recycler keeps for reuse.
+
+//! Numbers and bools a receiver has handed out, kept so that one can be rebuilt in place once nobody else holds it.
+typedef struct TypedObject_Recycler {
+    TypedObject_PNTR objects[TYPEDOBJECT_RECYCLE];  //!< Each holds a reference of the recycler's own, or is NULL.
+    unsigned int next;                              //!< Slot to give up next when none is free.
+} TypedObject_Recycler_s, *TypedObject_Recycler_PNTR;
+
+#define TYPEDOBJECT_SHARED_MIN -128     //!< Integers, unsigned integers and bytes from here...
+#define TYPEDOBJECT_SHARED_MAX 1023     //!< ...to here, and both bools, each have one shared object.
+
 TypedObject_PNTR TypedObject_construct(unsigned int type, void* object);
+// A number or bool holding a copy of value: the shared object for it if it has one, which is immortal (see
+// GC_makeImmortal) and must not be changed, or else a new one.
+TypedObject_PNTR TypedObject_constructScalar(unsigned int type, const void* value);
+// Overwrite a number or bool nothing else holds with a copy of value, which may be of another type that takes no more
+// room, and return it with a new reference; NULL if it is held elsewhere or too small.
+TypedObject_PNTR TypedObject_reuseScalar(TypedObject_PNTR this, unsigned int type, const void* value);
+// A new immortal object holding a copy of the size bytes at value, such as a literal in a component's bytecode.
+TypedObject_PNTR TypedObject_constructImmortal(unsigned int type, const void* value, size_t size);
 void TypedObject_setObject(TypedObject_PNTR this, void* object);
 void* TypedObject_getObject(TypedObject_PNTR this);
 void TypedObject_setTypeByteCode(TypedObject_PNTR this, unsigned int type);
@@ -38,4 +57,16 @@ int TypedObject_getTypeByteCode(TypedObject_PNTR this);
 bool TypedObject_isNumber(TypedObject_PNTR this);
 size_t TypedObject_getSize(unsigned int type);
 
+// Flatten into buffer, returning the bytes needed (even if more than size), or 0 for objects that can't leave the process.
+size_t TypedObject_encode(TypedObject_PNTR this, char* buffer, size_t size);
+// Rebuild an object flattened by TypedObject_encode, or return NULL if data doesn't hold one.
+TypedObject_PNTR TypedObject_decode(char* data, size_t length);
+// As above, in a smaller form which doesn't depend on the host, for sending to other nodes.
+size_t TypedObject_encodeCompact(TypedObject_PNTR this, char* buffer, size_t size);
+TypedObject_PNTR TypedObject_decodeCompact(char* data, size_t length);
+// As TypedObject_decode(Compact), reusing an object from recycler for a number or bool if one is no longer in use.
+TypedObject_PNTR TypedObject_decodeRecycled(TypedObject_Recycler_PNTR recycler, char* data, size_t length, bool compact);
+// Give up the recycler's references.
+void TypedObject_clearRecycler(TypedObject_Recycler_PNTR recycler);
+
 #endif //CVM_TYPEDOBJECT_H